@@ -0,0 +1,49 @@
+#ifndef OMNI3_BYTES_H
+#define OMNI3_BYTES_H
+
+#include "Arduino.h"
+
+/**
+ * This function writes a little-endian 16-bit number, independently of the byte order of the MCU
+ * @param buffer    buffer to write to
+ * @param len       index of buffer to write to
+ * @param value     number to be written
+ * @return len increased by the number of written bytes
+ */
+inline uint8_t writeLE16(uint8_t *buffer, uint8_t len, uint16_t value) {
+    buffer[len++] = (uint8_t)value;
+    buffer[len++] = (uint8_t)(value >> 8);
+    return len;
+}
+
+/**
+ * This function writes a little-endian 32-bit number, independently of the byte order of the MCU
+ * @param buffer    buffer to write to
+ * @param len       index of buffer to write to
+ * @param value     number to be written
+ * @return len increased by the number of written bytes
+ */
+inline uint8_t writeLE32(uint8_t *buffer, uint8_t len, uint32_t value) {
+    len = writeLE16(buffer, len, (uint16_t)value);
+    return writeLE16(buffer, len, (uint16_t)(value >> 16));
+}
+
+/**
+ * This function reads a little-endian 16-bit number, independently of the byte order of the MCU
+ * @param data      first of the two bytes
+ * @return read number
+ */
+inline uint16_t readLE16(const uint8_t *data) {
+    return (uint16_t)data[0] | (uint16_t)data[1] << 8;
+}
+
+/**
+ * This function reads a little-endian 32-bit number, independently of the byte order of the MCU
+ * @param data      first of the four bytes
+ * @return read number
+ */
+inline uint32_t readLE32(const uint8_t *data) {
+    return (uint32_t)readLE16(data) | (uint32_t)readLE16(data + 2) << 16;
+}
+
+#endif //OMNI3_BYTES_H
@@ -0,0 +1,369 @@
+#ifndef OMNI3_CALIBRATION_H
+#define OMNI3_CALIBRATION_H
+
+#include "Arduino.h"
+#include "wheel.h"
+
+/**
+ * Number of wheels calibrated together
+ */
+#define CALIBRATION_WHEELS 3
+
+/**
+ * Length in microseconds of the windows over which wheels' speed is averaged while looking for the maximum speed
+ */
+#define CALIBRATION_WINDOW 200000UL
+
+/**
+ * Maximum relative change of speed between two consecutive windows for the speed to be considered asymptotic
+ */
+#define CALIBRATION_SPEED_TOLERANCE 0.01
+
+/**
+ * Maximum duration in microseconds of the maximum speed and of the relay phases; after it calibration fails
+ */
+#define CALIBRATION_TIMEOUT 10000000UL
+
+/**
+ * Time in microseconds wheels are left still between maximum speed and relay phases
+ */
+#define CALIBRATION_BRAKE_TIME 1000000UL
+
+/**
+ * Period in microseconds at which wheels' speed is sampled by the relay phase
+ */
+#define CALIBRATION_SAMPLE_PERIOD 10000UL
+
+/**
+ * Setpoint of the relay phase, as a fraction of the maximum speed
+ */
+#define CALIBRATION_RELAY_SETPOINT 0.5
+
+/**
+ * Amplitude of the relay output around the setpoint PWM value, as a fraction of MAX_PWM
+ */
+#define CALIBRATION_RELAY_AMPLITUDE 0.2
+
+/**
+ * Hysteresis of the relay around the setpoint, as a fraction of the maximum speed
+ */
+#define CALIBRATION_RELAY_HYSTERESIS 0.02
+
+/**
+ * Number of oscillations measured by the relay phase, after the first one that is discarded
+ */
+#define CALIBRATION_RELAY_CYCLES 5
+
+/**
+ * States of the calibration
+ * IDLE         calibration never started
+ * MAX_SPEED    wheels run at MAX_PWM until their speed is asymptotic
+ * BRAKE        wheels are still
+ * RELAY        wheels oscillate around half the maximum speed under relay feedback
+ * DONE         calibration completed, results are available
+ * FAILED       calibration timed out or was aborted
+ */
+enum class CalibrationState : uint8_t {IDLE=0, MAX_SPEED=1, BRAKE=2, RELAY=3, DONE=4, FAILED=5};
+
+/**
+ * Class template implementing a non-blocking calibration of the wheels of a robot: handle() must be called as often as
+ * possible and performs one step each time; all the wheels are calibrated concurrently:
+ * - maximum speed: wheels are driven at MAX_PWM until the speed averaged over CALIBRATION_WINDOW stops increasing;
+ *   the maximum speed is the lowest between the wheels
+ * - PID: relay feedback autotuning (Astrom-Hagglund) around half maximum speed measures the ultimate gain and period
+ *   of each wheel; PI constants are computed from their mean with Ziegler-Nichols rules; the derivative constant is
+ *   left 0.0, since the derivative of the speed error measured over one loop period is dominated by encoder
+ *   quantization
+ * @tparam WheelT   type of the wheels, an instantiation of BasicWheel
+ */
+template<class WheelT>
+class BasicCalibration {
+public:
+    /**
+     * This method starts the calibration
+     * @param time      current time in microseconds
+     */
+    void begin(unsigned long time) {
+        this->state = CalibrationState::MAX_SPEED;
+        this->phaseStart = time;
+        this->windowStart = time;
+        for(auto & wheel : this->wheelsState) {
+            wheel = wheel_state_s();
+        }
+    }
+
+    /**
+     * This method stops the calibration, if it is running, and marks it as failed
+     */
+    void abort() {
+        if(this->isRunning()) {
+            this->state = CalibrationState::FAILED;
+        }
+    }
+
+    /**
+     * This method performs one step of the calibration: it reads the encoders and drives the wheels in open loop
+     * @param wheels    array of CALIBRATION_WHEELS wheels
+     * @param time      current time in microseconds
+     * @return state of the calibration after the step
+     */
+    CalibrationState handle(WheelT **wheels, unsigned long time) {
+        switch(this->state) {
+            case CalibrationState::MAX_SPEED:
+                this->handleMaxSpeed(wheels, time);
+                break;
+            case CalibrationState::BRAKE:
+                for(uint8_t i=0; i<CALIBRATION_WHEELS; i++) {
+                    wheels[i]->testPWM(MotorDriver::STILL_PWM);
+                }
+                if(time - this->phaseStart >= CALIBRATION_BRAKE_TIME) {
+                    this->state = CalibrationState::RELAY;
+                    this->phaseStart = time;
+                    this->windowStart = time;
+                }
+                break;
+            case CalibrationState::RELAY:
+                this->handleRelay(wheels, time);
+                break;
+            default:
+                break;
+        }
+
+        /* Wheels are left still when calibration ends */
+        if(!this->isRunning()) {
+            for(uint8_t i=0; i<CALIBRATION_WHEELS; i++) {
+                wheels[i]->testPWM(MotorDriver::STILL_PWM);
+            }
+        }
+        return this->state;
+    }
+
+    /**
+     * @return true if the calibration is running, false otherwise
+     */
+    bool isRunning() const {
+        return this->state == CalibrationState::MAX_SPEED || this->state == CalibrationState::BRAKE ||
+               this->state == CalibrationState::RELAY;
+    }
+
+    /**
+     * @return current state of the calibration
+     */
+    CalibrationState getState() const {
+        return this->state;
+    }
+
+    /**
+     * @return maximum speed reachable by all the wheels in rad/s, valid once the maximum speed phase ended
+     */
+    double getMaxSpeed() const {
+        return this->maxSpeed;
+    }
+
+    /**
+     * This method returns the PID constants found by the relay phase, valid if state is DONE
+     * @param kP        pointer where the proportional constant is stored
+     * @param kI        pointer where the integrative constant is stored
+     * @param kD        pointer where the derivative constant is stored
+     */
+    void getPID(double *kP, double *kI, double *kD) const {
+        /* Ziegler-Nichols PI: kP = 0.45*Ku, Ti = Tu/1.2 */
+        *kP = 0.45 * this->ultimateGain;
+        *kI = 0.54 * this->ultimateGain / this->ultimatePeriod;
+        *kD = 0.0;
+    }
+
+private:
+    /**
+     * Calibration data of a wheel
+     */
+    struct wheel_state_s {
+        /**
+         * Radians turned since the beginning of the current window or sample period
+         */
+        double displacement = 0.0;
+
+        /**
+         * Speed averaged over the last window or sample period, in rad/s
+         */
+        double speed = 0.0;
+
+        /**
+         * True if the relay output is above the setpoint PWM value
+         */
+        bool isRelayHigh = true;
+
+        /**
+         * Time in microseconds of the last switch of the relay from low to high, 0 if none yet
+         */
+        unsigned long lastRise = 0;
+
+        /**
+         * Number of oscillations completed by the relay
+         */
+        uint8_t cycles = 0;
+
+        /**
+         * Lowest and highest speed since the last switch from low to high, in rad/s
+         */
+        double minSpeed = 0.0, maxSpeed = 0.0;
+
+        /**
+         * Sums of the measured oscillation periods in seconds and amplitudes in rad/s
+         */
+        double periodSum = 0.0, amplitudeSum = 0.0;
+    };
+
+    /**
+     * Current state
+     */
+    CalibrationState state = CalibrationState::IDLE;
+
+    /**
+     * Time in microseconds the current phase started
+     */
+    unsigned long phaseStart = 0;
+
+    /**
+     * Time in microseconds the current window or sample period started
+     */
+    unsigned long windowStart = 0;
+
+    /**
+     * Calibration data of each wheel
+     */
+    wheel_state_s wheelsState[CALIBRATION_WHEELS];
+
+    /**
+     * Maximum speed found, in rad/s
+     */
+    double maxSpeed = 0.0;
+
+    /**
+     * Mean ultimate gain (PWM units over PWM units) and period (seconds) of the wheels
+     */
+    double ultimateGain = 0.0, ultimatePeriod = 1.0;
+
+    /**
+     * This method performs one step of the maximum speed phase
+     * @param wheels    array of CALIBRATION_WHEELS wheels
+     * @param time      current time in microseconds
+     */
+    void handleMaxSpeed(WheelT **wheels, unsigned long time) {
+        for(uint8_t i=0; i<CALIBRATION_WHEELS; i++) {
+            this->wheelsState[i].displacement += static_cast<double>(wheels[i]->testPWM(MotorDriver::MAX_PWM));
+        }
+        unsigned long elapsed = time - this->windowStart;
+        if(elapsed < CALIBRATION_WINDOW) {
+            return;
+        }
+
+        /* At the end of each window, speed is asymptotic if it changed less than the tolerance on every wheel */
+        bool isAsymptotic = true;
+        double lowestSpeed = 0.0;
+        for(uint8_t i=0; i<CALIBRATION_WHEELS; i++) {
+            wheel_state_s &wheel = this->wheelsState[i];
+            double speed = wheel.displacement / (elapsed * MICROS);
+            isAsymptotic = isAsymptotic && speed > 0.0 &&
+                    abs(speed - wheel.speed) <= CALIBRATION_SPEED_TOLERANCE * speed;
+            lowestSpeed = i == 0 ? speed : min(lowestSpeed, speed);
+            wheel.speed = speed;
+            wheel.displacement = 0.0;
+        }
+        this->windowStart = time;
+
+        if(isAsymptotic) {
+            this->maxSpeed = lowestSpeed;
+            this->state = CalibrationState::BRAKE;
+            this->phaseStart = time;
+        }
+        else if(time - this->phaseStart >= CALIBRATION_TIMEOUT) {
+            this->state = CalibrationState::FAILED;
+        }
+    }
+
+    /**
+     * This method performs one step of the relay phase
+     * @param wheels    array of CALIBRATION_WHEELS wheels
+     * @param time      current time in microseconds
+     */
+    void handleRelay(WheelT **wheels, unsigned long time) {
+        const double setpoint = CALIBRATION_RELAY_SETPOINT * this->maxSpeed;
+        const double hysteresis = CALIBRATION_RELAY_HYSTERESIS * this->maxSpeed;
+        const int bias = lround(CALIBRATION_RELAY_SETPOINT * MotorDriver::MAX_PWM);
+        const int amplitude = lround(CALIBRATION_RELAY_AMPLITUDE * MotorDriver::MAX_PWM);
+
+        /* Drive each wheel with the current relay output */
+        for(uint8_t i=0; i<CALIBRATION_WHEELS; i++) {
+            wheel_state_s &wheel = this->wheelsState[i];
+            int pwm = wheel.isRelayHigh ? bias + amplitude : bias - amplitude;
+            wheel.displacement += static_cast<double>(wheels[i]->testPWM(pwm));
+        }
+        unsigned long elapsed = time - this->windowStart;
+        if(elapsed < CALIBRATION_SAMPLE_PERIOD) {
+            return;
+        }
+        this->windowStart = time;
+
+        /* At each sample, switch the relays whose wheel crossed the setpoint plus hysteresis */
+        bool isCompleted = true;
+        for(auto & wheel : this->wheelsState) {
+            double speed = wheel.displacement / (elapsed * MICROS);
+            wheel.displacement = 0.0;
+            wheel.minSpeed = min(wheel.minSpeed, speed);
+            wheel.maxSpeed = max(wheel.maxSpeed, speed);
+
+            if(wheel.isRelayHigh && speed > setpoint + hysteresis) {
+                wheel.isRelayHigh = false;
+            }
+            else if(!wheel.isRelayHigh && speed < setpoint - hysteresis) {
+                wheel.isRelayHigh = true;
+
+                /* A switch from low to high completes an oscillation; the first one is a transient */
+                if(wheel.lastRise != 0 && wheel.cycles <= CALIBRATION_RELAY_CYCLES) {
+                    if(wheel.cycles > 0) {
+                        wheel.periodSum += (time - wheel.lastRise) * MICROS;
+                        wheel.amplitudeSum += (wheel.maxSpeed - wheel.minSpeed) / 2;
+                    }
+                    wheel.cycles++;
+                }
+                wheel.lastRise = time;
+                wheel.minSpeed = speed;
+                wheel.maxSpeed = speed;
+            }
+            isCompleted = isCompleted && wheel.cycles > CALIBRATION_RELAY_CYCLES;
+        }
+
+        if(isCompleted) {
+            this->computeUltimate(hysteresis, amplitude);
+            this->state = this->ultimateGain > 0.0 ? CalibrationState::DONE : CalibrationState::FAILED;
+        }
+        else if(time - this->phaseStart >= CALIBRATION_TIMEOUT) {
+            this->state = CalibrationState::FAILED;
+        }
+    }
+
+    /**
+     * This method computes mean ultimate gain and period of the wheels from the measured oscillations
+     * @param hysteresis    hysteresis of the relay in rad/s
+     * @param amplitude     amplitude of the relay output in PWM units
+     */
+    void computeUltimate(double hysteresis, int amplitude) {
+        double gainSum = 0.0, periodSum = 0.0;
+        for(const auto & wheel : this->wheelsState) {
+            /* Oscillation amplitude in PWM units, as seen by the PID */
+            double oscillation = wheel.amplitudeSum / CALIBRATION_RELAY_CYCLES;
+            if(oscillation <= hysteresis) {
+                this->ultimateGain = 0.0;
+                return;
+            }
+            double scale = MotorDriver::MAX_PWM / this->maxSpeed;
+            gainSum += 4 * amplitude / (PI * sqrt(pow(oscillation * scale, 2) - pow(hysteresis * scale, 2)));
+            periodSum += wheel.periodSum / CALIBRATION_RELAY_CYCLES;
+        }
+        this->ultimateGain = gainSum / CALIBRATION_WHEELS;
+        this->ultimatePeriod = periodSum / CALIBRATION_WHEELS;
+    }
+};
+
+#endif //OMNI3_CALIBRATION_H
@@ -0,0 +1,146 @@
+#include "control_task.h"
+
+void (* volatile ControlTask::callback)() = nullptr;
+double ControlTask::period = 0.0;
+
+#if defined(ESP32)
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+
+/* The timer only wakes the task up, so that the callback runs with the priority of the task instead of the one of the
+   timer service */
+static TaskHandle_t controlTask = nullptr;
+static esp_timer_handle_t controlTimer = nullptr;
+static volatile bool isTaskRunning = false;
+
+static void controlTimerCallback(void *) {
+    xTaskNotifyGive(controlTask);
+}
+
+static void controlTaskLoop(void *) {
+    while(isTaskRunning) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        if(isTaskRunning) {
+            ControlTask::run();
+        }
+    }
+    controlTask = nullptr;
+    vTaskDelete(nullptr);
+}
+
+bool ControlTask::begin(unsigned int frequency, void (*_callback)()) {
+    if(frequency == 0 || _callback == nullptr || controlTask != nullptr) {
+        return false;
+    }
+    uint64_t periodMicros = (1000000UL + frequency/2) / frequency;
+    ControlTask::callback = _callback;
+    isTaskRunning = true;
+    if(xTaskCreatePinnedToCore(controlTaskLoop, "omni3", OMNI3_CONTROL_TASK_STACK, nullptr, configMAX_PRIORITIES - 1,
+                               &controlTask, OMNI3_CONTROL_CORE) != pdPASS) {
+        isTaskRunning = false;
+        controlTask = nullptr;
+        return false;
+    }
+
+    esp_timer_create_args_t timerArgs = {};
+    timerArgs.callback = controlTimerCallback;
+    timerArgs.name = "omni3";
+    if(esp_timer_create(&timerArgs, &controlTimer) != ESP_OK ||
+       esp_timer_start_periodic(controlTimer, periodMicros) != ESP_OK) {
+        ControlTask::end();
+        return false;
+    }
+    ControlTask::period = periodMicros * 1e-6;
+    return true;
+}
+
+void ControlTask::end() {
+    if(controlTimer != nullptr) {
+        esp_timer_stop(controlTimer);
+        esp_timer_delete(controlTimer);
+        controlTimer = nullptr;
+    }
+
+    /* Wake the task up for the last time, then wait for it to delete itself */
+    if(controlTask != nullptr) {
+        isTaskRunning = false;
+        xTaskNotifyGive(controlTask);
+        while(controlTask != nullptr) {
+            delay(1);
+        }
+    }
+    ControlTask::callback = nullptr;
+    ControlTask::period = 0.0;
+}
+
+#elif defined(ARDUINO_ARCH_RP2040)
+
+#include "pico/multicore.h"
+
+static volatile bool isTaskRunning = false;
+static volatile bool isTaskStopped = true;
+static volatile uint32_t periodMicros = 0;
+
+static void controlCoreLoop() {
+    absolute_time_t next = get_absolute_time();
+    while(isTaskRunning) {
+        /* Keep the phase if the period was late by less than a period, otherwise restart from now */
+        next = delayed_by_us(next, periodMicros);
+        if(absolute_time_diff_us(next, get_absolute_time()) > (int64_t)periodMicros) {
+            next = get_absolute_time();
+        }
+        busy_wait_until(next);
+        ControlTask::run();
+    }
+    isTaskStopped = true;
+}
+
+bool ControlTask::begin(unsigned int frequency, void (*_callback)()) {
+    if(frequency == 0 || _callback == nullptr || !isTaskStopped) {
+        return false;
+    }
+    periodMicros = (1000000UL + frequency/2) / frequency;
+    ControlTask::callback = _callback;
+    ControlTask::period = periodMicros * 1e-6;
+    isTaskStopped = false;
+    isTaskRunning = true;
+    multicore_reset_core1();
+    multicore_launch_core1(controlCoreLoop);
+    return true;
+}
+
+void ControlTask::end() {
+    if(!isTaskStopped) {
+        isTaskRunning = false;
+        while(!isTaskStopped) {
+            tight_loop_contents();
+        }
+        multicore_reset_core1();
+    }
+    ControlTask::callback = nullptr;
+    ControlTask::period = 0.0;
+}
+
+#else
+
+/* Single core MCU: there is no core for the control task */
+bool ControlTask::begin(unsigned int, void (*)()) {
+    return false;
+}
+
+void ControlTask::end() {}
+
+#endif
+
+double ControlTask::getPeriod() {
+    return ControlTask::period;
+}
+
+void ControlTask::run() {
+    void (*function)() = ControlTask::callback;
+    if(function != nullptr) {
+        function();
+    }
+}
@@ -0,0 +1,65 @@
+#ifndef OMNI3_CONTROL_TASK_H
+#define OMNI3_CONTROL_TASK_H
+
+#include "Arduino.h"
+
+/**
+ * Core the control task runs on: on the ESP32, Arduino loop() runs on core 1, so the control task defaults to core 0;
+ * on the RP2040 it always runs on core 1, which must not be used by setup1() and loop1()
+ */
+#ifndef OMNI3_CONTROL_CORE
+#define OMNI3_CONTROL_CORE 0
+#endif
+
+/**
+ * Stack size in bytes of the control task on the ESP32
+ */
+#ifndef OMNI3_CONTROL_TASK_STACK
+#define OMNI3_CONTROL_TASK_STACK 4096
+#endif
+
+/**
+ * Static class handling the periodic control task of dual-core MCUs: the callback is called at the given frequency on a
+ * core of its own, with the highest priority, while Arduino loop() keeps running on the other core; it is available
+ * on the ESP32 (a FreeRTOS task pinned to OMNI3_CONTROL_CORE, woken by a high resolution timer) and on the RP2040
+ * (core 1, waiting for each period in a busy loop)
+ */
+class ControlTask {
+public:
+    /**
+     * This method starts the task, calling callback at the given frequency
+     * @param frequency     requested frequency in Hz
+     * @param callback      function called at every period, in the context of the control task
+     * @return true if the task was started, false if it is already running or this MCU has no second core
+     */
+    static bool begin(unsigned int frequency, void (*callback)());
+
+    /**
+     * This method stops the task, waiting for the running period, if any, to be completed
+     */
+    static void end();
+
+    /**
+     * Getter for the period of the task
+     * @return period in seconds, or 0.0 if the task is not running
+     */
+    static double getPeriod();
+
+    /**
+     * This method is called by the task at every period; it must not be called directly
+     */
+    static void run();
+
+private:
+    /**
+     * Function called at every period
+     */
+    static void (* volatile callback)();
+
+    /**
+     * Period in seconds
+     */
+    static double period;
+};
+
+#endif //OMNI3_CONTROL_TASK_H
@@ -0,0 +1,130 @@
+#include "control_timer.h"
+
+void (* volatile ControlTimer::callback)() = nullptr;
+double ControlTimer::period = 0.0;
+
+/* The vector is opt-in: library objects are linked into every sketch, so it would otherwise be taken even if fixed-rate
+   mode is never started, and conflict with other libraries using the same timer (e.g. Servo on Timer1) */
+#if defined(__AVR__) && defined(TCCR1A) && defined(OMNI3_TIMER_ISR)
+
+/* Select registers of the configured timer */
+#if OMNI3_CONTROL_TIMER == 1
+#define CT_TCCRA TCCR1A
+#define CT_TCCRB TCCR1B
+#define CT_TCNT TCNT1
+#define CT_OCRA OCR1A
+#define CT_TIMSK TIMSK1
+#define CT_OCIEA OCIE1A
+#define CT_WGM2 WGM12
+#define CT_CS0 CS10
+#define CT_CS1 CS11
+#define CT_CS2 CS12
+#define CT_VECT TIMER1_COMPA_vect
+#elif OMNI3_CONTROL_TIMER == 3 && defined(TCCR3A)
+#define CT_TCCRA TCCR3A
+#define CT_TCCRB TCCR3B
+#define CT_TCNT TCNT3
+#define CT_OCRA OCR3A
+#define CT_TIMSK TIMSK3
+#define CT_OCIEA OCIE3A
+#define CT_WGM2 WGM32
+#define CT_CS0 CS30
+#define CT_CS1 CS31
+#define CT_CS2 CS32
+#define CT_VECT TIMER3_COMPA_vect
+#elif OMNI3_CONTROL_TIMER == 4 && defined(TCCR4A)
+#define CT_TCCRA TCCR4A
+#define CT_TCCRB TCCR4B
+#define CT_TCNT TCNT4
+#define CT_OCRA OCR4A
+#define CT_TIMSK TIMSK4
+#define CT_OCIEA OCIE4A
+#define CT_WGM2 WGM42
+#define CT_CS0 CS40
+#define CT_CS1 CS41
+#define CT_CS2 CS42
+#define CT_VECT TIMER4_COMPA_vect
+#elif OMNI3_CONTROL_TIMER == 5 && defined(TCCR5A)
+#define CT_TCCRA TCCR5A
+#define CT_TCCRB TCCR5B
+#define CT_TCNT TCNT5
+#define CT_OCRA OCR5A
+#define CT_TIMSK TIMSK5
+#define CT_OCIEA OCIE5A
+#define CT_WGM2 WGM52
+#define CT_CS0 CS50
+#define CT_CS1 CS51
+#define CT_CS2 CS52
+#define CT_VECT TIMER5_COMPA_vect
+#else
+#error "OMNI3_CONTROL_TIMER must be a 16-bit timer available on this MCU"
+#endif
+
+bool ControlTimer::begin(unsigned int frequency, void (*_callback)()) {
+    if(frequency == 0 || _callback == nullptr) {
+        return false;
+    }
+
+    /* Find the smallest prescaler for which the number of ticks per period fits in the 16-bit compare register */
+    static const uint16_t prescalers[] = {1, 8, 64, 256, 1024};
+    static const uint8_t clockSelect[] = {
+            _BV(CT_CS0), _BV(CT_CS1), _BV(CT_CS1) | _BV(CT_CS0), _BV(CT_CS2), _BV(CT_CS2) | _BV(CT_CS0)
+    };
+    for(uint8_t i=0; i<sizeof(prescalers)/sizeof(prescalers[0]); i++) {
+        unsigned long ticks = (F_CPU / prescalers[i] + frequency/2) / frequency;
+        if(ticks >= 2 && ticks <= 65536UL) {
+            uint8_t oldSREG = SREG;
+            cli();
+
+            /* CTC mode with TOP = OCRnA, interrupt on compare match A */
+            CT_TCCRA = 0;
+            CT_TCCRB = _BV(CT_WGM2);
+            CT_TCNT = 0;
+            CT_OCRA = ticks - 1;
+            ControlTimer::callback = _callback;
+            ControlTimer::period = (double)ticks * prescalers[i] / F_CPU;
+            CT_TIMSK |= _BV(CT_OCIEA);
+            CT_TCCRB = _BV(CT_WGM2) | clockSelect[i];
+
+            SREG = oldSREG;
+            return true;
+        }
+    }
+    return false;
+}
+
+void ControlTimer::end() {
+    uint8_t oldSREG = SREG;
+    cli();
+    CT_TIMSK &= ~_BV(CT_OCIEA);
+    CT_TCCRB = 0;
+    ControlTimer::callback = nullptr;
+    ControlTimer::period = 0.0;
+    SREG = oldSREG;
+}
+
+ISR(CT_VECT) {
+    ControlTimer::interrupt();
+}
+
+#else
+
+/* No supported timer on this architecture, or its vector is not compiled: fixed-rate mode is unavailable */
+bool ControlTimer::begin(unsigned int, void (*)()) {
+    return false;
+}
+
+void ControlTimer::end() {}
+
+#endif
+
+double ControlTimer::getPeriod() {
+    return ControlTimer::period;
+}
+
+void ControlTimer::interrupt() {
+    void (*function)() = ControlTimer::callback;
+    if(function != nullptr) {
+        function();
+    }
+}
@@ -0,0 +1,58 @@
+#ifndef OMNI3_CONTROL_TIMER_H
+#define OMNI3_CONTROL_TIMER_H
+
+#include "Arduino.h"
+
+/**
+ * 16-bit hardware timer used for the fixed-rate control loop: it can be 1, 3, 4 or 5 on ATmega2560/1280, only 1 on the
+ * other AVRs; the timer is used in CTC mode, so it can't generate PWM on its pins anymore (on the Mega, Timer1 drives
+ * pins 11 and 12, Timer3 pins 2, 3 and 5, Timer4 pins 6, 7 and 8, Timer5 pins 44, 45 and 46)
+ */
+#ifndef OMNI3_CONTROL_TIMER
+#define OMNI3_CONTROL_TIMER 1
+#endif
+
+/**
+ * Static class handling the hardware timer that periodically generates the control loop interrupt; its interrupt vector
+ * is only defined if OMNI3_TIMER_ISR is defined, otherwise begin() returns false
+ */
+class ControlTimer {
+public:
+    /**
+     * This method configures the timer so that callback is called from its interrupt at the given frequency
+     * @param frequency     requested frequency in Hz
+     * @param callback      function called at every period, from interrupt context
+     * @return true if the timer was configured, false if the frequency is not feasible or there is no timer available
+     */
+    static bool begin(unsigned int frequency, void (*callback)());
+
+    /**
+     * This method stops the timer interrupt
+     */
+    static void end();
+
+    /**
+     * This method returns the actual period of the timer, that may slightly differ from the requested one because of
+     * the timer resolution
+     * @return period in seconds, or 0.0 if the timer is not running
+     */
+    static double getPeriod();
+
+    /**
+     * This method is called by the interrupt service routine; it must not be called directly
+     */
+    static void interrupt();
+
+private:
+    /**
+     * Function called at every period
+     */
+    static void (* volatile callback)();
+
+    /**
+     * Actual period in seconds
+     */
+    static double period;
+};
+
+#endif //OMNI3_CONTROL_TIMER_H
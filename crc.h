@@ -0,0 +1,39 @@
+#ifndef OMNI3_CRC_H
+#define OMNI3_CRC_H
+
+#include "Arduino.h"
+
+/**
+ * Polynomial of the CRC-8 protecting serial frames (x^8 + x^2 + x + 1)
+ */
+#define CRC8_POLY 0x07
+
+/**
+ * This function computes the CRC-8 of a byte, continuing from a previous CRC
+ * @param crc       CRC of the previous bytes, 0 for the first byte
+ * @param data      byte to be added to the CRC
+ * @return updated CRC
+ */
+inline uint8_t crc8(uint8_t crc, uint8_t data) {
+    crc ^= data;
+    for(uint8_t i=0; i<8; i++) {
+        crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ CRC8_POLY) : (uint8_t)(crc << 1);
+    }
+    return crc;
+}
+
+/**
+ * This function computes the CRC-8 of a buffer, continuing from a previous CRC
+ * @param crc       CRC of the previous bytes, 0 for the first buffer
+ * @param data      buffer to be added to the CRC
+ * @param len       number of bytes of data
+ * @return updated CRC
+ */
+inline uint8_t crc8(uint8_t crc, const uint8_t *data, uint8_t len) {
+    for(uint8_t i=0; i<len; i++) {
+        crc = crc8(crc, data[i]);
+    }
+    return crc;
+}
+
+#endif //OMNI3_CRC_H
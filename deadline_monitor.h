@@ -0,0 +1,242 @@
+#ifndef OMNI3_DEADLINE_MONITOR_H
+#define OMNI3_DEADLINE_MONITOR_H
+
+#include "Arduino.h"
+#include "bytes.h"
+
+/**
+ * Default deadline of Omni3::handle() in microseconds: calls starting later than this after the previous one are
+ * counted as overruns; 0 disables the check
+ */
+#ifndef OMNI3_DEADLINE
+#define OMNI3_DEADLINE 20000UL
+#endif
+
+/**
+ * Number of consecutive cycles within the deadline for which the overrun level decreases by one
+ */
+#define DEADLINE_RECOVERY_CYCLES 16
+
+/**
+ * Size in bytes of the counters written by DeadlineMonitor::writeCounters()
+ */
+#define DEADLINE_REPORT_SIZE 26
+
+/**
+ * Class checking that Omni3::handle() is called within its deadline: a slow serial burst or EEPROM write in loop(), or
+ * a long movement computation, stretch the period of the control loop, which the PID and the odometry rely on; every
+ * overrun raises the overrun level by one, every DEADLINE_RECOVERY_CYCLES cycles within the deadline lower it by one,
+ * so the level grows only while overruns are frequent; when it reaches the threshold set by setDegradedMode(), the
+ * robot enters degraded mode and caps the speed of its wheels, until the level goes back to 0
+ */
+class DeadlineMonitor {
+public:
+    /**
+     * This method checks the time elapsed since the previous cycle; it is called at the start of every cycle
+     * @param now       current time in microseconds
+     */
+    void check(unsigned long now) {
+        /* The first cycle has no previous one to be compared with */
+        unsigned long interval = now - this->lastStart;
+        this->lastStart = now;
+        if(!this->isStarted) {
+            this->isStarted = true;
+            return;
+        }
+        this->cycles++;
+        if(interval > this->worstInterval) {
+            this->worstInterval = interval;
+        }
+
+        if(this->deadline > 0 && interval > this->deadline) {
+            this->overruns++;
+            this->recoveryCycles = 0;
+            if(this->level < 0xFF) {
+                this->level++;
+            }
+            if(this->threshold > 0 && this->level >= this->threshold) {
+                this->degraded = true;
+            }
+        }
+        else if(this->level > 0 && ++this->recoveryCycles >= DEADLINE_RECOVERY_CYCLES) {
+            this->recoveryCycles = 0;
+            this->level--;
+            if(this->level == 0) {
+                this->degraded = false;
+            }
+        }
+    }
+
+    /**
+     * This method counts a stall of the control loop detected by the watchdog; it is called from its interrupt
+     */
+    void recordStall() {
+        this->stalls = this->stalls + 1;
+    }
+
+    /**
+     * This method counts a stop of the watchdog that could not be sent to a motor bus, since the stalled loop was
+     * flushing it or its transmit buffer was full; it is called from the watchdog interrupt
+     */
+    void recordFailedStop() {
+        this->failedStops = this->failedStops + 1;
+    }
+
+    /**
+     * This method clears all the counters and leaves degraded mode
+     */
+    void reset() {
+        this->cycles = 0;
+        this->overruns = 0;
+        this->worstInterval = 0;
+        this->level = 0;
+        this->recoveryCycles = 0;
+        this->degraded = false;
+        noInterrupts();
+        this->stalls = 0;
+        this->failedStops = 0;
+        interrupts();
+    }
+
+    /**
+     * Setter for the deadline of Omni3::handle()
+     * @param _deadline maximum interval between the starts of two consecutive calls in microseconds, 0 for disabling
+     *                  the check
+     */
+    void setDeadline(unsigned long _deadline) {
+        this->deadline = _deadline;
+    }
+
+    /**
+     * This method configures degraded mode
+     * @param _threshold    overrun level entering degraded mode, 0 (default) for disabling it
+     * @param _speedCap     maximum speed of the wheels in degraded mode, as a fraction of their maximum speed
+     * @return true if degraded mode was configured, false if speedCap is not in range (0.0, 1.0]
+     */
+    bool setDegradedMode(uint8_t _threshold, double _speedCap) {
+        if(!(_speedCap > 0.0 && _speedCap <= 1.0)) {
+            return false;
+        }
+        this->threshold = _threshold;
+        this->speedCap = _speedCap;
+        this->degraded = this->threshold > 0 && this->level >= this->threshold;
+        return true;
+    }
+
+    /**
+     * Getter for the state of degraded mode
+     * @return true if the wheels' speeds are capped
+     */
+    bool isDegraded() const {
+        return this->degraded;
+    }
+
+    /**
+     * Getter for the speed cap of degraded mode
+     * @return maximum speed of the wheels in degraded mode, as a fraction of their maximum speed
+     */
+    double getSpeedCap() const {
+        return this->speedCap;
+    }
+
+    /**
+     * Getter for the number of overruns
+     * @return number of calls of Omni3::handle() started later than the deadline
+     */
+    unsigned long getOverruns() const {
+        return this->overruns;
+    }
+
+    /**
+     * This method writes deadline, number of cycles, overruns, worst interval, watchdog stalls and stops that could not
+     * be sent to the motor bus as little-endian 32-bit numbers, followed by overrun level and degraded mode (1 if
+     * active) as single bytes
+     * @param buffer    array of len DEADLINE_REPORT_SIZE
+     * @return number of written bytes
+     */
+    uint8_t writeCounters(uint8_t *buffer) const {
+        noInterrupts();
+        unsigned long _stalls = this->stalls;
+        unsigned long _failedStops = this->failedStops;
+        interrupts();
+
+        uint8_t len = 0;
+        len = writeLE32(buffer, len, this->deadline);
+        len = writeLE32(buffer, len, this->cycles);
+        len = writeLE32(buffer, len, this->overruns);
+        len = writeLE32(buffer, len, this->worstInterval);
+        len = writeLE32(buffer, len, _stalls);
+        len = writeLE32(buffer, len, _failedStops);
+        buffer[len++] = this->level;
+        buffer[len++] = this->degraded ? 1 : 0;
+        return len;
+    }
+
+private:
+    /**
+     * Deadline of Omni3::handle() in microseconds
+     */
+    unsigned long deadline = OMNI3_DEADLINE;
+
+    /**
+     * Start time of the previous cycle in microseconds
+     */
+    unsigned long lastStart = 0;
+
+    /**
+     * True once the first cycle started
+     */
+    bool isStarted = false;
+
+    /**
+     * Number of checked cycles
+     */
+    unsigned long cycles = 0;
+
+    /**
+     * Number of cycles started later than the deadline
+     */
+    unsigned long overruns = 0;
+
+    /**
+     * Longest interval between two consecutive cycles in microseconds
+     */
+    unsigned long worstInterval = 0;
+
+    /**
+     * Number of stalls detected by the watchdog
+     */
+    volatile unsigned long stalls = 0;
+
+    /**
+     * Number of stops of the watchdog that could not be sent to the motor bus
+     */
+    volatile unsigned long failedStops = 0;
+
+    /**
+     * Overrun level, compared with threshold
+     */
+    uint8_t level = 0;
+
+    /**
+     * Cycles within the deadline since the level last changed
+     */
+    uint8_t recoveryCycles = 0;
+
+    /**
+     * Overrun level entering degraded mode, 0 if degraded mode is disabled
+     */
+    uint8_t threshold = 0;
+
+    /**
+     * True while in degraded mode
+     */
+    bool degraded = false;
+
+    /**
+     * Maximum speed of the wheels in degraded mode, as a fraction of their maximum speed
+     */
+    double speedCap = 0.5;
+};
+
+#endif //OMNI3_DEADLINE_MONITOR_H
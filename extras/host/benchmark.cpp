@@ -0,0 +1,318 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+#include "hal/hal.h"
+#include "plant.h"
+
+/* Benchmark of the control stack on the host: the kinematics of every geometry is checked first, then every movement
+ * type is run against the plant model in simulated time; usage: omni3_bench [repetitions] [loop period in
+ * microseconds] */
+
+/**
+ * Wheel speed of the motor model at full duty cycle in rad/s; it is higher than maxWheelSpeed, as on a real robot
+ */
+#define PLANT_FREE_SPEED 11.0
+
+/**
+ * Mechanical time constant of the motor model in seconds
+ */
+#define PLANT_TIME_CONSTANT 0.05
+
+/**
+ * Parameters of the simulated robot, driven by PI only; the derivative term is disabled, since at 1 kHz the encoder
+ * quantization of the speed error makes it saturate the output
+ */
+static const omni3_params_t PID_PARAMETERS = {
+        10.0,           /* maxWheelSpeed */
+        0.03,           /* wheelsRadius */
+        0.15,           /* robotRadius */
+        D_KP, D_KI, 0.0,
+        1.0, 1.0, 1.0,  /* fwdFrictionK, strFrictionK, angFrictionK */
+        0.0, 0.0, 0.0   /* kS, kV, kA */
+};
+
+/**
+ * Parameters of the simulated robot, with the feed-forward model matching the motor model
+ */
+static const omni3_params_t FEED_FORWARD_PARAMETERS = {
+        10.0, 0.03, 0.15,
+        D_KP, D_KI, 0.0,
+        1.0, 1.0, 1.0,
+        0.0, 255 / PLANT_FREE_SPEED, 255 / PLANT_FREE_SPEED * PLANT_TIME_CONSTANT
+};
+
+/**
+ * Time in seconds the robot is simulated after a finite movement is completed, before measuring the final error
+ */
+#define SETTLE_TIME 0.5
+
+/**
+ * Initial transient in seconds excluded from speed tracking error
+ */
+#define TRANSIENT_TIME 0.5
+
+/**
+ * Kind of error measured for a scenario
+ * SPEED        RMS error between commanded and actual planar speed, in m/s
+ * POSITION     distance between target and final planar position, in m
+ * NONE         commanded speed is normalized, only completion and odometry are measured
+ */
+enum class ErrorKind {SPEED, POSITION, NONE};
+
+/**
+ * Scenario: one movement sent through Omni3::handleMessage()
+ */
+struct scenario_s {
+    const char *name;
+    uint8_t movementType;
+    uint8_t argsLen;
+    double args[MAX_ARGS];
+    ErrorKind errorKind;
+    bool isFinite;
+    double duration;
+};
+
+static const scenario_s SCENARIOS[] = {
+        {"SPEED_INDEFINITE",        1, 3, {0.2, 0.1, 0.5},              ErrorKind::SPEED,    false, 5.0},
+        {"NORM_SPEED_INDEFINITE",   2, 3, {0.5, PI/4, 0.2},             ErrorKind::NONE,     false, 5.0},
+        {"SPACE_TIME_LINEAR",       3, 4, {1.0, 0.5, HALF_PI, 4.0},     ErrorKind::POSITION, true,  20.0},
+        {"SPACE_SPEED_LINEAR",      4, 5, {1.0, -0.5, HALF_PI, 0.3, 0.5}, ErrorKind::POSITION, true, 20.0},
+        {"SPACE_NORM_SPEED_LINEAR", 5, 5, {-0.5, 1.0, PI, 0.5, 0.5},    ErrorKind::POSITION, true,  20.0},
+        {"SPEED_TIME_LINEAR",       6, 4, {0.2, 0.0, 0.3, 3.0},         ErrorKind::SPEED,    true,  20.0},
+        {"NORM_SPEED_TIME_LINEAR",  7, 4, {0.4, 0.0, 0.2, 3.0},         ErrorKind::NONE,     true,  20.0},
+        {"SPACE_SPEED_TRAPEZOID",   8, 5, {1.0, -0.5, HALF_PI, 0.3, 0.5}, ErrorKind::POSITION, true, 20.0},
+        {"SPACE_SPEED_S_CURVE",     9, 5, {1.0, -0.5, HALF_PI, 0.3, 0.5}, ErrorKind::POSITION, true, 20.0},
+};
+
+/**
+ * Results of a scenario
+ */
+struct result_s {
+    bool isAccepted;
+    unsigned long cycles;
+    double simulatedTime;
+    double handleTime;
+    double completionTime;
+    double error;
+    double odometryError;
+};
+
+/**
+ * Simulated robot: drivers, encoders, wheels, Omni3 object and plant model
+ * @tparam WheelDriver  driver type of the wheels: MotorDriver for virtual dispatch, MDD3A for static dispatch
+ */
+template<class WheelDriver>
+struct Rig {
+    typedef BasicWheel<WheelDriver, Encoder> RigWheel;
+
+    MDD3A rightDriver{3, 4}, backDriver{5, 6}, leftDriver{7, 8};
+    Encoder rightEncoder{18, 19}, backEncoder{20, 21}, leftEncoder{2, 17};
+    RigWheel rightWheel{&rightDriver, &rightEncoder};
+    RigWheel backWheel{&backDriver, &backEncoder};
+    RigWheel leftWheel{&leftDriver, &leftEncoder};
+    BasicOmni3<RigWheel> robot;
+    RobotPlant plant;
+
+    /**
+     * Constructor of Rig class
+     * @param parameters    parameters of the robot
+     */
+    explicit Rig(const omni3_params_t &parameters) :
+            robot(&rightWheel, &backWheel, &leftWheel, parameters),
+            plant(MotorPlant(3, 4, &rightEncoder, PLANT_FREE_SPEED, PLANT_TIME_CONSTANT),
+                  MotorPlant(5, 6, &backEncoder, PLANT_FREE_SPEED, PLANT_TIME_CONSTANT),
+                  MotorPlant(7, 8, &leftEncoder, PLANT_FREE_SPEED, PLANT_TIME_CONSTANT),
+                  parameters.wheelsRadius, parameters.robotRadius) {}
+};
+
+/**
+ * This function runs a scenario on a new simulated robot
+ * @tparam WheelDriver  driver type of the wheels
+ * @param scenario      scenario to be run
+ * @param parameters    parameters of the robot
+ * @param period        loop period in microseconds
+ * @param plannerPeriod period of the planner task in microseconds, 0 for running it at every loop
+ * @return results of the scenario
+ */
+template<class WheelDriver>
+static result_s run(const scenario_s &scenario, const omni3_params_t &parameters, unsigned long period,
+                    unsigned long plannerPeriod) {
+    typedef std::chrono::steady_clock clock;
+    HostHAL::reset();
+    Rig<WheelDriver> *rig = new Rig<WheelDriver>(parameters);
+    rig->robot.setTaskPeriod(SchedulerTask::PLANNER, plannerPeriod);
+    result_s result = {false, 0, 0.0, 0.0, -1.0, 0.0, 0.0};
+
+    double args[MAX_ARGS];
+    memcpy(args, scenario.args, sizeof(args));
+    byte message = ((0b10000 | scenario.movementType) << 3) | scenario.argsLen;
+    result.isAccepted = rig->robot.handleMessage(message, args);
+
+    const double dt = period / 1e6;
+    unsigned long maxCycles = lround(scenario.duration / dt);
+    double squaredSpeedError = 0.0;
+    unsigned long speedSamples = 0;
+    clock::duration handleTime = clock::duration::zero();
+
+    for (unsigned long cycle = 0; cycle < maxCycles; cycle++) {
+        HostHAL::advance(period);
+        rig->plant.step(dt);
+
+        clock::time_point start = clock::now();
+        rig->robot.handle();
+        handleTime += clock::now() - start;
+
+        const double time = (cycle + 1) * dt;
+        bool isMoving = !scenario.isFinite || result.completionTime < 0.0;
+
+        /* A finite movement is completed when the schedule is empty again; keep simulating while the robot settles */
+        if (scenario.isFinite && isMoving && rig->robot.getFreeMovementSlots() == OMNI3_MAX_MOVEMENTS) {
+            result.completionTime = time;
+            maxCycles = min(maxCycles, cycle + 1 + (unsigned long)lround(SETTLE_TIME / dt));
+        }
+
+        /* Speed error is measured while the movement is running, after the initial transient */
+        if (scenario.errorKind == ErrorKind::SPEED && isMoving && time > TRANSIENT_TIME) {
+            const double *speed = rig->plant.getSpeed();
+            const double dF = speed[FORWARD] - scenario.args[FORWARD];
+            const double dS = speed[STRAFE] - scenario.args[STRAFE];
+            squaredSpeedError += dF*dF + dS*dS;
+            speedSamples++;
+        }
+        result.cycles++;
+    }
+
+    /* Final errors, with respect to target (position movements) and to ground truth (odometry) */
+    const double *pose = rig->plant.getPose();
+    double position[DOF];
+    rig->robot.getPosition(position);
+    if (scenario.errorKind == ErrorKind::SPEED) {
+        result.error = speedSamples > 0 ? sqrt(squaredSpeedError / speedSamples) : 0.0;
+    }
+    else if (scenario.errorKind == ErrorKind::POSITION) {
+        result.error = hypot(pose[POS_X] - scenario.args[POS_X], pose[POS_Y] - scenario.args[POS_Y]);
+    }
+    result.odometryError = hypot(pose[POS_X] - position[POS_X], pose[POS_Y] - position[POS_Y]);
+    result.simulatedTime = result.cycles * dt;
+    result.handleTime = std::chrono::duration<double>(handleTime).count();
+
+    delete rig;
+    return result;
+}
+
+/**
+ * This function runs every scenario with the given wheel driver type and prints a table of the results
+ * @tparam WheelDriver  driver type of the wheels
+ * @param title         description of the driver type and of the parameters
+ * @param parameters    parameters of the robot
+ * @param repetitions   number of times each scenario is run, for averaging execution times
+ * @param period        loop period in microseconds
+ * @param plannerPeriod period of the planner task in microseconds, 0 for running it at every loop
+ * @return total number of simulated cycles
+ */
+template<class WheelDriver>
+static unsigned long runAll(const char *title, const omni3_params_t &parameters, unsigned int repetitions,
+                            unsigned long period, unsigned long plannerPeriod = 0) {
+    printf("\n%s\n", title);
+    printf("%-24s %8s %10s %10s %10s %12s %12s %10s\n", "movement", "accepted", "cycles", "ns/handle", "speedup",
+           "completed_s", "error", "odometry_m");
+
+    unsigned long totalCycles = 0;
+    for (const auto & scenario : SCENARIOS) {
+        result_s result = {};
+        unsigned long cycles = 0;
+        double handleTime = 0.0, simulatedTime = 0.0;
+        for (unsigned int i = 0; i < repetitions; i++) {
+            result = run<WheelDriver>(scenario, parameters, period, plannerPeriod);
+            cycles += result.cycles;
+            handleTime += result.handleTime;
+            simulatedTime += result.simulatedTime;
+        }
+        totalCycles += cycles;
+
+        char completion[16] = "-";
+        if (result.completionTime >= 0.0) {
+            snprintf(completion, sizeof(completion), "%.3f", result.completionTime);
+        }
+        char error[24] = "-";
+        if (scenario.errorKind == ErrorKind::SPEED) {
+            snprintf(error, sizeof(error), "%.4f m/s", result.error);
+        }
+        else if (scenario.errorKind == ErrorKind::POSITION) {
+            snprintf(error, sizeof(error), "%.4f m", result.error);
+        }
+        printf("%-24s %8s %10lu %10.1f %10.0f %12s %12s %10.4f\n", scenario.name, result.isAccepted ? "yes" : "no",
+               cycles, handleTime * 1e9 / cycles, simulatedTime / handleTime, completion, error,
+               result.odometryError);
+    }
+    return totalCycles;
+}
+
+/**
+ * This function checks that direct kinematics inverts inverse kinematics for a geometry: wheels' speeds are computed
+ * for a few robot speeds, then forward, strafe and rotation are computed back from them
+ * @tparam Geometry     geometry of the robot
+ * @param name          name of the geometry
+ * @return true if every speed is recomputed within the tolerance
+ */
+template<class Geometry>
+static bool checkKinematics(const char *name) {
+    typedef BasicKinematics<Geometry> Kinematics;
+    static const double SPEEDS[][3] = {{1.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 0.0, 1.0}, {0.3, -0.7, 0.2},
+                                       {-2.5, 1.5, -0.8}};
+    /* Fixed rounds each wheel speed to 1.5e-5, and long to one step out of 10000 */
+    static const double TOLERANCE = 1e-3;
+
+    bool isPassed = true;
+    for (const auto & speed : SPEEDS) {
+        control_t translation[Kinematics::WHEELS];
+        Kinematics::inverse(control_t(speed[0]), control_t(speed[1]), translation);
+        control_t wheels[Kinematics::WHEELS];
+        long steps[Kinematics::WHEELS];
+        for (uint8_t i = 0; i < Kinematics::WHEELS; i++) {
+            wheels[i] = translation[i] + control_t(speed[2]);
+            steps[i] = lround((double)wheels[i] * 10000);
+        }
+        double errors[] = {
+                fabs((double)Kinematics::forward(wheels) - speed[0]),
+                fabs((double)Kinematics::strafe(wheels) - speed[1]),
+                fabs((double)Kinematics::rotation(wheels) / Kinematics::WHEELS - speed[2]),
+                fabs(Kinematics::forward(steps) / 10000 - speed[0]),
+                fabs(Kinematics::strafe(steps) / 10000 - speed[1]),
+                fabs((double)Kinematics::rotation(steps) / Kinematics::WHEELS / 10000 - speed[2])
+        };
+        for (double error : errors) {
+            isPassed = isPassed && error < TOLERANCE;
+        }
+    }
+    printf("kinematics round trip of %s: %s\n", name, isPassed ? "ok" : "FAILED");
+    return isPassed;
+}
+
+int main(int argc, char **argv) {
+    unsigned int repetitions = argc > 1 ? (unsigned int)strtoul(argv[1], nullptr, 10) : 10;
+    unsigned long period = argc > 2 ? strtoul(argv[2], nullptr, 10) : 1000;
+    if (repetitions == 0 || period == 0) {
+        fprintf(stderr, "usage: %s [repetitions] [loop period in microseconds]\n", argv[0]);
+        return 1;
+    }
+    bool isKinematicsPassed = checkKinematics<Omni3Geometry>("Omni3Geometry");
+    isKinematicsPassed = checkKinematics<Omni4Geometry>("Omni4Geometry") && isKinematicsPassed;
+    isKinematicsPassed = checkKinematics<MecanumGeometry>("MecanumGeometry") && isKinematicsPassed;
+    if (!isKinematicsPassed) {
+        return 1;
+    }
+    printf("loop period %lu us, %u repetitions\n", period, repetitions);
+
+    unsigned long cycles = runAll<MotorDriver>("Omni3 (virtual driver dispatch), PI only", PID_PARAMETERS,
+                                                repetitions, period);
+    cycles += runAll<MotorDriver>("Omni3 (virtual driver dispatch), feed-forward", FEED_FORWARD_PARAMETERS,
+                                  repetitions, period);
+    cycles += runAll<MDD3A>("BasicOmni3<BasicWheel<MDD3A, Encoder>> (static driver dispatch), feed-forward",
+                            FEED_FORWARD_PARAMETERS, repetitions, period);
+    cycles += runAll<MDD3A>("BasicOmni3<BasicWheel<MDD3A, Encoder>> (static driver dispatch), feed-forward, planner at "
+                            "100 Hz", FEED_FORWARD_PARAMETERS, repetitions, period, 10000);
+    printf("\n%lu simulated cycles\n", cycles);
+    return 0;
+}
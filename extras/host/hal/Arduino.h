@@ -0,0 +1,91 @@
+#ifndef OMNI3_HOST_ARDUINO_H
+#define OMNI3_HOST_ARDUINO_H
+
+/* Mock of the Arduino core for host builds: only what the library uses is provided; time is simulated, see hal.h */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <math.h>
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define PI 3.1415926535897932384626433832795
+#define HALF_PI 1.5707963267948966192313216916398
+#define TWO_PI 6.283185307179586476925286766559
+
+#define LOW 0
+#define HIGH 1
+#define INPUT 0
+#define OUTPUT 1
+#define INPUT_PULLUP 2
+#define CHANGE 1
+#define NOT_AN_INTERRUPT -1
+
+/* Every pin can generate interrupts, see HostHAL::setInput() */
+#define digitalPinToInterrupt(pin) (pin)
+
+#define min(a,b) ((a)<(b)?(a):(b))
+#define max(a,b) ((a)>(b)?(a):(b))
+#define abs(x) ((x)>0?(x):-(x))
+#define constrain(amt,low,high) ((amt)<(low)?(low):((amt)>(high)?(high):(amt)))
+
+#define PROGMEM
+#define pgm_read_byte(address) (*(const uint8_t *)(address))
+#define pgm_read_word(address) (*(const uint16_t *)(address))
+#define pgm_read_dword(address) (*(const uint32_t *)(address))
+#define pgm_read_float(address) (*(const float *)(address))
+
+/* There are no interrupts on the host: the simulation is single threaded */
+#define noInterrupts()
+#define interrupts()
+
+unsigned long millis();
+unsigned long micros();
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+int digitalRead(uint8_t pin);
+void analogWrite(uint8_t pin, int value);
+void delayMicroseconds(unsigned int us);
+void attachInterrupt(uint8_t interrupt, void (*callback)(), int mode);
+
+class Print {
+public:
+    virtual ~Print() = default;
+    virtual size_t write(uint8_t data) = 0;
+    virtual size_t write(const uint8_t *buffer, size_t size) {
+        size_t n = 0;
+        while(size--) {
+            n += this->write(*buffer++);
+        }
+        return n;
+    }
+    virtual int availableForWrite() {
+        return 0;
+    }
+};
+
+class Stream : public Print {
+public:
+    virtual int available() = 0;
+    virtual int read() = 0;
+    virtual int peek() = 0;
+};
+
+/**
+ * Serial port of the host build: transmitted bytes are discarded, nothing is ever received
+ */
+class HardwareSerial : public Stream {
+public:
+    void begin(unsigned long) {}
+    size_t write(uint8_t) override { return 1; }
+    int availableForWrite() override { return 63; }
+    int available() override { return 0; }
+    int read() override { return -1; }
+    int peek() override { return -1; }
+};
+
+extern HardwareSerial Serial;
+
+#endif //OMNI3_HOST_ARDUINO_H
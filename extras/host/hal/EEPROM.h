@@ -0,0 +1,54 @@
+#ifndef OMNI3_HOST_EEPROM_H
+#define OMNI3_HOST_EEPROM_H
+
+#include "Arduino.h"
+
+/**
+ * Size in bytes of the simulated EEPROM, the same as ATmega2560's
+ */
+#define HOST_EEPROM_SIZE 4096
+
+/**
+ * Mock of the EEPROM library, backed by RAM; it starts erased, i.e. filled with 0xFF
+ */
+class EEPROMClass {
+public:
+    EEPROMClass() {
+        memset(this->memory, 0xFF, sizeof(this->memory));
+    }
+
+    uint8_t read(int address) {
+        return this->memory[address];
+    }
+
+    void write(int address, uint8_t value) {
+        this->memory[address] = value;
+    }
+
+    void update(int address, uint8_t value) {
+        this->memory[address] = value;
+    }
+
+    uint16_t length() {
+        return HOST_EEPROM_SIZE;
+    }
+
+    template<class T>
+    T& get(int address, T &data) {
+        memcpy(&data, &this->memory[address], sizeof(T));
+        return data;
+    }
+
+    template<class T>
+    const T& put(int address, const T &data) {
+        memcpy(&this->memory[address], &data, sizeof(T));
+        return data;
+    }
+
+private:
+    uint8_t memory[HOST_EEPROM_SIZE];
+};
+
+extern EEPROMClass EEPROM;
+
+#endif //OMNI3_HOST_EEPROM_H
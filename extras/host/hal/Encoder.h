@@ -0,0 +1,25 @@
+#ifndef OMNI3_HOST_ENCODER_H
+#define OMNI3_HOST_ENCODER_H
+
+#include "Arduino.h"
+
+/**
+ * Mock of the Encoder library: the position is written by the plant model instead of being counted from pins
+ */
+class Encoder {
+public:
+    Encoder(uint8_t, uint8_t) {}
+
+    int32_t read() {
+        return this->position;
+    }
+
+    void write(int32_t _position) {
+        this->position = _position;
+    }
+
+private:
+    int32_t position = 0;
+};
+
+#endif //OMNI3_HOST_ENCODER_H
@@ -0,0 +1,59 @@
+#include "hal.h"
+#include "EEPROM.h"
+
+unsigned long HostHAL::time = 0;
+int HostHAL::duty[HOST_PINS] = {};
+void (*HostHAL::callbacks[HOST_PINS])() = {};
+
+HardwareSerial Serial;
+EEPROMClass EEPROM;
+
+void HostHAL::advance(unsigned long deltaMicros) {
+    HostHAL::time += deltaMicros;
+}
+
+void HostHAL::reset() {
+    HostHAL::time = 0;
+    memset(HostHAL::duty, 0, sizeof(HostHAL::duty));
+    memset(HostHAL::callbacks, 0, sizeof(HostHAL::callbacks));
+}
+
+int HostHAL::getDuty(uint8_t pin) {
+    return HostHAL::duty[pin];
+}
+
+void HostHAL::setInput(uint8_t pin, uint8_t level) {
+    bool isChanged = digitalRead(pin) != level;
+    HostHAL::duty[pin] = level == LOW ? 0 : 255;
+    if (isChanged && HostHAL::callbacks[pin] != nullptr) {
+        HostHAL::callbacks[pin]();
+    }
+}
+
+unsigned long millis() {
+    return HostHAL::time / 1000;
+}
+
+unsigned long micros() {
+    return HostHAL::time;
+}
+
+void pinMode(uint8_t, uint8_t) {}
+
+void digitalWrite(uint8_t pin, uint8_t value) {
+    HostHAL::duty[pin] = value == LOW ? 0 : 255;
+}
+
+int digitalRead(uint8_t pin) {
+    return HostHAL::duty[pin] >= 128 ? HIGH : LOW;
+}
+
+void analogWrite(uint8_t pin, int value) {
+    HostHAL::duty[pin] = constrain(value, 0, 255);
+}
+
+void delayMicroseconds(unsigned int) {}
+
+void attachInterrupt(uint8_t interrupt, void (*callback)(), int) {
+    HostHAL::callbacks[interrupt] = callback;
+}
@@ -0,0 +1,58 @@
+#ifndef OMNI3_HOST_HAL_H
+#define OMNI3_HOST_HAL_H
+
+#include "Arduino.h"
+
+/**
+ * Number of simulated pins
+ */
+#define HOST_PINS 256
+
+/**
+ * Static class controlling the simulated hardware: the clock only advances when advance() is called, and pin outputs
+ * are stored so that the plant model can read them
+ */
+class HostHAL {
+public:
+    /**
+     * This method advances the simulated clock
+     * @param deltaMicros   elapsed time in microseconds
+     */
+    static void advance(unsigned long deltaMicros);
+
+    /**
+     * This method sets the simulated clock back to 0 and all the pins low
+     */
+    static void reset();
+
+    /**
+     * This method returns the duty cycle of a pin: the value of last analogWrite(), or 0 and 255 after digitalWrite()
+     * @param pin   pin number
+     * @return duty cycle in range [0, 255]
+     */
+    static int getDuty(uint8_t pin);
+
+    /**
+     * This method sets the level of an input pin, calling the function attached to its interrupt if the level changes
+     * @param pin       pin number
+     * @param level     HIGH or LOW
+     */
+    static void setInput(uint8_t pin, uint8_t level);
+
+    /**
+     * Current time in microseconds
+     */
+    static unsigned long time;
+
+    /**
+     * Duty cycle of each pin
+     */
+    static int duty[HOST_PINS];
+
+    /**
+     * Function attached to the interrupt of each pin, nullptr if none
+     */
+    static void (*callbacks[HOST_PINS])();
+};
+
+#endif //OMNI3_HOST_HAL_H
@@ -0,0 +1,117 @@
+#ifndef OMNI3_HOST_PLANT_H
+#define OMNI3_HOST_PLANT_H
+
+#include "hal/hal.h"
+#include "hal/Encoder.h"
+#include "omni3.h"
+
+/**
+ * First-order model of a DC motor driven through two PWM inputs (like MDD3A does) and of its encoder: the speed
+ * approaches the free speed scaled by the net duty cycle with the given time constant
+ */
+class MotorPlant {
+public:
+    /**
+     * Constructor of MotorPlant class
+     * @param pinA          pin driving the motor forwards
+     * @param pinB          pin driving the motor backwards
+     * @param encoder       encoder whose position is written by the model
+     * @param freeSpeed     wheel speed at full duty cycle in rad/s
+     * @param timeConstant  mechanical time constant in seconds
+     */
+    MotorPlant(uint8_t pinA, uint8_t pinB, Encoder *encoder, double freeSpeed, double timeConstant) :
+            pinA(pinA), pinB(pinB), encoder(encoder), freeSpeed(freeSpeed), timeConstant(timeConstant) {}
+
+    /**
+     * This method integrates the model over a time step, with the duty cycles currently written on the pins
+     * @param dt    time step in seconds
+     */
+    void step(double dt) {
+        double command = (HostHAL::getDuty(this->pinA) - HostHAL::getDuty(this->pinB)) / 255.0;
+        double steadySpeed = command * this->freeSpeed;
+
+        /* Exact solution of the first-order model over the step, then trapezoidal integration of the angle */
+        double lastSpeed = this->speed;
+        this->speed = steadySpeed + (lastSpeed - steadySpeed) * exp(-dt / this->timeConstant);
+        this->angle += (lastSpeed + this->speed) / 2.0 * dt;
+        this->encoder->write(lround(this->angle / Wheel::stepsToRadians));
+    }
+
+    /**
+     * @return wheel speed in rad/s
+     */
+    double getSpeed() const {
+        return this->speed;
+    }
+
+private:
+    const uint8_t pinA, pinB;
+    Encoder *encoder;
+    const double freeSpeed, timeConstant;
+    double speed = 0.0;
+    double angle = 0.0;
+};
+
+/**
+ * Model of the whole robot: it integrates the three motors and the ground truth pose of the robot, with the same
+ * conventions as Omni3 (forward along POS_X, strafe along POS_Y, phi counter-clockwise)
+ */
+class RobotPlant {
+public:
+    /**
+     * Constructor of RobotPlant class
+     * @param right         model of the wheel at 2 o'clock
+     * @param back          model of the wheel at 6 o'clock
+     * @param left          model of the wheel at 10 o'clock
+     * @param wheelsRadius  wheels' radius in meters
+     * @param robotRadius   distance between the center of the robot and a wheel in meters
+     */
+    RobotPlant(MotorPlant right, MotorPlant back, MotorPlant left, double wheelsRadius, double robotRadius) :
+            motors{right, back, left}, R(wheelsRadius), L(robotRadius) {}
+
+    /**
+     * This method integrates motors and pose over a time step
+     * @param dt    time step in seconds
+     */
+    void step(double dt) {
+        for (auto & motor : this->motors) {
+            motor.step(dt);
+        }
+
+        /* Robot speed from wheels' speeds, as in Omni3::directKinematics() */
+        const double wR = this->motors[W_RIGHT].getSpeed();
+        const double wB = this->motors[W_BACK].getSpeed();
+        const double wL = this->motors[W_LEFT].getSpeed();
+        this->speed[FORWARD] = tan(PI/6) * this->R * (wR - wL);
+        this->speed[STRAFE] = this->R / 3 * (wR - 2*wB + wL);
+        this->speed[THETA] = this->R / (3*this->L) * (wR + wB + wL);
+
+        /* Integrate the pose in the world frame, using the mean heading over the step */
+        const double alpha = this->pose[POS_PHI] + this->speed[THETA] * dt / 2.0;
+        this->pose[POS_X] += (cos(alpha) * this->speed[FORWARD] - sin(alpha) * this->speed[STRAFE]) * dt;
+        this->pose[POS_Y] += (sin(alpha) * this->speed[FORWARD] + cos(alpha) * this->speed[STRAFE]) * dt;
+        this->pose[POS_PHI] += this->speed[THETA] * dt;
+    }
+
+    /**
+     * @return ground truth pose of the robot ([m, m, rad])
+     */
+    const double* getPose() const {
+        return this->pose;
+    }
+
+    /**
+     * @return ground truth speed of the robot in its own frame ([m/s, m/s, rad/s])
+     */
+    const double* getSpeed() const {
+        return this->speed;
+    }
+
+private:
+    MotorPlant motors[WHEELS_NUM];
+    const double R, L;
+    double pose[DOF] = {0.0, 0.0, 0.0};
+    double speed[DOF] = {0.0, 0.0, 0.0};
+};
+
+#endif //OMNI3_HOST_PLANT_H
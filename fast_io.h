@@ -0,0 +1,271 @@
+#ifndef OMNI3_FAST_IO_H
+#define OMNI3_FAST_IO_H
+
+#include "Arduino.h"
+
+/**
+ * Class for driving a digital output pin: on AVR, port register and bit mask are cached at construction, so that
+ * writing the pin is a single masked register update instead of digitalWrite() lookups; writing the value the pin
+ * already has is skipped
+ */
+class FastPin {
+public:
+    /**
+     * Constructor of FastPin class; it sets the pin as output
+     * @param pin   Pin number
+     */
+    explicit FastPin(uint8_t pin) : pin(pin) {
+        pinMode(pin, OUTPUT);
+#ifdef __AVR__
+        this->output = portOutputRegister(digitalPinToPort(pin));
+        this->mask = digitalPinToBitMask(pin);
+#endif
+    }
+
+    /**
+     * Sets the level of the pin
+     * @param high      true for HIGH, false for LOW
+     */
+    void write(bool high) {
+        /* If the pin already has the requested level, skip the write */
+        if(this->isWritten && high == this->isHigh) {
+            return;
+        }
+        this->isWritten = true;
+        this->isHigh = high;
+
+#ifdef __AVR__
+        /* Read-modify-write of the port register must not be interrupted by ISRs writing the same port */
+        uint8_t oldSREG = SREG;
+        cli();
+        if(high) {
+            *this->output |= this->mask;
+        }
+        else {
+            *this->output &= ~this->mask;
+        }
+        SREG = oldSREG;
+#else
+        digitalWrite(this->pin, high ? HIGH : LOW);
+#endif
+    }
+
+private:
+    /**
+     * Pin number
+     */
+    const uint8_t pin;
+
+    /**
+     * Last written level
+     */
+    bool isHigh = false;
+
+    /**
+     * False until the first write, so that the first one is never skipped
+     */
+    bool isWritten = false;
+
+#ifdef __AVR__
+    /**
+     * Output register of the port of the pin
+     */
+    volatile uint8_t *output;
+
+    /**
+     * Bit mask of the pin in its port
+     */
+    uint8_t mask;
+#endif
+};
+
+/**
+ * Class for driving a PWM output pin: on AVR, output compare register and compare output mode bits of the timer
+ * connected to the pin are cached at construction, so that setting a duty cycle is a single register write instead of
+ * analogWrite() lookups; writing the duty cycle the pin already has is skipped; like analogWrite(), duty cycles 0 and
+ * 255 disconnect the timer and drive the pin as a digital output
+ */
+class FastPWM {
+public:
+    /**
+     * Constructor of FastPWM class; it sets the pin as output
+     * @param pin   Pin number
+     */
+    explicit FastPWM(uint8_t pin) : pin(pin) {
+        pinMode(pin, OUTPUT);
+#ifdef __AVR__
+        this->output = portOutputRegister(digitalPinToPort(pin));
+        this->mask = digitalPinToBitMask(pin);
+
+        /* Find the registers of the timer channel connected to the pin */
+        switch(digitalPinToTimer(pin)) {
+#if defined(TCCR0A) && defined(COM0A1)
+            case TIMER0A: this->setChannel(&OCR0A, nullptr, &TCCR0A, _BV(COM0A1)); break;
+#endif
+#if defined(TCCR0A) && defined(COM0B1)
+            case TIMER0B: this->setChannel(&OCR0B, nullptr, &TCCR0A, _BV(COM0B1)); break;
+#endif
+#if defined(TCCR1A) && defined(COM1A1)
+            case TIMER1A: this->setChannel(nullptr, &OCR1A, &TCCR1A, _BV(COM1A1)); break;
+#endif
+#if defined(TCCR1A) && defined(COM1B1)
+            case TIMER1B: this->setChannel(nullptr, &OCR1B, &TCCR1A, _BV(COM1B1)); break;
+#endif
+#if defined(TCCR1A) && defined(COM1C1)
+            case TIMER1C: this->setChannel(nullptr, &OCR1C, &TCCR1A, _BV(COM1C1)); break;
+#endif
+#if defined(TCCR2) && defined(COM21)
+            case TIMER2: this->setChannel(&OCR2, nullptr, &TCCR2, _BV(COM21)); break;
+#endif
+#if defined(TCCR2A) && defined(COM2A1)
+            case TIMER2A: this->setChannel(&OCR2A, nullptr, &TCCR2A, _BV(COM2A1)); break;
+#endif
+#if defined(TCCR2A) && defined(COM2B1)
+            case TIMER2B: this->setChannel(&OCR2B, nullptr, &TCCR2A, _BV(COM2B1)); break;
+#endif
+#if defined(TCCR3A) && defined(COM3A1)
+            case TIMER3A: this->setChannel(nullptr, &OCR3A, &TCCR3A, _BV(COM3A1)); break;
+#endif
+#if defined(TCCR3A) && defined(COM3B1)
+            case TIMER3B: this->setChannel(nullptr, &OCR3B, &TCCR3A, _BV(COM3B1)); break;
+#endif
+#if defined(TCCR3A) && defined(COM3C1)
+            case TIMER3C: this->setChannel(nullptr, &OCR3C, &TCCR3A, _BV(COM3C1)); break;
+#endif
+#if defined(TCCR4A) && defined(COM4A1) && !defined(TC4H)
+            case TIMER4A: this->setChannel(nullptr, &OCR4A, &TCCR4A, _BV(COM4A1)); break;
+#endif
+#if defined(TCCR4A) && defined(COM4B1) && !defined(TC4H)
+            case TIMER4B: this->setChannel(nullptr, &OCR4B, &TCCR4A, _BV(COM4B1)); break;
+#endif
+#if defined(TCCR4A) && defined(COM4C1) && !defined(TC4H)
+            case TIMER4C: this->setChannel(nullptr, &OCR4C, &TCCR4A, _BV(COM4C1)); break;
+#endif
+#if defined(TCCR5A) && defined(COM5A1)
+            case TIMER5A: this->setChannel(nullptr, &OCR5A, &TCCR5A, _BV(COM5A1)); break;
+#endif
+#if defined(TCCR5A) && defined(COM5B1)
+            case TIMER5B: this->setChannel(nullptr, &OCR5B, &TCCR5A, _BV(COM5B1)); break;
+#endif
+#if defined(TCCR5A) && defined(COM5C1)
+            case TIMER5C: this->setChannel(nullptr, &OCR5C, &TCCR5A, _BV(COM5C1)); break;
+#endif
+            /* No timer (or a timer not handled here): fall back to analogWrite() */
+            default: break;
+        }
+#endif
+    }
+
+    /**
+     * Sets the duty cycle of the pin
+     * @param value     duty cycle in range [0, 255]
+     */
+    void write(uint8_t value) {
+        /* If the pin already has the requested duty cycle, skip the write */
+        if(this->isWritten && value == this->value) {
+            return;
+        }
+        this->isWritten = true;
+        this->value = value;
+
+#ifdef __AVR__
+        /* Pins without a known timer channel are handled by analogWrite() */
+        if(this->control == nullptr) {
+            analogWrite(this->pin, value);
+            return;
+        }
+
+        uint8_t oldSREG = SREG;
+        cli();
+        if(value == 0 || value == 255) {
+            /* Disconnect the timer and drive the pin as a digital output */
+            *this->control &= ~this->controlMask;
+            if(value) {
+                *this->output |= this->mask;
+            }
+            else {
+                *this->output &= ~this->mask;
+            }
+        }
+        else {
+            /* Set the duty cycle and connect the timer to the pin; 16-bit registers are written with interrupts
+               disabled, since they share a temporary register with the other channels of the timer */
+            if(this->compare8 != nullptr) {
+                *this->compare8 = value;
+            }
+            else {
+                *this->compare16 = value;
+            }
+            *this->control |= this->controlMask;
+        }
+        SREG = oldSREG;
+#else
+        analogWrite(this->pin, value);
+#endif
+    }
+
+private:
+    /**
+     * Pin number
+     */
+    const uint8_t pin;
+
+    /**
+     * Last written duty cycle
+     */
+    uint8_t value = 0;
+
+    /**
+     * False until the first write, so that the first one is never skipped
+     */
+    bool isWritten = false;
+
+#ifdef __AVR__
+    /**
+     * Output register of the port of the pin
+     */
+    volatile uint8_t *output;
+
+    /**
+     * Bit mask of the pin in its port
+     */
+    uint8_t mask;
+
+    /**
+     * Output compare register of the timer channel, if the timer is 8-bit
+     */
+    volatile uint8_t *compare8 = nullptr;
+
+    /**
+     * Output compare register of the timer channel, if the timer is 16-bit
+     */
+    volatile uint16_t *compare16 = nullptr;
+
+    /**
+     * Control register containing the compare output mode bits of the timer channel
+     */
+    volatile uint8_t *control = nullptr;
+
+    /**
+     * Compare output mode bit that connects the timer channel to the pin
+     */
+    uint8_t controlMask = 0;
+
+    /**
+     * This method stores the registers of the timer channel connected to the pin
+     * @param _compare8     8-bit output compare register, or nullptr
+     * @param _compare16    16-bit output compare register, or nullptr
+     * @param _control      control register with compare output mode bits
+     * @param _controlMask  compare output mode bit
+     */
+    void setChannel(volatile uint8_t *_compare8, volatile uint16_t *_compare16,
+                    volatile uint8_t *_control, uint8_t _controlMask) {
+        this->compare8 = _compare8;
+        this->compare16 = _compare16;
+        this->control = _control;
+        this->controlMask = _controlMask;
+    }
+#endif
+};
+
+#endif //OMNI3_FAST_IO_H
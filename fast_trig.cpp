@@ -0,0 +1,33 @@
+#include "fast_trig.h"
+
+/* Expand the table initializer, doubling the number of elements at each level */
+#define SINCOS_1(i) sinCosTableValue(i),
+#define SINCOS_2(i) SINCOS_1(i) SINCOS_1((i) + 1)
+#define SINCOS_4(i) SINCOS_2(i) SINCOS_2((i) + 2)
+#define SINCOS_8(i) SINCOS_4(i) SINCOS_4((i) + 4)
+#define SINCOS_16(i) SINCOS_8(i) SINCOS_8((i) + 8)
+#define SINCOS_32(i) SINCOS_16(i) SINCOS_16((i) + 16)
+#define SINCOS_64(i) SINCOS_32(i) SINCOS_32((i) + 32)
+#define SINCOS_128(i) SINCOS_64(i) SINCOS_64((i) + 64)
+#define SINCOS_256(i) SINCOS_128(i) SINCOS_128((i) + 128)
+
+#if OMNI3_SINCOS_TABLE_BITS == 2
+#define SINCOS_TABLE SINCOS_4(0)
+#elif OMNI3_SINCOS_TABLE_BITS == 3
+#define SINCOS_TABLE SINCOS_8(0)
+#elif OMNI3_SINCOS_TABLE_BITS == 4
+#define SINCOS_TABLE SINCOS_16(0)
+#elif OMNI3_SINCOS_TABLE_BITS == 5
+#define SINCOS_TABLE SINCOS_32(0)
+#elif OMNI3_SINCOS_TABLE_BITS == 6
+#define SINCOS_TABLE SINCOS_64(0)
+#elif OMNI3_SINCOS_TABLE_BITS == 7
+#define SINCOS_TABLE SINCOS_128(0)
+#else
+#define SINCOS_TABLE SINCOS_256(0)
+#endif
+
+const uint16_t sinCosTable[SINCOS_TABLE_SEGMENTS + 1] PROGMEM = {
+        SINCOS_TABLE
+        sinCosTableValue(SINCOS_TABLE_SEGMENTS)
+};
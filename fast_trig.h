@@ -0,0 +1,153 @@
+#ifndef OMNI3_FAST_TRIG_H
+#define OMNI3_FAST_TRIG_H
+
+#include "Arduino.h"
+
+/**
+ * Base 2 logarithm of the number of segments of the quarter-wave sine table, in range [2, 8]; the table takes
+ * 2*(2^bits + 1) bytes of flash; the maximum absolute error of fastSinCos() is about:
+ * - 4:  1.2e-3
+ * - 5:  3.1e-4
+ * - 6:  8.3e-5 (default)
+ * - 7:  2.6e-5
+ * - 8:  1.2e-5
+ */
+#ifndef OMNI3_SINCOS_TABLE_BITS
+#define OMNI3_SINCOS_TABLE_BITS 6
+#endif
+
+#if OMNI3_SINCOS_TABLE_BITS < 2 || OMNI3_SINCOS_TABLE_BITS > 8
+#error "OMNI3_SINCOS_TABLE_BITS must be in range [2, 8]"
+#endif
+
+/**
+ * Number of segments of the quarter-wave sine table
+ */
+#define SINCOS_TABLE_SEGMENTS (1 << OMNI3_SINCOS_TABLE_BITS)
+
+/**
+ * Scale of the values of the table: sin(x) is stored as round(sin(x) * SINCOS_TABLE_SCALE)
+ */
+#define SINCOS_TABLE_SCALE 65535L
+
+/**
+ * Number of table segments in one radian, multiplied by 65536 so that the angle has a 16-bit fractional part
+ */
+#define SINCOS_STEPS_PER_RADIAN_Q16 (4.0 * SINCOS_TABLE_SEGMENTS * 65536.0 / TWO_PI)
+
+/**
+ * Angles with greater magnitude are reduced with fmod() before the table lookup, so that they don't overflow
+ */
+#define SINCOS_MAX_ANGLE (2147483647.0 / SINCOS_STEPS_PER_RADIAN_Q16)
+
+/**
+ * Quarter-wave sine table: sinCosTable[i] = sin(i * PI/2 / SINCOS_TABLE_SEGMENTS) * SINCOS_TABLE_SCALE; it is stored
+ * in flash memory and computed at compile time
+ */
+extern const uint16_t sinCosTable[SINCOS_TABLE_SEGMENTS + 1] PROGMEM;
+
+/**
+ * This constexpr function computes the Taylor series of sin(x) from the given term on, at compile time
+ * @param x2        square of the angle
+ * @param term      current term of the series
+ * @param n         index of the current term
+ * @return sum of the series from the current term on
+ */
+constexpr double sinTaylorSeries(double x2, double term, int n) {
+    return n > 12 ? term : term + sinTaylorSeries(x2, -term * x2 / ((2.0*n) * (2.0*n + 1.0)), n + 1);
+}
+
+/**
+ * This constexpr function computes the angle corresponding to an element of the sine table
+ * @param i         index of the element
+ * @return angle in radians
+ */
+constexpr double sinCosTableAngle(int i) {
+    return i * HALF_PI / SINCOS_TABLE_SEGMENTS;
+}
+
+/**
+ * This constexpr function computes the value of an element of the sine table, at compile time
+ * @param i         index of the element
+ * @return element of the table
+ */
+constexpr uint16_t sinCosTableValue(int i) {
+    return static_cast<uint16_t>(sinTaylorSeries(sinCosTableAngle(i) * sinCosTableAngle(i), sinCosTableAngle(i), 1)
+                                 * SINCOS_TABLE_SCALE + 0.5);
+}
+
+/**
+ * This function computes both sine and cosine of an angle with a table lookup and a linear interpolation; it is many
+ * times faster than calling sin() and cos() on MCUs without FPU
+ * @param angle     angle in radians
+ * @param sinValue  pointer where sine is stored
+ * @param cosValue  pointer where cosine is stored
+ */
+inline void fastSinCos(double angle, double *sinValue, double *cosValue) {
+    /* Reduce huge angles, so that the fixed-point conversion doesn't overflow */
+    if(angle > SINCOS_MAX_ANGLE || angle < -SINCOS_MAX_ANGLE) {
+        angle = fmod(angle, TWO_PI);
+    }
+
+    /* Convert angle to table segments with 16-bit fractional part; two's complement makes masking work as floor for
+       negative angles too; interpolation uses 15 bits of it, so that it fits in 32-bit integers */
+    const uint32_t steps = static_cast<uint32_t>(static_cast<int32_t>(angle * SINCOS_STEPS_PER_RADIAN_Q16));
+    const uint16_t index = (steps >> 16) & (4 * SINCOS_TABLE_SEGMENTS - 1);
+    const uint8_t quadrant = index >> OMNI3_SINCOS_TABLE_BITS;
+    const uint16_t position = index & (SINCOS_TABLE_SEGMENTS - 1);
+    const int32_t fraction = (steps & 0xFFFF) >> 1;
+
+    /* Interpolate sine of the angle within its quadrant and of its complement, i.e. the cosine */
+    const int32_t a = pgm_read_word(&sinCosTable[position]);
+    const int32_t b = pgm_read_word(&sinCosTable[position + 1]);
+    const int32_t c = pgm_read_word(&sinCosTable[SINCOS_TABLE_SEGMENTS - position]);
+    const int32_t d = pgm_read_word(&sinCosTable[SINCOS_TABLE_SEGMENTS - position - 1]);
+    const double s = static_cast<double>(a * (int32_t)32768 + (b - a) * fraction) *
+            (1.0 / (SINCOS_TABLE_SCALE * 32768.0));
+    const double k = static_cast<double>(c * (int32_t)32768 + (d - c) * fraction) *
+            (1.0 / (SINCOS_TABLE_SCALE * 32768.0));
+
+    /* Apply quadrant symmetries */
+    switch(quadrant) {
+        case 0:
+            *sinValue = s;
+            *cosValue = k;
+            break;
+        case 1:
+            *sinValue = k;
+            *cosValue = -s;
+            break;
+        case 2:
+            *sinValue = -s;
+            *cosValue = -k;
+            break;
+        default:
+            *sinValue = -k;
+            *cosValue = s;
+            break;
+    }
+}
+
+/**
+ * This function computes the sine of an angle with fastSinCos()
+ * @param angle     angle in radians
+ * @return sine of the angle
+ */
+inline double fastSin(double angle) {
+    double sinValue, cosValue;
+    fastSinCos(angle, &sinValue, &cosValue);
+    return sinValue;
+}
+
+/**
+ * This function computes the cosine of an angle with fastSinCos()
+ * @param angle     angle in radians
+ * @return cosine of the angle
+ */
+inline double fastCos(double angle) {
+    double sinValue, cosValue;
+    fastSinCos(angle, &sinValue, &cosValue);
+    return cosValue;
+}
+
+#endif //OMNI3_FAST_TRIG_H
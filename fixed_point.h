@@ -0,0 +1,233 @@
+#ifndef OMNI3_FIXED_POINT_H
+#define OMNI3_FIXED_POINT_H
+
+#include "Arduino.h"
+
+/**
+ * Number of fractional bits of a Fixed number; with 16 bits the representable range is [-32768, 32768) with a
+ * resolution of 1/65536 (about 1.5e-5)
+ */
+#define FIXED_FRAC_BITS 16
+
+/**
+ * Class describing a signed Q16.16 fixed-point number stored in a 32-bit integer; it is meant to replace software
+ * emulated floating point math on FPU-less MCUs (i.e. AVR) in the control path; all the operations saturate instead of
+ * wrapping around, so that an overflow in the PID never flips the sign of the motors' command
+ */
+class Fixed {
+public:
+    /**
+     * Raw representation of number 1.0
+     */
+    static const int32_t ONE = (int32_t)1 << FIXED_FRAC_BITS;
+
+    /**
+     * Default constructor, initializing the number to 0
+     */
+    constexpr Fixed() : raw(0) {}
+
+    /**
+     * Constructor from a floating point number, rounded to the nearest representable value and saturated like the
+     * operations; when value is a constant expression, conversion is computed at compile time
+     * @param value     floating point number, saturated to range [-32768, 32768)
+     */
+    constexpr Fixed(double value) : raw(value >= 32768.0 ? INT32_MAX : value <= -32768.0 ? INT32_MIN :
+                                        static_cast<int32_t>(value * ONE + (value >= 0 ? 0.5 : -0.5))) {}
+
+    /**
+     * Constructor from an integer number
+     * @param value     integer number, saturated to range [-32768, 32767]
+     */
+    constexpr Fixed(int value) : raw(static_cast<long>(value) > 32767L ? INT32_MAX :
+                                     static_cast<long>(value) < -32768L ? INT32_MIN :
+                                     static_cast<int32_t>(value) * ONE) {}
+
+    /**
+     * Constructor from a long integer number
+     * @param value     integer number, saturated to range [-32768, 32767]
+     */
+    constexpr Fixed(long value) : raw(value > 32767L ? INT32_MAX :
+                                      value < -32768L ? INT32_MIN : static_cast<int32_t>(value) * ONE) {}
+
+    /**
+     * This method builds a Fixed number from its raw representation
+     * @param raw       raw value, i.e. the number multiplied by ONE
+     * @return Fixed number having the given raw representation
+     */
+    static constexpr Fixed fromRaw(int32_t raw) {
+        return Fixed(raw, RawTag());
+    }
+
+    /**
+     * This method builds the Fixed number closest to the ratio between two integers, with a 64-bit intermediate result,
+     * so that the numerator can be beyond the representable range (e.g. an elapsed time in microseconds)
+     * @param numerator     dividend
+     * @param denominator   divisor; 0 returns the greatest magnitude with the sign of numerator
+     * @return ratio truncated towards zero and saturated
+     */
+    static Fixed fromRatio(int64_t numerator, int32_t denominator) {
+        if(denominator == 0) {
+            return fromRaw(numerator >= 0 ? INT32_MAX : INT32_MIN);
+        }
+        return fromWide(numerator * ONE / denominator);
+    }
+
+    /**
+     * Getter for the raw representation
+     * @return the number multiplied by ONE
+     */
+    constexpr int32_t getRaw() const {
+        return raw;
+    }
+
+    /**
+     * Explicit conversion to floating point
+     */
+    constexpr explicit operator double() const {
+        return static_cast<double>(raw) / ONE;
+    }
+
+    /**
+     * This method rounds the number to the nearest integer, rounding halfway cases away from zero like lround()
+     * @return rounded number
+     */
+    long round() const {
+        return raw >= 0 ? (long)((raw + ONE/2) >> FIXED_FRAC_BITS) : -(long)((-raw + ONE/2) >> FIXED_FRAC_BITS);
+    }
+
+    Fixed operator-() const {
+        return fromRaw(raw == INT32_MIN ? INT32_MAX : -raw);
+    }
+
+    Fixed& operator+=(Fixed other) {
+        /* Addition saturates to the representable range */
+        if(__builtin_add_overflow(raw, other.raw, &raw)) {
+            raw = other.raw > 0 ? INT32_MAX : INT32_MIN;
+        }
+        return *this;
+    }
+
+    Fixed& operator-=(Fixed other) {
+        /* Subtraction saturates to the representable range */
+        if(__builtin_sub_overflow(raw, other.raw, &raw)) {
+            raw = other.raw < 0 ? INT32_MAX : INT32_MIN;
+        }
+        return *this;
+    }
+
+    friend Fixed operator+(Fixed a, Fixed b) { return a += b; }
+    friend Fixed operator-(Fixed a, Fixed b) { return a -= b; }
+
+    /**
+     * Product between two Fixed numbers: it needs a 64-bit intermediate result, rounded and saturated
+     */
+    friend Fixed operator*(Fixed a, Fixed b) {
+        return fromWide(((int64_t)a.raw * b.raw + ONE/2) >> FIXED_FRAC_BITS);
+    }
+
+    /**
+     * Quotient between two Fixed numbers: it needs a 64-bit intermediate result, saturated; division by 0 returns the
+     * greatest magnitude with the sign of the dividend
+     */
+    friend Fixed operator/(Fixed a, Fixed b) {
+        if(b.raw == 0) {
+            return fromRaw(a.raw >= 0 ? INT32_MAX : INT32_MIN);
+        }
+        return fromWide((int64_t)a.raw * ONE / b.raw);
+    }
+
+    /**
+     * Products and quotients with integers only need 32-bit operations; they are way cheaper than Fixed ones
+     */
+    friend Fixed operator*(Fixed a, int b) { return fromWide((int64_t)a.raw * b); }
+    friend Fixed operator*(int a, Fixed b) { return fromWide((int64_t)b.raw * a); }
+    friend Fixed operator*(Fixed a, long b) { return fromWide((int64_t)a.raw * b); }
+    friend Fixed operator*(long a, Fixed b) { return fromWide((int64_t)b.raw * a); }
+    friend Fixed operator/(Fixed a, int b) { return fromRaw(a.raw / b); }
+    friend Fixed operator/(Fixed a, long b) { return fromRaw(a.raw / b); }
+
+    /**
+     * Mixing Fixed and floating point numbers would silently convert doubles to integers: explicit conversion with
+     * Fixed(value) is required instead
+     */
+    friend Fixed operator*(Fixed a, double b) = delete;
+    friend Fixed operator*(double a, Fixed b) = delete;
+    friend Fixed operator/(Fixed a, double b) = delete;
+
+    friend bool operator==(Fixed a, Fixed b) { return a.raw == b.raw; }
+    friend bool operator!=(Fixed a, Fixed b) { return a.raw != b.raw; }
+    friend bool operator<(Fixed a, Fixed b) { return a.raw < b.raw; }
+    friend bool operator>(Fixed a, Fixed b) { return a.raw > b.raw; }
+    friend bool operator<=(Fixed a, Fixed b) { return a.raw <= b.raw; }
+    friend bool operator>=(Fixed a, Fixed b) { return a.raw >= b.raw; }
+
+private:
+    /**
+     * Tag used for selecting the raw constructor
+     */
+    struct RawTag {};
+
+    /**
+     * Raw constructor
+     * @param raw       raw value, i.e. the number multiplied by ONE
+     */
+    constexpr Fixed(int32_t raw, RawTag) : raw(raw) {}
+
+    /**
+     * This method saturates a 64-bit intermediate result to the representable range
+     * @param wide      raw value, possibly out of the 32-bit range
+     * @return saturated Fixed number
+     */
+    static Fixed fromWide(int64_t wide) {
+        if(wide > INT32_MAX) {
+            return fromRaw(INT32_MAX);
+        }
+        if(wide < INT32_MIN) {
+            return fromRaw(INT32_MIN);
+        }
+        return fromRaw((int32_t)wide);
+    }
+
+    /**
+     * Number multiplied by ONE
+     */
+    int32_t raw;
+};
+
+/**
+ * Overload of lround for Fixed numbers, so that rounding code is the same for both arithmetics
+ * @param value     number to be rounded
+ * @return value rounded to the nearest integer
+ */
+inline long lround(Fixed value) {
+    return value.round();
+}
+
+/**
+ * Type used for the values of the control path (PID state, kinematics constants and displacements); define
+ * OMNI3_USE_FIXED_POINT as a compiler flag (it must be the same for every translation unit) for selecting Q16.16
+ * fixed-point arithmetic, otherwise floating point is used
+ */
+#ifdef OMNI3_USE_FIXED_POINT
+typedef Fixed control_t;
+#else
+typedef double control_t;
+#endif
+
+/**
+ * This function computes the ratio between two integers as a control_t number: in fixed point the numerator may be
+ * beyond the representable range (e.g. an elapsed time in microseconds), so the ratio is computed with a 64-bit
+ * intermediate and saturated instead of converting the numerator first
+ * @param numerator     dividend
+ * @param denominator   divisor
+ * @return ratio between numerator and denominator
+ */
+inline control_t controlRatio(unsigned long numerator, long denominator) {
+#ifdef OMNI3_USE_FIXED_POINT
+    return Fixed::fromRatio(numerator, denominator);
+#else
+    return static_cast<double>(numerator) / denominator;
+#endif
+}
+
+#endif //OMNI3_FIXED_POINT_H
@@ -0,0 +1,250 @@
+#ifndef OMNI3_FLIGHT_RECORDER_H
+#define OMNI3_FLIGHT_RECORDER_H
+
+#include "Arduino.h"
+#include "footprint.h"
+#include "fixed_point.h"
+#include "bytes.h"
+
+/**
+ * Number of control cycles kept by the flight recorder, in range [0, 255]; 0 compiles the recorder out
+ */
+#ifndef OMNI3_FLIGHT_RECORDER_SIZE
+#define OMNI3_FLIGHT_RECORDER_SIZE 16
+#endif
+
+static_assert(OMNI3_FLIGHT_RECORDER_SIZE <= 255, "OMNI3_FLIGHT_RECORDER_SIZE must be in range [0, 255]");
+
+/**
+ * Number of wheels whose state is recorded
+ */
+#define FLIGHT_RECORDER_WHEELS 3
+
+/**
+ * Size in bytes of a record, as written by FlightRecorder::writeDump():
+ * - time in microseconds (uint32)
+ * - for each wheel: encoder steps since previous record, saturated (int16)
+ * - for each wheel: target in sixteenths of PWM unit (int16)
+ * - for each wheel: output PWM value (int16)
+ * - type of the current movement (uint8, see Movements::MovementType)
+ */
+#define FLIGHT_RECORD_SIZE (4 + FLIGHT_RECORDER_WHEELS*3*2 + 1)
+
+/**
+ * Size in bytes of the header of a dump frame: index of its first record, number of records of the dump
+ */
+#define FLIGHT_DUMP_HEADER_SIZE 2
+
+#if OMNI3_FLIGHT_RECORDER_SIZE > 0
+
+/**
+ * Class keeping the last OMNI3_FLIGHT_RECORDER_SIZE control cycles in a circular log: it is frozen by
+ * Omni3::emergencyStop(), so that it keeps what led to it, and it is dumped as a sequence of report frames, oldest
+ * record first; once the dump is complete the log is cleared and recording resumes
+ */
+class FlightRecorder {
+public:
+    /**
+     * True if the recorder is compiled in
+     */
+    static const bool ENABLED = true;
+
+    /**
+     * This method adds a record of a control cycle, overwriting the oldest one if the log is full; nothing is recorded
+     * while the log is frozen
+     * @param time      time of the cycle in microseconds
+     * @param steps     array of len FLIGHT_RECORDER_WHEELS of wheels' steps since previous record
+     * @param targets   array of len FLIGHT_RECORDER_WHEELS of wheels' targets in PWM units
+     * @param pwm       array of len FLIGHT_RECORDER_WHEELS of wheels' output PWM values
+     * @param movement  type of the current movement
+     */
+    void record(unsigned long time, const long *steps, const control_t *targets, const int *pwm, uint8_t movement) {
+        if (this->isFrozen) {
+            return;
+        }
+        flight_record_s &entry = this->records[this->head];
+        entry.time = time;
+        for (uint8_t i=0; i<FLIGHT_RECORDER_WHEELS; i++) {
+            entry.steps[i] = (int16_t)constrain(steps[i], -32767L, 32767L);
+            entry.targets[i] = FlightRecorder::toSixteenths(targets[i]);
+            entry.pwm[i] = (int16_t)pwm[i];
+        }
+        entry.movement = movement;
+
+        this->head = this->head + 1 == OMNI3_FLIGHT_RECORDER_SIZE ? 0 : this->head + 1;
+        if (this->count < OMNI3_FLIGHT_RECORDER_SIZE) {
+            this->count++;
+        }
+    }
+
+    /**
+     * This method stops recording, so that the log keeps the cycles before the call
+     */
+    void freeze() {
+        this->isFrozen = true;
+    }
+
+    /**
+     * Getter for the state of the log
+     * @return true if the log is frozen, false if it is recording
+     */
+    bool getFrozen() const {
+        return this->isFrozen;
+    }
+
+    /**
+     * This method starts a dump of the log, freezing it meanwhile
+     */
+    void beginDump() {
+        this->isFrozen = true;
+        this->isDumping = true;
+        this->dumped = 0;
+    }
+
+    /**
+     * Getter for the state of the dump
+     * @return true if a dump is in progress, false otherwise
+     */
+    bool getDumping() const {
+        return this->isDumping;
+    }
+
+    /**
+     * This method writes the payload of the next frame of the dump: its header and as many of the following records
+     * as fit maxLen bytes; the frame is marked as sent by nextDump()
+     * @param buffer    buffer to write to
+     * @param maxLen    size of the buffer, at least FLIGHT_DUMP_HEADER_SIZE + FLIGHT_RECORD_SIZE
+     * @return number of written bytes
+     */
+    uint8_t writeDump(uint8_t *buffer, uint8_t maxLen) const {
+        uint8_t len = 0;
+        buffer[len++] = this->dumped;
+        buffer[len++] = this->count;
+
+        /* Oldest record is the one head points to if the log is full, the first one otherwise */
+        uint8_t oldest = this->count < OMNI3_FLIGHT_RECORDER_SIZE ? 0 : this->head;
+        for (uint8_t i=this->dumped; i<this->count && len + FLIGHT_RECORD_SIZE <= maxLen; i++) {
+            uint8_t index = (uint8_t)((oldest + i) % OMNI3_FLIGHT_RECORDER_SIZE);
+            len = FlightRecorder::writeRecord(buffer, len, this->records[index]);
+        }
+        return len;
+    }
+
+    /**
+     * This method marks the frame written by last writeDump() as sent; after the last frame, the log is cleared and
+     * recording resumes
+     * @param len       number of bytes returned by writeDump()
+     */
+    void nextDump(uint8_t len) {
+        this->dumped += (len - FLIGHT_DUMP_HEADER_SIZE) / FLIGHT_RECORD_SIZE;
+        if (this->dumped >= this->count) {
+            this->isDumping = false;
+            this->isFrozen = false;
+            this->count = 0;
+            this->head = 0;
+        }
+    }
+
+private:
+    /**
+     * Record of a control cycle
+     */
+    struct flight_record_s {
+        uint32_t time;
+        int16_t steps[FLIGHT_RECORDER_WHEELS];
+        int16_t targets[FLIGHT_RECORDER_WHEELS];
+        int16_t pwm[FLIGHT_RECORDER_WHEELS];
+        uint8_t movement;
+    };
+
+    /**
+     * Circular log of records
+     */
+    flight_record_s records[OMNI3_FLIGHT_RECORDER_SIZE] {};
+
+    /**
+     * Index of the record to be written next
+     */
+    uint8_t head = 0;
+
+    /**
+     * Number of valid records
+     */
+    uint8_t count = 0;
+
+    /**
+     * Number of records already dumped
+     */
+    uint8_t dumped = 0;
+
+    /**
+     * True if recording is stopped
+     */
+    bool isFrozen = false;
+
+    /**
+     * True while a dump is in progress
+     */
+    bool isDumping = false;
+
+    /**
+     * This method converts a value in PWM units to sixteenths of PWM unit, with a shift in fixed-point arithmetic
+     * @param value     value in PWM units, in range [-MAX_PWM, MAX_PWM]
+     * @return value in sixteenths of PWM unit
+     */
+    static int16_t toSixteenths(Fixed value) {
+        return (int16_t)(value.getRaw() >> (FIXED_FRAC_BITS - 4));
+    }
+
+    /**
+     * This method converts a value in PWM units to sixteenths of PWM unit
+     * @param value     value in PWM units, in range [-MAX_PWM, MAX_PWM]
+     * @return value in sixteenths of PWM unit
+     */
+    static int16_t toSixteenths(double value) {
+        return (int16_t)(value * 16);
+    }
+
+    /**
+     * This method writes a record with the layout described by FLIGHT_RECORD_SIZE
+     * @param buffer    buffer to write to
+     * @param len       index of buffer to write to
+     * @param entry     record to be written
+     * @return len increased by the number of written bytes
+     */
+    static uint8_t writeRecord(uint8_t *buffer, uint8_t len, const flight_record_s &entry) {
+        len = writeLE32(buffer, len, entry.time);
+        for (int16_t steps : entry.steps) {
+            len = writeLE16(buffer, len, (uint16_t)steps);
+        }
+        for (int16_t target : entry.targets) {
+            len = writeLE16(buffer, len, (uint16_t)target);
+        }
+        for (int16_t pwm : entry.pwm) {
+            len = writeLE16(buffer, len, (uint16_t)pwm);
+        }
+        buffer[len++] = entry.movement;
+        return len;
+    }
+};
+
+#else
+
+/**
+ * Empty replacement of the flight recorder, used when OMNI3_FLIGHT_RECORDER_SIZE is 0: every call is optimized away
+ */
+class FlightRecorder {
+public:
+    static const bool ENABLED = false;
+    void record(unsigned long, const long *, const control_t *, const int *, uint8_t) {}
+    void freeze() {}
+    bool getFrozen() const { return false; }
+    void beginDump() {}
+    bool getDumping() const { return false; }
+    uint8_t writeDump(uint8_t *, uint8_t) const { return 0; }
+    void nextDump(uint8_t) {}
+};
+
+#endif
+
+#endif //OMNI3_FLIGHT_RECORDER_H
@@ -0,0 +1,91 @@
+#ifndef OMNI3_FOOTPRINT_H
+#define OMNI3_FOOTPRINT_H
+
+#include <stddef.h>
+
+/**
+ * Small footprint profile, for boards with a few KB of RAM (e.g. the Mega): it changes the defaults of the build
+ * options below, which can still be overridden one by one
+ * - OMNI3_MAX_MOVEMENTS 4
+ * - OMNI3_COMMAND_QUEUE_SIZE 2
+ * - OMNI3_FLIGHT_RECORDER_SIZE 0, i.e. no flight recorder
+ * - OMNI3_PROFILED_MOVEMENTS 0, i.e. no trapezoid and S-curve movements
+ * - OMNI3_TELEMETRY 0, i.e. no telemetry
+ * - OMNI3_TESTERS 0, i.e. no tester messages
+ */
+#ifdef OMNI3_SMALL_FOOTPRINT
+#ifndef OMNI3_MAX_MOVEMENTS
+#define OMNI3_MAX_MOVEMENTS 4
+#endif
+#ifndef OMNI3_COMMAND_QUEUE_SIZE
+#define OMNI3_COMMAND_QUEUE_SIZE 2
+#endif
+#ifndef OMNI3_FLIGHT_RECORDER_SIZE
+#define OMNI3_FLIGHT_RECORDER_SIZE 0
+#endif
+#ifndef OMNI3_PROFILED_MOVEMENTS
+#define OMNI3_PROFILED_MOVEMENTS 0
+#endif
+#ifndef OMNI3_TELEMETRY
+#define OMNI3_TELEMETRY 0
+#endif
+#ifndef OMNI3_TESTERS
+#define OMNI3_TESTERS 0
+#endif
+#endif
+
+/**
+ * Trapezoid and S-curve movements (types 8 and 9); 0 compiles them out, and the movements pool shrinks to the size of
+ * the largest of the other types
+ */
+#ifndef OMNI3_PROFILED_MOVEMENTS
+#define OMNI3_PROFILED_MOVEMENTS 1
+#endif
+
+/**
+ * Telemetry frames (see TelemetryStream); 0 compiles them out, together with their double buffer
+ */
+#ifndef OMNI3_TELEMETRY
+#define OMNI3_TELEMETRY 1
+#endif
+
+/**
+ * Tester messages (reports and resets of profiler and deadline monitor, telemetry frames on demand); 0 compiles them
+ * out, and every tester message is rejected
+ */
+#ifndef OMNI3_TESTERS
+#define OMNI3_TESTERS 1
+#endif
+
+/**
+ * Struct reporting the RAM taken by a component at build time: calling print() raises a deprecation warning, which
+ * the compiler prints with the template arguments, e.g.
+ *   warning: 'static void RamReport<Owner, Component, BYTES>::print() [with Owner = BasicOmni3<...>;
+ *   Component = Movements; ... BYTES = 460]' is deprecated: RAM report, not an error
+ * Sizes are the ones of the target, since they are computed by its compiler
+ * @tparam Owner        class the component belongs to; it makes the report depend on the owner's template arguments,
+ *                      so that it is printed once for each instantiation of the owner
+ * @tparam Component    type of the component, or a tag naming it
+ * @tparam BYTES        bytes of RAM taken by the component
+ */
+template<class Owner, class Component, size_t BYTES>
+struct RamReport {
+    __attribute__((deprecated("RAM report, not an error"))) static void print() {}
+};
+
+/**
+ * Tag of the movements pool in RAM reports; it is part of Movements
+ */
+struct MovementsPool;
+
+/**
+ * Reports the RAM taken by a component of Owner (see RamReport) if OMNI3_RAM_REPORT is defined, otherwise it does
+ * nothing
+ */
+#ifdef OMNI3_RAM_REPORT
+#define OMNI3_REPORT_RAM(Owner, Component, bytes) RamReport<Owner, Component, (bytes)>::print()
+#else
+#define OMNI3_REPORT_RAM(Owner, Component, bytes)
+#endif
+
+#endif //OMNI3_FOOTPRINT_H
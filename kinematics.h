@@ -0,0 +1,353 @@
+#ifndef OMNI3_KINEMATICS_H
+#define OMNI3_KINEMATICS_H
+
+#include "Arduino.h"
+#include "fast_trig.h"
+
+/**
+ * Coefficients with smaller magnitude are rounded to 0, so that the terms of the wheels orthogonal to a direction are
+ * optimized away; it is above the rounding error of compile-time trigonometry on single precision doubles (AVR)
+ */
+#define KINEMATICS_EPSILON 1e-6
+
+/**
+ * This constexpr function reduces an angle to range [-PI, PI], at compile time
+ * @param angle     angle in radians
+ * @return equivalent angle in range [-PI, PI]
+ */
+constexpr double kinematicsReduce(double angle) {
+    return angle > PI ? kinematicsReduce(angle - TWO_PI) : angle < -PI ? kinematicsReduce(angle + TWO_PI) : angle;
+}
+
+/**
+ * This constexpr function rounds to 0 coefficients with magnitude below KINEMATICS_EPSILON
+ * @param value     coefficient
+ * @return rounded coefficient
+ */
+constexpr double kinematicsSnap(double value) {
+    return value < KINEMATICS_EPSILON && value > -KINEMATICS_EPSILON ? 0.0 : value;
+}
+
+/**
+ * This constexpr function computes the sine of an angle at compile time, rounding near zero results to 0
+ * @param angle     angle in radians
+ * @return sine of the angle
+ */
+constexpr double kinematicsSin(double angle) {
+    return kinematicsSnap(sinTaylorSeries(kinematicsReduce(angle) * kinematicsReduce(angle), kinematicsReduce(angle),
+                                          1));
+}
+
+/**
+ * This constexpr function computes the cosine of an angle at compile time, rounding near zero results to 0
+ * @param angle     angle in radians
+ * @return cosine of the angle
+ */
+constexpr double kinematicsCos(double angle) {
+    return kinematicsSin(angle + HALF_PI);
+}
+
+/**
+ * Geometry of omni wheels mounted at the same distance L from the center of the robot, each one driving tangentially
+ * to the circle they lie on: the wheel at angle a (clockwise from the forward direction, e.g. 2 o'clock is PI/3) turns
+ * at w = (sin(a)*forward + cos(a)*strafe + L*theta) / R, where strafe is positive leftwards and theta counterclockwise
+ * @tparam Layout   class providing static const uint8_t WHEELS and static constexpr double mountingAngle(uint8_t i)
+ */
+template<class Layout>
+struct OmniGeometry {
+    /**
+     * Number of wheels
+     */
+    static const uint8_t WHEELS = Layout::WHEELS;
+
+    /**
+     * Coefficient of the forward speed in the speed of a wheel, times wheels radius
+     * @param i     index of the wheel, in range [0, WHEELS)
+     * @return coefficient
+     */
+    static constexpr double forwardGain(uint8_t i) {
+        return kinematicsSin(Layout::mountingAngle(i));
+    }
+
+    /**
+     * Coefficient of the strafe speed in the speed of a wheel, times wheels radius
+     * @param i     index of the wheel, in range [0, WHEELS)
+     * @return coefficient
+     */
+    static constexpr double strafeGain(uint8_t i) {
+        return kinematicsCos(Layout::mountingAngle(i));
+    }
+};
+
+/**
+ * Layout of Omni3: wheels at 2, 6 and 10 o'clock (W_RIGHT, W_BACK, W_LEFT)
+ */
+struct Omni3Layout {
+    static const uint8_t WHEELS = 3;
+    static constexpr double mountingAngle(uint8_t i) {
+        return i == 0 ? PI/3 : i == 1 ? PI : 5*PI/3;
+    }
+};
+
+/**
+ * Layout of 4-wheel omni robots with wheels at the corners: front-right, back-right, back-left, front-left
+ */
+struct Omni4Layout {
+    static const uint8_t WHEELS = 4;
+    static constexpr double mountingAngle(uint8_t i) {
+        return PI/4 + i*HALF_PI;
+    }
+};
+
+/**
+ * Geometry of Omni3, the one of BasicOmni3
+ */
+typedef OmniGeometry<Omni3Layout> Omni3Geometry;
+
+/**
+ * Geometry of 4-wheel omni robots with wheels at the corners
+ */
+typedef OmniGeometry<Omni4Layout> Omni4Geometry;
+
+/**
+ * Geometry of mecanum robots with 45 degrees rollers in X configuration, wheels ordered front-right, back-right,
+ * back-left, front-left; L is the sum of the half wheelbase and the half track width; left motors must be wired so
+ * that a positive speed turns the robot counterclockwise, like the right ones, i.e. backwards
+ */
+struct MecanumGeometry {
+    static const uint8_t WHEELS = 4;
+    static constexpr double forwardGain(uint8_t i) {
+        return i < 2 ? 1.0 : -1.0;
+    }
+    static constexpr double strafeGain(uint8_t i) {
+        return i == 0 || i == 3 ? 1.0 : -1.0;
+    }
+};
+
+/**
+ * Type of the results of direct kinematics: the same as the wheels' speeds, except double for wheels' steps
+ * @tparam T    numeric type of the wheels' speeds
+ */
+template<class T>
+struct KinematicsResult {
+    typedef T type;
+};
+
+template<>
+struct KinematicsResult<long> {
+    typedef double type;
+};
+
+/**
+ * Class template generating the kinematics of a robot whose wheels all contribute L*theta to their speed, where L is
+ * the robot radius: inverse kinematics is w = (A*v + L*theta) / R, with A the WHEELS x 2 matrix of the geometry's
+ * gains, and direct kinematics is its least squares solution, computed through the pseudo-inverse of A; every
+ * coefficient is computed at compile time and the products are unrolled, so that zero terms are optimized away and no
+ * trigonometry or division is left at run time
+ * @tparam Geometry     class providing static const uint8_t WHEELS, static constexpr double forwardGain(uint8_t i)
+ *                      and strafeGain(uint8_t i); the gains of each direction must sum to 0, so that translation and
+ *                      rotation are decoupled, as in every symmetric layout (see OmniGeometry)
+ */
+template<class Geometry>
+class BasicKinematics {
+public:
+    /**
+     * Number of wheels
+     */
+    static const uint8_t WHEELS = Geometry::WHEELS;
+
+    /**
+     * Coefficient of a wheel's speed in the forward speed of the robot, divided by wheels radius (pseudo-inverse of A)
+     * @param i     index of the wheel, in range [0, WHEELS)
+     * @return coefficient
+     */
+    static constexpr double directForward(uint8_t i) {
+        return kinematicsSnap((sum(STRAFE_STRAFE) * Geometry::forwardGain(i) -
+                               sum(FORWARD_STRAFE) * Geometry::strafeGain(i)) / determinant());
+    }
+
+    /**
+     * Coefficient of a wheel's speed in the strafe speed of the robot, divided by wheels radius
+     * @param i     index of the wheel, in range [0, WHEELS)
+     * @return coefficient
+     */
+    static constexpr double directStrafe(uint8_t i) {
+        return kinematicsSnap((sum(FORWARD_FORWARD) * Geometry::strafeGain(i) -
+                               sum(FORWARD_STRAFE) * Geometry::forwardGain(i)) / determinant());
+    }
+
+    /**
+     * This method computes the translation component of the wheels' speeds, i.e. A*v
+     * @tparam T            numeric type, double or Fixed
+     * @param forward       forward component of the speed, divided by wheels radius
+     * @param strafe        strafe component of the speed, divided by wheels radius
+     * @param translation   array of len WHEELS where the components are stored
+     */
+    template<class T>
+    static void inverse(T forward, T strafe, T *translation);
+
+    /**
+     * This method computes the forward component of the robot's speed from the wheels' speeds
+     * @tparam T            numeric type, double, Fixed or long (wheels' steps, with double result)
+     * @param wheels        array of len WHEELS of wheels' speeds
+     * @return forward component, divided by wheels radius
+     */
+    template<class T>
+    static typename KinematicsResult<T>::type forward(const T *wheels);
+
+    /**
+     * This method computes the strafe component of the robot's speed from the wheels' speeds
+     * @tparam T            numeric type, double, Fixed or long (wheels' steps, with double result)
+     * @param wheels        array of len WHEELS of wheels' speeds
+     * @return strafe component, divided by wheels radius
+     */
+    template<class T>
+    static typename KinematicsResult<T>::type strafe(const T *wheels);
+
+    /**
+     * This method computes the sum of the wheels' speeds, which is WHEELS*L/R times the angular speed of the robot
+     * @tparam T            numeric type
+     * @param wheels        array of len WHEELS of wheels' speeds
+     * @return sum of the speeds
+     */
+    template<class T>
+    static T rotation(const T *wheels);
+
+private:
+    /**
+     * Products of gains summed by sum()
+     */
+    enum Products {FORWARD_FORWARD, FORWARD_STRAFE, STRAFE_STRAFE, FORWARD_ONE, STRAFE_ONE};
+
+    /**
+     * This constexpr method computes the sum over the wheels of a product of gains
+     * @param product   product to be summed
+     * @param i         index of the first wheel of the sum
+     * @return sum from wheel i on
+     */
+    static constexpr double sum(Products product, uint8_t i = 0) {
+        return i == WHEELS ? 0.0 : sum(product, i + 1) + (
+                product == FORWARD_FORWARD ? Geometry::forwardGain(i) * Geometry::forwardGain(i) :
+                product == FORWARD_STRAFE ? Geometry::forwardGain(i) * Geometry::strafeGain(i) :
+                product == STRAFE_STRAFE ? Geometry::strafeGain(i) * Geometry::strafeGain(i) :
+                product == FORWARD_ONE ? Geometry::forwardGain(i) : Geometry::strafeGain(i));
+    }
+
+    /**
+     * This constexpr method computes the determinant of the 2x2 matrix transpose(A)*A
+     * @return determinant
+     */
+    static constexpr double determinant() {
+        return sum(FORWARD_FORWARD) * sum(STRAFE_STRAFE) - sum(FORWARD_STRAFE) * sum(FORWARD_STRAFE);
+    }
+
+    /**
+     * This method checks at compile time that the geometry is supported
+     */
+    static void checkGeometry() {
+        static_assert(WHEELS >= 3, "Kinematics needs at least 3 wheels");
+        static_assert(kinematicsSnap(sum(FORWARD_ONE)) == 0.0 && kinematicsSnap(sum(STRAFE_ONE)) == 0.0,
+                      "Gains must sum to 0, so that translation and rotation are decoupled");
+        static_assert(kinematicsSnap(determinant()) > 0.0, "Wheels can't drive every direction");
+    }
+};
+
+/**
+ * Class template unrolling the products of BasicKinematics over the wheels, from the I-th on, with compile-time
+ * coefficients: terms with a 0 coefficient are skipped, and coefficients 1 and -1 don't need a multiplication
+ * @tparam Geometry     geometry of the robot
+ * @tparam I            index of the first wheel
+ * @tparam IS_END       true past the last wheel
+ */
+template<class Geometry, uint8_t I = 0, bool IS_END = (I == Geometry::WHEELS)>
+struct KinematicsUnroll {
+    typedef BasicKinematics<Geometry> Kinematics;
+    typedef KinematicsUnroll<Geometry, I + 1> Next;
+
+    template<class R, class T>
+    static R product(double gain, T value) {
+        return gain == 1.0 ? R(value) : gain == -1.0 ? -R(value) : R(gain) * R(value);
+    }
+
+    template<class T>
+    static void inverse(T forward, T strafe, T *translation) {
+        constexpr double FORWARD_GAIN = Geometry::forwardGain(I);
+        constexpr double STRAFE_GAIN = Geometry::strafeGain(I);
+        translation[I] = FORWARD_GAIN == 0.0 ? (STRAFE_GAIN == 0.0 ? T(0.0) : product<T>(STRAFE_GAIN, strafe)) :
+                         STRAFE_GAIN == 0.0 ? product<T>(FORWARD_GAIN, forward) :
+                         product<T>(FORWARD_GAIN, forward) + product<T>(STRAFE_GAIN, strafe);
+        Next::inverse(forward, strafe, translation);
+    }
+
+    template<class T>
+    static typename KinematicsResult<T>::type forward(const T *wheels) {
+        typedef typename KinematicsResult<T>::type R;
+        constexpr double GAIN = Kinematics::directForward(I);
+        return GAIN == 0.0 ? Next::forward(wheels) : Next::forward(wheels) + product<R>(GAIN, wheels[I]);
+    }
+
+    template<class T>
+    static typename KinematicsResult<T>::type strafe(const T *wheels) {
+        typedef typename KinematicsResult<T>::type R;
+        constexpr double GAIN = Kinematics::directStrafe(I);
+        return GAIN == 0.0 ? Next::strafe(wheels) : Next::strafe(wheels) + product<R>(GAIN, wheels[I]);
+    }
+
+    template<class T>
+    static T rotation(const T *wheels) {
+        return Next::rotation(wheels) + wheels[I];
+    }
+};
+
+/**
+ * End of the unrolled products
+ */
+template<class Geometry, uint8_t I>
+struct KinematicsUnroll<Geometry, I, true> {
+    template<class T>
+    static void inverse(T, T, T *) {}
+
+    template<class T>
+    static typename KinematicsResult<T>::type forward(const T *) {
+        return typename KinematicsResult<T>::type(0);
+    }
+
+    template<class T>
+    static typename KinematicsResult<T>::type strafe(const T *) {
+        return typename KinematicsResult<T>::type(0);
+    }
+
+    template<class T>
+    static T rotation(const T *) {
+        return T(0);
+    }
+};
+
+template<class Geometry>
+template<class T>
+void BasicKinematics<Geometry>::inverse(T forward, T strafe, T *translation) {
+    BasicKinematics::checkGeometry();
+    KinematicsUnroll<Geometry>::inverse(forward, strafe, translation);
+}
+
+template<class Geometry>
+template<class T>
+typename KinematicsResult<T>::type BasicKinematics<Geometry>::forward(const T *wheels) {
+    BasicKinematics::checkGeometry();
+    return KinematicsUnroll<Geometry>::forward(wheels);
+}
+
+template<class Geometry>
+template<class T>
+typename KinematicsResult<T>::type BasicKinematics<Geometry>::strafe(const T *wheels) {
+    BasicKinematics::checkGeometry();
+    return KinematicsUnroll<Geometry>::strafe(wheels);
+}
+
+template<class Geometry>
+template<class T>
+T BasicKinematics<Geometry>::rotation(const T *wheels) {
+    return KinematicsUnroll<Geometry>::rotation(wheels);
+}
+
+#endif //OMNI3_KINEMATICS_H
@@ -0,0 +1,182 @@
+#ifndef OMNI3_LOCK_FREE_H
+#define OMNI3_LOCK_FREE_H
+
+#include "Arduino.h"
+
+#if defined(ESP32) || defined(ARDUINO_ARCH_RP2040)
+
+/**
+ * Defined on dual-core MCUs, where the control loop can run on a core of its own (see ControlTask)
+ */
+#define OMNI3_MULTI_CORE
+
+/**
+ * Hardware memory barrier: on multi-core MCUs accesses must be ordered between cores as well, not only by the compiler
+ */
+#define OMNI3_MEMORY_BARRIER() __sync_synchronize()
+
+#else
+
+/**
+ * Compiler memory barrier: it prevents the compiler from moving memory accesses across it; on single core MCUs this is
+ * enough for ordering accesses between main loop and interrupt service routines
+ */
+#define OMNI3_MEMORY_BARRIER() __asm__ __volatile__("" ::: "memory")
+
+#endif
+
+/**
+ * Class for handing off data from the main loop (the only writer) to an interrupt service routine (the only reader)
+ * without disabling interrupts: the writer fills the buffer the reader is not using, then publishes it by flipping a
+ * single byte; since an ISR can't be preempted by the main loop, the published buffer is always complete when read
+ * @tparam T    type of the handed off data
+ */
+template<class T>
+class DoubleBuffer {
+public:
+    /**
+     * This method returns the buffer to be filled by the writer; it is published by calling publish()
+     * @return reference to the buffer not visible to the reader
+     */
+    T& writeBuffer() {
+        return buffers[1 - readIndex];
+    }
+
+    /**
+     * This method makes the buffer returned by writeBuffer() visible to the reader
+     */
+    void publish() {
+        OMNI3_MEMORY_BARRIER();
+        readIndex = 1 - readIndex;
+    }
+
+    /**
+     * This method returns the last published buffer; it must be called by the reader only
+     * @return reference to the last published buffer
+     */
+    const T& read() const {
+        return buffers[readIndex];
+    }
+
+private:
+    /**
+     * Buffers: buffers[readIndex] is visible to the reader, the other one is owned by the writer
+     */
+    T buffers[2] {};
+
+    /**
+     * Index of the published buffer
+     */
+    volatile uint8_t readIndex = 0;
+};
+
+/**
+ * Class for handing off data from an interrupt service routine or another core (the only writer) to the main loop (the
+ * only reader) without disabling interrupts: the writer makes the sequence number odd while it updates data, so that
+ * the reader retries the copy whenever it has been preempted by the writer or has raced with it
+ * @tparam T    type of the handed off data
+ */
+template<class T>
+class SeqLock {
+public:
+    /**
+     * This method publishes the given data; it must be called by the writer only
+     * @param data      data to be published
+     */
+    void write(const T& data) {
+        sequence = sequence + 1;
+        OMNI3_MEMORY_BARRIER();
+        this->value = data;
+        OMNI3_MEMORY_BARRIER();
+        sequence = sequence + 1;
+    }
+
+    /**
+     * This method copies the last published data; it must be called by the reader only
+     * @return consistent copy of the last published data
+     */
+    T read() const {
+        T copy;
+        uint8_t before, after;
+        do {
+            before = sequence;
+            OMNI3_MEMORY_BARRIER();
+            copy = this->value;
+            OMNI3_MEMORY_BARRIER();
+            after = sequence;
+        } while(before != after || (before & 1));
+        return copy;
+    }
+
+private:
+    /**
+     * Published data
+     */
+    T value {};
+
+    /**
+     * Sequence number: it is odd while the writer is updating value
+     */
+    volatile uint8_t sequence = 0;
+};
+
+/**
+ * Class implementing a bounded queue between a single producer and a single consumer, running in different contexts
+ * (main loop and interrupt, or different cores) without locks: each index is written by one side only, and an element
+ * is published by advancing the tail after it is complete
+ * @tparam T        type of the elements
+ * @tparam SIZE     capacity of the queue plus one, in range [2, 255]
+ */
+template<class T, uint8_t SIZE>
+class SpscQueue {
+public:
+    /**
+     * This method adds an element at the end of the queue; it must be called by the producer only
+     * @param element   element to be added
+     * @return true if the element was added, false if the queue is full
+     */
+    bool push(const T& element) {
+        uint8_t next = this->tail + 1 == SIZE ? 0 : this->tail + 1;
+        if(next == this->head) {
+            return false;
+        }
+        this->elements[this->tail] = element;
+        OMNI3_MEMORY_BARRIER();
+        this->tail = next;
+        return true;
+    }
+
+    /**
+     * This method removes the first element of the queue; it must be called by the consumer only
+     * @param element   pointer where the removed element is stored
+     * @return true if an element was removed, false if the queue is empty
+     */
+    bool pop(T *element) {
+        if(this->head == this->tail) {
+            return false;
+        }
+        OMNI3_MEMORY_BARRIER();
+        *element = this->elements[this->head];
+        OMNI3_MEMORY_BARRIER();
+        this->head = this->head + 1 == SIZE ? 0 : this->head + 1;
+        return true;
+    }
+
+private:
+    /**
+     * Elements of the queue: there is always at least one free, so that a full queue is told from an empty one
+     */
+    T elements[SIZE] {};
+
+    /**
+     * Index of the first element, written by the consumer only
+     */
+    volatile uint8_t head = 0;
+
+    /**
+     * Index after the last element, written by the producer only
+     */
+    volatile uint8_t tail = 0;
+};
+
+#endif //OMNI3_LOCK_FREE_H
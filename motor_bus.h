@@ -0,0 +1,278 @@
+#ifndef OMNI3_MOTOR_BUS_H
+#define OMNI3_MOTOR_BUS_H
+
+#include "Arduino.h"
+#include "crc.h"
+#include "bytes.h"
+
+/**
+ * Number of motors sharing a bus
+ */
+#define MOTOR_BUS_CHANNELS 3
+
+/**
+ * Command staged for a braked motor; the other commands are signed PWM values, in range [-MAX_PWM, MAX_PWM]
+ */
+#define MOTOR_BUS_BRAKE INT16_MIN
+
+/**
+ * Abstract class for buses shared by smart motor controllers (UART, CAN, I2C, SPI): the drivers of the wheels stage
+ * their commands into it (see BusMotor), without any bus traffic, and Omni3 flushes all of them with a single batched
+ * transaction per control cycle (see Omni3::setMotorBus()); the same transaction may bring back the encoders'
+ * positions, read by BusEncoder; child classes implement transfer(), which must not block, since it may run in the
+ * control interrupt: it should start an interrupt or DMA driven transaction and collect the reply of the previous one
+ */
+class MotorBus {
+public:
+    /**
+     * Virtual destructor
+     */
+    virtual ~MotorBus() = default;
+
+    /**
+     * This method stores the command of a motor, sent by the next flush()
+     * @param channel   index of the motor, in range [0, MOTOR_BUS_CHANNELS)
+     * @param command   signed PWM value, or MOTOR_BUS_BRAKE
+     */
+    void stage(uint8_t channel, int16_t command) {
+        this->commands[channel] = command;
+    }
+
+    /**
+     * This method sends the staged commands of all the motors with a single transaction
+     * @return true if the transaction started, false if the bus was busy and the commands are left for the next one
+     */
+    bool flush() {
+        this->isFlushing = true;
+        bool isStarted = this->transfer(this->commands, this->positions);
+        this->isFlushing = false;
+        if (!isStarted) {
+            this->skipped++;
+            return false;
+        }
+        return true;
+    }
+
+    /**
+     * This method sends the staged commands like flush(), from an interrupt that may have preempted another flush():
+     * transfer() is not reentrant, so in that case nothing is sent
+     * @return true if the transaction started, false if the interrupted context was flushing or the bus was busy
+     */
+    bool flushFromInterrupt() {
+        if (this->isFlushing) {
+            return false;
+        }
+        return this->flush();
+    }
+
+    /**
+     * Getter for the position of a motor's encoder, as of the last reply received by flush()
+     * @param channel   index of the motor, in range [0, MOTOR_BUS_CHANNELS)
+     * @return position in steps, 0 until the first reply
+     */
+    int32_t getPosition(uint8_t channel) const {
+        return this->positions[channel];
+    }
+
+    /**
+     * Getter for the number of calls to flush() skipped because the bus was busy
+     * @return number of skipped transactions
+     */
+    unsigned long getSkipped() const {
+        return this->skipped;
+    }
+
+protected:
+    /**
+     * Pure virtual method sending the commands of all the motors with a single transaction, without blocking; it must
+     * also store into positions the encoders' positions of any reply received meanwhile, leaving them unchanged if
+     * none
+     * @param commands  array of len MOTOR_BUS_CHANNELS of commands to be sent
+     * @param positions array of len MOTOR_BUS_CHANNELS of encoders' positions in steps
+     * @return true if the transaction started, false if the bus is busy
+     */
+    virtual bool transfer(const int16_t *commands, int32_t *positions) = 0;
+
+private:
+    /**
+     * Staged commands
+     */
+    int16_t commands[MOTOR_BUS_CHANNELS] {};
+
+    /**
+     * Encoders' positions of the last reply
+     */
+    int32_t positions[MOTOR_BUS_CHANNELS] {};
+
+    /**
+     * Number of transactions skipped because the bus was busy
+     */
+    unsigned long skipped = 0;
+
+    /**
+     * True while flush() is running
+     */
+    volatile bool isFlushing = false;
+};
+
+/**
+ * First byte of command and reply frames of StreamMotorBus
+ */
+#define MOTOR_BUS_SYNC 0xA5
+
+/**
+ * Size in bytes of a command frame: sync, sequence number, for each motor its command (int16), CRC-8 (see crc.h) of
+ * sequence number and commands
+ */
+#define MOTOR_BUS_COMMAND_SIZE (2 + MOTOR_BUS_CHANNELS*2 + 1)
+
+/**
+ * Size in bytes of a reply frame: sync, sequence number of the command it answers, for each motor its encoder's
+ * position (int32), CRC-8 of sequence number and positions
+ */
+#define MOTOR_BUS_REPLY_SIZE (2 + MOTOR_BUS_CHANNELS*4 + 1)
+
+/**
+ * Class implementing MotorBus on a stream (e.g. a UART shared by RS-485 or half-duplex controllers): each flush writes
+ * a command frame with a single write(), only if the transmit buffer has room for all of it, so that the transmit
+ * interrupt sends it in the background; controllers with encoders answer each command with a reply frame, which is
+ * parsed from the receive buffer, as far as it has arrived, by the following flushes; all numbers are little-endian
+ */
+class StreamMotorBus final: public MotorBus {
+public:
+    /**
+     * Constructor of StreamMotorBus class
+     * @param stream    stream the controllers are connected to, already begun (e.g. &Serial1)
+     */
+    explicit StreamMotorBus(Stream *stream) : stream(stream) {}
+
+    /**
+     * Getter for the number of reply frames discarded for a wrong CRC
+     * @return number of corrupted replies
+     */
+    unsigned long getErrors() const {
+        return this->errors;
+    }
+
+    /**
+     * Getter for the sequence number of the command answered by the last valid reply
+     * @return sequence number, compared with the one of the last command for measuring the latency of the bus
+     */
+    uint8_t getLastReply() const {
+        return this->lastReply;
+    }
+
+protected:
+    bool transfer(const int16_t *commands, int32_t *positions) override {
+        this->receive(positions);
+        if (this->stream->availableForWrite() < MOTOR_BUS_COMMAND_SIZE) {
+            return false;
+        }
+
+        uint8_t frame[MOTOR_BUS_COMMAND_SIZE];
+        uint8_t len = 0;
+        frame[len++] = MOTOR_BUS_SYNC;
+        frame[len++] = this->sequence++;
+        for (uint8_t i=0; i<MOTOR_BUS_CHANNELS; i++) {
+            len = writeLE16(frame, len, (uint16_t)commands[i]);
+        }
+        frame[len] = crc8(0, &frame[1], len - 1);
+        this->stream->write(frame, MOTOR_BUS_COMMAND_SIZE);
+        return true;
+    }
+
+private:
+    /**
+     * Stream the controllers are connected to
+     */
+    Stream *stream;
+
+    /**
+     * Sequence number of the next command frame
+     */
+    uint8_t sequence = 0;
+
+    /**
+     * Sequence number of the command answered by the last valid reply
+     */
+    uint8_t lastReply = 0;
+
+    /**
+     * Bytes of the reply frame being received
+     */
+    uint8_t reply[MOTOR_BUS_REPLY_SIZE] {};
+
+    /**
+     * Number of bytes of the reply frame received so far, 0 while looking for the sync byte
+     */
+    uint8_t received = 0;
+
+    /**
+     * Number of replies discarded for a wrong CRC
+     */
+    unsigned long errors = 0;
+
+    /**
+     * This method parses the bytes available in the receive buffer, storing the positions of each valid reply
+     * @param positions array of len MOTOR_BUS_CHANNELS of encoders' positions in steps
+     */
+    void receive(int32_t *positions) {
+        while (this->stream->available() > 0) {
+            uint8_t data = (uint8_t)this->stream->read();
+            if (this->received == 0 && data != MOTOR_BUS_SYNC) {
+                continue;
+            }
+            this->reply[this->received++] = data;
+            if (this->received < MOTOR_BUS_REPLY_SIZE) {
+                continue;
+            }
+
+            /* A whole frame arrived: on a wrong CRC, drop it and look for the next sync byte */
+            this->received = 0;
+            if (crc8(0, &this->reply[1], MOTOR_BUS_REPLY_SIZE - 2) != this->reply[MOTOR_BUS_REPLY_SIZE - 1]) {
+                this->errors++;
+                continue;
+            }
+            this->lastReply = this->reply[1];
+            for (uint8_t i=0; i<MOTOR_BUS_CHANNELS; i++) {
+                positions[i] = (int32_t)readLE32(&this->reply[2 + 4*i]);
+            }
+        }
+    }
+};
+
+/**
+ * Class reading a wheel's encoder position from the replies of a MotorBus, for BasicWheel<BusMotor, BusEncoder>:
+ * positions are those returned by the last transaction, which Omni3 flushes right after the wheels' PID, so they are
+ * a whole control cycle old when the next one samples them, for all the wheels alike
+ */
+class BusEncoder {
+public:
+    /**
+     * Constructor of BusEncoder class
+     * @param bus       bus the controller of the motor is connected to
+     * @param channel   index of the motor on the bus, in range [0, MOTOR_BUS_CHANNELS)
+     */
+    BusEncoder(MotorBus *bus, uint8_t channel) : bus(bus), channel(channel) {}
+
+    /**
+     * This method returns the position of the encoder
+     * @return position in steps, as of the last reply
+     */
+    int32_t read() const {
+        return this->bus->getPosition(this->channel);
+    }
+
+private:
+    /**
+     * Bus the controller of the motor is connected to
+     */
+    MotorBus *bus;
+
+    /**
+     * Index of the motor on the bus
+     */
+    uint8_t channel;
+};
+
+#endif //OMNI3_MOTOR_BUS_H
@@ -3,7 +3,8 @@
 
 /**
  * Abstract class for defining motor drivers; virtual methods setSpeed and setDirection must be implemented as described
- * in the methods documentation; a proper constructor receiving output pins must be added as well
+ * in the methods documentation; a proper constructor receiving output pins must be added as well; drivers should be
+ * declared final and have MotorDriver as friend, so that BasicWheel can call them without virtual dispatch
  */
 class MotorDriver {
 public:
@@ -27,11 +28,32 @@ public:
      * @param _speed     integer in [-MAX_PWM, MAX_PWM] range; sign indicates motor's direction of rotation
      */
     void setSpeed(int _speed) {
+        MotorDriver::applySpeed(*this, _speed);
+    }
+
+    /**
+     * Method for setting motor speed when the type of the driver is known at compile time: if Driver is a final class,
+     * setDirection() and setMagnitude() are called without virtual dispatch and can be inlined; drivers must declare
+     * MotorDriver as friend
+     * @tparam Driver   type of the driver, MotorDriver itself or one of its child classes
+     * @param driver    driver whose speed is set
+     * @param _speed    integer in [-MAX_PWM, MAX_PWM] range; sign indicates motor's direction of rotation
+     */
+    template<class Driver>
+    static void applySpeed(Driver &driver, int _speed) {
+        MotorDriver &base = driver;
+
         /* Force speed in [-MAX_PWM, MAX_PWM] range */
         _speed = MotorDriver::rangedSpeed(_speed);
 
+        /* If speed didn't change, direction and magnitude didn't either: skip hardware writes */
+        if(base.isSpeedSet && _speed == base.speed) {
+            return;
+        }
+
         /* Update current speed */
-        this->speed = _speed;
+        base.speed = _speed;
+        base.isSpeedSet = true;
 
         /* Compute direction according to speed sign, then extract speed absolute value */
         Direction direction = Direction::RELEASED;
@@ -44,8 +66,8 @@ public:
         }
 
         /* Set rotation direction and magnitude */
-        this->setDirection(direction);
-        this->setMagnitude(_speed);
+        driver.setDirection(direction);
+        driver.setMagnitude(_speed);
     }
 
     /**
@@ -86,6 +108,11 @@ private:
      */
     int speed=0;
 
+    /**
+     * False until the first call to setSpeed, so that the first one always reaches the hardware
+     */
+    bool isSpeedSet=false;
+
     /**
      * Returns a speed in the [-MAX_PWM, MAX_PWM] range
      * @param speed     value to be normalized
@@ -0,0 +1,74 @@
+#ifndef OMNI3_BUS_MOTOR_H
+#define OMNI3_BUS_MOTOR_H
+
+#include "../motor_driver.h"
+#include "../motor_bus.h"
+
+/**
+ * Class for handling smart controllers sharing a MotorBus: speed changes are only staged into the bus, and reach the
+ * controllers with the next MotorBus::flush(), together with the ones of the other motors
+ */
+class BusMotor final: public MotorDriver {
+public:
+    /**
+     * Constructor of BusMotor class
+     * @param bus       bus the controller is connected to
+     * @param channel   index of the motor on the bus, in range [0, MOTOR_BUS_CHANNELS)
+     */
+    BusMotor(MotorBus *bus, uint8_t channel) : bus(bus), channel(channel) {
+        /* Set motor speed to 0 */
+        this->setSpeed(0);
+    }
+
+private:
+    /**
+     * MotorDriver::applySpeed() calls setDirection() and setMagnitude() directly
+     */
+    friend class MotorDriver;
+
+    /**
+     * Bus the controller is connected to
+     */
+    MotorBus *bus;
+
+    /**
+     * Index of the motor on the bus
+     */
+    uint8_t channel;
+
+    /**
+     * Direction set by the last setDirection(), applied to the magnitude by setMagnitude()
+     */
+    Direction direction = Direction::RELEASED;
+
+    /**
+     * Sets motor speed absolute value, staging the signed command for the current direction
+     * @param speed     integer in [0, MAX_PWM] range
+     */
+    void setMagnitude(int speed) override {
+        switch(this->direction) {
+            case Direction::RELEASED:
+                this->bus->stage(this->channel, 0);
+                break;
+            case Direction::FORWARDS:
+                this->bus->stage(this->channel, (int16_t)speed);
+                break;
+            case Direction::BACKWARDS:
+                this->bus->stage(this->channel, (int16_t)-speed);
+                break;
+            case Direction::BRAKED:
+                this->bus->stage(this->channel, MOTOR_BUS_BRAKE);
+                break;
+        }
+    }
+
+    /**
+     * Sets motor direction; MotorDriver::applySpeed() always follows it with setMagnitude(), which stages the command
+     * @param dir       enum indicating whether the motor turns forwards or backwards or if it stays braked or released
+     */
+    void setDirection(Direction dir) override {
+        this->direction = dir;
+    }
+};
+
+#endif //OMNI3_BUS_MOTOR_H
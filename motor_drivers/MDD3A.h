@@ -2,22 +2,19 @@
 #define OMNI3_MDD3A_H
 
 #include "../motor_driver.h"
+#include "../fast_io.h"
 
 /**
  * Class for handling drivers with 2 PWM inputs
  */
-class MDD3A: public MotorDriver {
+class MDD3A final: public MotorDriver {
 public:
     /**
-     * Constructor of MR001004 class
+     * Constructor of MDD3A class
      * @param A     Pin number for analog pin A
      * @param B     Pin number for analog pin B
      */
     MDD3A(uint8_t A, uint8_t B) : A(A), B(B) {
-        /* Initialize pins as outputs */
-        pinMode(this->A, OUTPUT);
-        pinMode(this->B, OUTPUT);
-
         /* Initialize isPinHigh */
         this->isAHigh = false;
         this->isBHigh = false;
@@ -28,9 +25,14 @@ public:
 
 private:
     /**
-     * Pins numbers
+     * MotorDriver::applySpeed() calls setDirection() and setMagnitude() directly
+     */
+    friend class MotorDriver;
+
+    /**
+     * PWM pins, initialized as outputs
      */
-    const uint8_t A, B;
+    FastPWM A, B;
 
     /**
      * Booleans used for storing direction information
@@ -42,9 +44,9 @@ private:
      * @param speed     integer in [0, MAX_PWM] range
      */
     void setMagnitude(int speed) override {
-        /* Write a pulse with the given duty cycle multiplied by the direction */
-        analogWrite(this->isAHigh*this->A, speed);
-        analogWrite(this->isBHigh*this->B, speed);
+        /* Write a pulse with the given duty cycle on the pins set by the direction, keep the other ones low */
+        this->A.write(this->isAHigh ? speed : 0);
+        this->B.write(this->isBHigh ? speed : 0);
     }
 
     /**
@@ -2,11 +2,12 @@
 #define OMNI3_MR001004_H
 
 #include "../motor_driver.h"
+#include "../fast_io.h"
 
 /**
  * Class for handling drivers with 1 PWM and 2 digital inputs
  */
-class MR001004: public MotorDriver {
+class MR001004 final: public MotorDriver {
 public:
     /**
      * Constructor of MR001004 class
@@ -15,20 +16,25 @@ public:
      * @param B     Pin number for digital pin B (direction)
      */
     MR001004(unsigned char PWM, unsigned char A, unsigned char B) : PWM(PWM), A(A), B(B) {
-        /* Initialize pins as outputs */
-        pinMode(PWM, OUTPUT);
-        pinMode(A, OUTPUT);
-        pinMode(B, OUTPUT);
-
         /* Set motor speed to 0 */
         this->setSpeed(0);
     }
 
 private:
     /**
-     * Pins numbers
+     * MotorDriver::applySpeed() calls setDirection() and setMagnitude() directly
+     */
+    friend class MotorDriver;
+
+    /**
+     * PWM pin, initialized as output
+     */
+    FastPWM PWM;
+
+    /**
+     * Direction pins, initialized as outputs
      */
-    const unsigned char PWM, A, B;
+    FastPin A, B;
 
     /**
      * Sets motor speed absolute value
@@ -36,7 +42,7 @@ private:
      */
     void setMagnitude(int speed) override {
         /* Write a pulse with the given duty cycle */
-        analogWrite(this->PWM, speed);
+        this->PWM.write(speed);
     }
 
     /**
@@ -47,26 +53,26 @@ private:
         switch(dir) {
             /* If direction is released, write LOW on both A and B pins */
             case Direction::RELEASED:
-                digitalWrite(A, 0);
-                digitalWrite(B, 0);
+                this->A.write(false);
+                this->B.write(false);
                 break;
 
             /* If direction is forwards, write HIGH on pin A and LOW on pin B */
             case Direction::FORWARDS:
-                digitalWrite(A, 1);
-                digitalWrite(B, 0);
+                this->A.write(true);
+                this->B.write(false);
                 break;
 
             /* If direction is backwards, write HIGH on pin B and LOW on pin A */
             case Direction::BACKWARDS:
-                digitalWrite(A, 0);
-                digitalWrite(B, 1);
+                this->A.write(false);
+                this->B.write(true);
                 break;
 
             /* If direction is braked, write HIGH on both A and B pins */
             case Direction::BRAKED:
-                digitalWrite(A, 1);
-                digitalWrite(B, 1);
+                this->A.write(true);
+                this->B.write(true);
                 break;
         }
 
@@ -2,6 +2,19 @@
 #define OMNI3_MOVEMENTS_H
 
 #include "Arduino.h"
+#include <new>
+#include "footprint.h"
+#include "bytes.h"
+#include "ring_buffer.h"
+#include "fast_trig.h"
+#include "velocity_profile.h"
+
+/**
+ * Max number of finite movements that can be scheduled at the same time; it can be overridden as a compiler flag
+ */
+#ifndef OMNI3_MAX_MOVEMENTS
+#define OMNI3_MAX_MOVEMENTS 10
+#endif
 
 /**
  * Omni3 robots have 2 possible vector frames, each of them having 3 degrees of freedom (DOF)
@@ -50,6 +63,54 @@
  */
 #define TO_MILLIS 1000
 
+/**
+ * Default planar acceleration limit of profiled movements in m/s^2
+ */
+#define D_LINEAR_ACCELERATION 0.5
+
+/**
+ * Default angular acceleration limit of profiled movements in rad/s^2
+ */
+#define D_ANGULAR_ACCELERATION 2.0
+
+/**
+ * Default planar jerk limit of S-curve movements in m/s^3
+ */
+#define D_LINEAR_JERK 2.0
+
+/**
+ * Default angular jerk limit of S-curve movements in rad/s^3
+ */
+#define D_ANGULAR_JERK 8.0
+
+/**
+ * Gain in 1/s of the correction that profiled movements add to the profile speed, proportional to the distance between
+ * the robot and the point the profile should be at
+ */
+#define PROFILE_POSITION_GAIN 2.0
+
+/**
+ * Time in seconds a profiled movement can last after the end of its profile while the robot is not yet within
+ * tolerance from the target; the movement is finished anyway after it
+ */
+#define PROFILE_SETTLE_TIMEOUT 1.0
+
+/**
+ * Size in bytes of a packed waypoint, as taken by Movements::addTargetPosSpeedBatch(): x, y and phi, each a
+ * little-endian int16
+ */
+#define WAYPOINT_SIZE 6
+
+/**
+ * Meters in one unit of x and y of a packed waypoint (millimeters)
+ */
+#define WAYPOINT_LINEAR_UNIT 0.001
+
+/**
+ * Radians in one unit of phi of a packed waypoint (centiradians)
+ */
+#define WAYPOINT_ANGULAR_UNIT 0.01
+
 /**
  * This macro computes the square of a number (^2)
  */
@@ -76,6 +137,23 @@
  * This class handles movements of the robot
  */
 class Movements {
+public:
+    /**
+     * Enumeration of movement types; values are equal to the corresponding movement types of Omni3 messages
+     */
+    enum class MovementType : uint8_t {
+        STILL = 0,
+        SPEED_INDEFINITE = 1,
+        NORM_SPEED_INDEFINITE = 2,
+        SPACE_TIME_LINEAR = 3,
+        SPACE_SPEED_LINEAR = 4,
+        SPACE_NORM_SPEED_LINEAR = 5,
+        SPEED_TIME_LINEAR = 6,
+        NORM_SPEED_TIME_LINEAR = 7,
+        SPACE_SPEED_TRAPEZOID = 8,
+        SPACE_SPEED_S_CURVE = 9
+    };
+
 private:
     /**
      * This abstract class describes a generic movement
@@ -96,6 +174,12 @@ private:
          */
         virtual bool getSpeed(unsigned long time, double *targetSpeed) = 0;
 
+        /**
+         * This pure virtual method must be overridden by a method returning the type of the movement
+         * @return type of the movement
+         */
+        virtual MovementType getType() const = 0;
+
     protected:
         /**
          * This method returns the minimum angular distance between two angular positions
@@ -107,6 +191,23 @@ private:
             double angDist = abs(phi1 - phi2);
             return angDist>PI ? TWO_PI-angDist : angDist;
         }
+
+        /**
+         * This method returns the signed minimum angular distance between two angular positions
+         * @param to      final angle in radians
+         * @param from    initial angle in radians
+         * @return angular distance in radians, positive anti-clockwise; it will be in range [-PI, PI]
+         */
+        static double signedAngularDistance(double to, double from) {
+            double angDist = fmod(to - from, TWO_PI);
+            if(angDist > PI) {
+                angDist -= TWO_PI;
+            }
+            else if(angDist < -PI) {
+                angDist += TWO_PI;
+            }
+            return angDist;
+        }
     };
 
     /**
@@ -131,6 +232,22 @@ private:
          */
         virtual bool isFinished(const double *position, const double *brakingSpace, unsigned long time) = 0;
 
+        /**
+         * This method returns the target position of the movement, if it has one; movements having a target position
+         * can be blended with the following ones (see Movements::setCornerTolerance())
+         * @return array of len DOF with target position ([m, m, rad]), nullptr if the movement has no target position
+         */
+        virtual const double* getTarget() const {
+            return nullptr;
+        }
+
+        /**
+         * This method is called when the movement becomes current because the previous one was blended into it,
+         * before its first isFinished(); movements that plan their speed profile can start it at the current speed
+         * @param speed         current speed of the robot ([m/s, m/s, rad/s])
+         */
+        virtual void setEntrySpeed(const double *speed) {}
+
     protected:
         /**
          * This method computes the conversion from (POS_X, POS_Y) coordinates to (FORWARD, STRAFE) coordinates
@@ -141,11 +258,14 @@ private:
          * @param new_y     y component of output vector
          */
         static void xyToSF(double x, double y, double phi, double *new_x, double *new_y) {
+            double sinPhi, cosPhi;
+            fastSinCos(phi, &sinPhi, &cosPhi);
+
             /* x' = x*cos(phi) + y*sin(phi) */
-            *new_x = x*cos(phi) + y*sin(phi);
+            *new_x = x*cosPhi + y*sinPhi;
 
             /* y' = -x*sin(phi) + y*cos(phi) */
-            *new_y = -x*sin(phi) + y*cos(phi);
+            *new_y = -x*sinPhi + y*cosPhi;
         }
 
         /**
@@ -173,18 +293,12 @@ private:
          * Virtual destructor
          */
         ~IndefiniteMovement() override = default;
-
-        /**
-         * Pure virtual method for deleting the object: if the object can be deleted, override this method with
-         * "delete this;", otherwise override it with an empty method
-         */
-        virtual void free() = 0;
     };
 
     /**
      * This class describes the indefinite movement of staying still in the same position; it is the default
      * movement, so if no other movements are set, the robot will stay still; for this reason, this class is
-     * a singleton, so that it won't be instanced and deleted everytime
+     * a singleton, so that it won't be taken from the movements pool everytime
      */
     class Still : public IndefiniteMovement {
     public:
@@ -204,9 +318,11 @@ private:
         }
 
         /**
-         * This method does nothing, since a Singleton can't be deleted
+         * @return type of the movement
          */
-        void free() override {}
+        MovementType getType() const override {
+            return MovementType::STILL;
+        }
 
         /**
          * This method returns a pointer, that is the instance of the Still singleton
@@ -322,6 +438,20 @@ private:
             return false;
         }
 
+        /**
+         * @return type of the movement
+         */
+        MovementType getType() const override {
+            return MovementType::SPACE_TIME_LINEAR;
+        }
+
+        /**
+         * @return array with target position ([m, m, rad])
+         */
+        const double* getTarget() const override {
+            return this->target;
+        }
+
     private:
         /**
          * Vector with target positions
@@ -416,6 +546,20 @@ private:
             return false;
         }
 
+        /**
+         * @return type of the movement
+         */
+        MovementType getType() const override {
+            return MovementType::SPACE_SPEED_LINEAR;
+        }
+
+        /**
+         * @return array with target position ([m, m, rad])
+         */
+        const double* getTarget() const override {
+            return this->target;
+        }
+
     private:
         /**
          * Vector with target positions
@@ -468,6 +612,13 @@ private:
             SpaceSpeedLinear::getSpeed(time, targetSpeed);
             return true;
         }
+
+        /**
+         * @return type of the movement
+         */
+        MovementType getType() const override {
+            return MovementType::SPACE_NORM_SPEED_LINEAR;
+        }
     };
 
     /**
@@ -529,6 +680,13 @@ private:
             return false;
         }
 
+        /**
+         * @return type of the movement
+         */
+        MovementType getType() const override {
+            return MovementType::SPEED_TIME_LINEAR;
+        }
+
     private:
         /**
          * Vector with target positions
@@ -562,8 +720,8 @@ private:
          * @param duration  duration of the movement in seconds
          */
         NormSpeedTimeLinear(double speedNorm, double theta, double angularNorm, double duration) :
-        SpeedTimeLinear(nSpAngMag(speedNorm, angularNorm) * cos(theta),
-                        nSpAngMag(speedNorm, angularNorm) * sin(theta),
+        SpeedTimeLinear(nSpAngMag(speedNorm, angularNorm) * fastCos(theta),
+                        nSpAngMag(speedNorm, angularNorm) * fastSin(theta),
                         nSpAngSMag(angularNorm, speedNorm),
                         duration
                         ) {}
@@ -579,8 +737,273 @@ private:
             SpeedTimeLinear::getSpeed(time, targetSpeed);
             return true;
         }
+
+        /**
+         * @return type of the movement
+         */
+        MovementType getType() const override {
+            return MovementType::NORM_SPEED_TIME_LINEAR;
+        }
     };
 
+#if OMNI3_PROFILED_MOVEMENTS
+    /**
+     * This class describes the finite movement that brings the robot to the requested position along a straight line,
+     * following a time-optimal trapezoidal speed profile with the given speed and acceleration limits; planar and
+     * angular motions have independent profiles, planned when the movement starts
+     */
+    class SpaceSpeedTrapezoid : public FiniteMovement {
+    public:
+        /**
+         * Constructor of the movement described by space, speed and acceleration limits
+         * @param x             target x coordinate in meters
+         * @param y             target y coordinate in meters
+         * @param phi           target phi coordinate in radians
+         * @param speedMag      maximum magnitude of planar speed vector in meters per second
+         * @param angularMag    maximum magnitude of angular speed in radians per second
+         * @param linearAcc     maximum planar acceleration in m/s^2
+         * @param angularAcc    maximum angular acceleration in rad/s^2
+         */
+        SpaceSpeedTrapezoid(double x, double y, double phi, double speedMag, double angularMag, double linearAcc,
+                            double angularAcc) :
+                SpaceSpeedTrapezoid(x, y, phi, speedMag, angularMag, linearAcc, angularAcc, 0.0, 0.0) {}
+
+        /**
+         * This overriding method, given the current position and the time, computes where the robot should be
+         * according to the profiles and sets _isFinished values to true once the profiles ended and the robot is
+         * within tolerance of the target; profiles brake by themselves, so braking space is not used
+         * @param position      current position of the robot ([m, m, rad])
+         * @param brakingSpace  space needed by the robot to stop ([m, m, rad])
+         * @param time          current time in milliseconds
+         * @return true if all movement components finished, false otherwise
+         */
+        bool isFinished(const double *position, const double *brakingSpace, unsigned long time) override {
+            /* On first call of this method on this object, plan the profiles from the current position */
+            if(this->startTime == 0) {
+                /* Since a start time of 0 is seen as uninitialized, if time is by chance 0, it is set to 1 */
+                this->startTime = time!=0 ? time : 1;
+                this->plan(position);
+            }
+            double elapsed = (time - this->startTime) * MILLIS;
+
+            /* Evaluate the profiles: reference position and speed, in the (POS_X, POS_Y, POS_PHI) frame */
+            double linearPos, linearSpeed, angularPos, angularSpeed;
+            this->linearProfile.evaluate(elapsed, &linearPos, &linearSpeed);
+            this->angularProfile.evaluate(elapsed, &angularPos, &angularSpeed);
+
+            /* Convert the profile speed and the distance from the reference position to the robot frame */
+            FiniteMovement::xyToSF(linearSpeed * this->direction[POS_X], linearSpeed * this->direction[POS_Y],
+                                   position[POS_PHI], &this->tracking.speed[FORWARD], &this->tracking.speed[STRAFE]);
+            this->tracking.speed[THETA] = this->direction[POS_PHI] * angularSpeed;
+            FiniteMovement::xyToSF(this->start[POS_X] + linearPos * this->direction[POS_X] - position[POS_X],
+                                   this->start[POS_Y] + linearPos * this->direction[POS_Y] - position[POS_Y],
+                                   position[POS_PHI], &this->tracking.error[FORWARD], &this->tracking.error[STRAFE]);
+            this->tracking.error[THETA] = Movement::signedAngularDistance(
+                    this->start[POS_PHI] + this->direction[POS_PHI] * angularPos, position[POS_PHI]);
+
+            /* Each component is finished when its profile ended and the robot is within tolerance of the target */
+            const double duration = max(this->linearProfile.getDuration(), this->angularProfile.getDuration());
+            this->_isFinished[FORWARD] = this->_isFinished[STRAFE] = elapsed >= duration &&
+                    vectorsSumMag(this->tracking.error[FORWARD], this->tracking.error[STRAFE]) <= linearTolerance;
+            this->_isFinished[THETA] = elapsed >= duration && abs(this->tracking.error[THETA]) <= angularTolerance;
+
+            /* return true if the movement is completed for all the components, or if the robot can't settle */
+            return (_isFinished[FORWARD] && _isFinished[THETA]) || elapsed >= duration + PROFILE_SETTLE_TIMEOUT;
+        }
+
+        /**
+         * This overriding method sets targetSpeed vector to the profile speed, corrected proportionally to the
+         * distance between the robot and the reference position
+         * @param time          current time in milliseconds
+         * @param targetSpeed   array in which target speed vector ([m/s, m/s, rad/s]) is stored
+         * @return false, since targetSpeed array is not normalized
+         */
+        bool getSpeed(unsigned long time, double *targetSpeed) override {
+            for(uint8_t i=0; i<DOF; i++) {
+                targetSpeed[i] = this->tracking.speed[i] + PROFILE_POSITION_GAIN * this->tracking.error[i];
+            }
+            return false;
+        }
+
+        /**
+         * @return type of the movement
+         */
+        MovementType getType() const override {
+            return MovementType::SPACE_SPEED_TRAPEZOID;
+        }
+
+        /**
+         * @return array with target position ([m, m, rad])
+         */
+        const double* getTarget() const override {
+            return this->target;
+        }
+
+        /**
+         * This overriding method stores the current speed, so that profiles start from it instead of from rest
+         * @param speed         current speed of the robot ([m/s, m/s, rad/s])
+         */
+        void setEntrySpeed(const double *speed) override {
+            for(uint8_t i=0; i<DOF; i++) {
+                this->planning.entrySpeed[i] = speed[i];
+            }
+        }
+
+    protected:
+        /**
+         * Constructor of the movement described by space, speed, acceleration and jerk limits
+         * @param x             target x coordinate in meters
+         * @param y             target y coordinate in meters
+         * @param phi           target phi coordinate in radians
+         * @param speedMag      maximum magnitude of planar speed vector in meters per second
+         * @param angularMag    maximum magnitude of angular speed in radians per second
+         * @param linearAcc     maximum planar acceleration in m/s^2
+         * @param angularAcc    maximum angular acceleration in rad/s^2
+         * @param linearJerk    maximum planar jerk in m/s^3, 0.0 for a trapezoidal profile
+         * @param angularJerk   maximum angular jerk in rad/s^3, 0.0 for a trapezoidal profile
+         */
+        SpaceSpeedTrapezoid(double x, double y, double phi, double speedMag, double angularMag, double linearAcc,
+                            double angularAcc, double linearJerk, double angularJerk) {
+            this->target[POS_X] = x;
+            this->target[POS_Y] = y;
+            this->target[POS_PHI] = phi;
+            this->planning.limits[0] = speedMag;
+            this->planning.limits[1] = angularMag;
+            this->planning.limits[2] = linearAcc;
+            this->planning.limits[3] = angularAcc;
+            this->planning.limits[4] = linearJerk;
+            this->planning.limits[5] = angularJerk;
+            for(uint8_t i=0; i<DOF; i++) {
+                this->planning.entrySpeed[i] = 0.0;
+            }
+        }
+
+    private:
+        /**
+         * Vector with target positions
+         */
+        double target[DOF] {};
+
+        /**
+         * Vector with the position of the robot when the movement started
+         */
+        double start[DOF] {};
+
+        /**
+         * Unit vector of the planar motion in the (POS_X, POS_Y) frame and sign of the angular motion
+         */
+        double direction[DOF] {};
+
+        /**
+         * Arguments of plan(), and state of the profiles' tracking after it: the movement needs only one of them at a
+         * time, so they share their storage; getSpeed() reads the tracking state only after isFinished() planned
+         */
+        union {
+            struct {
+                /**
+                 * Planar and angular speed, planar and angular acceleration, planar and angular jerk limits
+                 */
+                double limits[6];
+
+                /**
+                 * Speed of the robot when the movement became current, if the previous movement was blended into it
+                 */
+                double entrySpeed[DOF];
+            } planning;
+
+            struct {
+                /**
+                 * Speed given by the profiles, in the (FORWARD, STRAFE, THETA) frame
+                 */
+                double speed[DOF];
+
+                /**
+                 * Distance between reference and current position, in the (FORWARD, STRAFE, THETA) frame
+                 */
+                double error[DOF];
+            } tracking;
+        };
+
+        /**
+         * Profile of the distance covered along the straight line from start to target
+         */
+        VelocityProfile linearProfile;
+
+        /**
+         * Profile of the angle covered from start to target
+         */
+        VelocityProfile angularProfile;
+
+        /**
+         * Time when then movement started
+         */
+        unsigned long startTime = 0;
+
+        /**
+         * This method plans the planar and angular profiles from the given start position
+         * @param position      current position of the robot ([m, m, rad])
+         */
+        void plan(const double *position) {
+            for(uint8_t i=0; i<DOF; i++) {
+                this->start[i] = position[i];
+            }
+
+            /* Planar motion follows the straight line to the target */
+            const double dx = this->target[POS_X] - position[POS_X];
+            const double dy = this->target[POS_Y] - position[POS_Y];
+            const double distance = vectorsSumMag(dx, dy);
+            this->direction[POS_X] = distance > 0.0 ? dx / distance : 0.0;
+            this->direction[POS_Y] = distance > 0.0 ? dy / distance : 0.0;
+
+            /* Profiles start from the component of the entry speed along the motion, rotated to (POS_X, POS_Y) */
+            double entryX, entryY;
+            FiniteMovement::xyToSF(this->planning.entrySpeed[FORWARD], this->planning.entrySpeed[STRAFE],
+                                   -position[POS_PHI], &entryX, &entryY);
+            this->linearProfile.plan(distance, entryX * this->direction[POS_X] + entryY * this->direction[POS_Y],
+                                     this->planning.limits[0], this->planning.limits[2], this->planning.limits[4]);
+
+            /* Angular motion takes the shortest way to the target */
+            const double angularDistance = Movement::signedAngularDistance(this->target[POS_PHI], position[POS_PHI]);
+            this->direction[POS_PHI] = angularDistance >= 0.0 ? 1.0 : -1.0;
+            this->angularProfile.plan(abs(angularDistance),
+                                      this->planning.entrySpeed[THETA] * this->direction[POS_PHI],
+                                      this->planning.limits[1], this->planning.limits[3], this->planning.limits[5]);
+        }
+    };
+
+    /**
+     * This class describes the finite movement that brings the robot to the requested position along a straight line,
+     * following a jerk-limited (S-curve) speed profile; compared to the trapezoidal one, acceleration ramps up and down
+     * instead of stepping, so motors are never asked for a sudden change of torque
+     */
+    class SpaceSpeedSCurve : public SpaceSpeedTrapezoid {
+    public:
+        /**
+         * Constructor of the movement described by space, speed, acceleration and jerk limits
+         * @param x             target x coordinate in meters
+         * @param y             target y coordinate in meters
+         * @param phi           target phi coordinate in radians
+         * @param speedMag      maximum magnitude of planar speed vector in meters per second
+         * @param angularMag    maximum magnitude of angular speed in radians per second
+         * @param linearAcc     maximum planar acceleration in m/s^2
+         * @param angularAcc    maximum angular acceleration in rad/s^2
+         * @param linearJerk    maximum planar jerk in m/s^3
+         * @param angularJerk   maximum angular jerk in rad/s^3
+         */
+        SpaceSpeedSCurve(double x, double y, double phi, double speedMag, double angularMag, double linearAcc,
+                         double angularAcc, double linearJerk, double angularJerk) :
+                SpaceSpeedTrapezoid(x, y, phi, speedMag, angularMag, linearAcc, angularAcc, linearJerk,
+                                    angularJerk) {}
+
+        /**
+         * @return type of the movement
+         */
+        MovementType getType() const override {
+            return MovementType::SPACE_SPEED_S_CURVE;
+        }
+    };
+#endif
+
     /**
      * This class describes the indefinite movement that makes the robot move with the requested speeds
      */
@@ -612,10 +1035,10 @@ private:
         }
 
         /**
-         * Overriding method for deleting the object
+         * @return type of the movement
          */
-        void free() override {
-            delete this;
+        MovementType getType() const override {
+            return MovementType::SPEED_INDEFINITE;
         }
 
     private:
@@ -637,8 +1060,8 @@ private:
          * @param angularNorm   norm of angular speed vector (it must be in range [-1.0, 1.0])
          */
         NormSpeedIndefinite(double speedNorm, double theta, double angularNorm) :
-        SpeedIndefinite(nSpAngMag(speedNorm, angularNorm) * cos(theta),
-                        nSpAngMag(speedNorm, angularNorm) * sin(theta),
+        SpeedIndefinite(nSpAngMag(speedNorm, angularNorm) * fastCos(theta),
+                        nSpAngMag(speedNorm, angularNorm) * fastSin(theta),
                         nSpAngSMag(angularNorm, speedNorm)
                         ) {}
 
@@ -653,64 +1076,201 @@ private:
             SpeedIndefinite::getSpeed(time, targetSpeed);
             return true;
         }
+
+        /**
+         * @return type of the movement
+         */
+        MovementType getType() const override {
+            return MovementType::NORM_SPEED_INDEFINITE;
+        }
     };
 
     /**
-     * Define max number of movements in movementSchedule array
+     * Define max number of movements in movementSchedule queue
      */
-    #define MAX_MOVEMENTS 10
+    #define MAX_MOVEMENTS OMNI3_MAX_MOVEMENTS
 
     /**
-     * Array of scheduled movements
+     * Define number of slots of the movements pool: every scheduled FiniteMovement, the current IndefiniteMovement and
+     * the IndefiniteMovement that is replacing it
      */
-    FiniteMovement *movementsSchedule[MAX_MOVEMENTS] = { nullptr };
+    #define MOVEMENTS_POOL_SIZE (MAX_MOVEMENTS + 2)
 
     /**
-     * Movement performed if *movementSchedule[0] is equal to nullptr; it's set to Still every time a new FiniteMovement
-     * is scheduled; so there is no need to call addStop(), unless last scheduled movement was an IndefiniteMovement
+     * Slot of the movements pool: it is large enough for storing any movement type; while the slot is free, it stores
+     * the pointer to the next free slot
      */
-    IndefiniteMovement *defaultMovement = Still::getInstance();
+    union MovementSlot {
+        char spaceTimeLinear[sizeof(SpaceTimeLinear)];
+        char spaceSpeedLinear[sizeof(SpaceSpeedLinear)];
+        char spaceNormSpeedLinear[sizeof(SpaceNormSpeedLinear)];
+        char speedTimeLinear[sizeof(SpeedTimeLinear)];
+        char normSpeedTimeLinear[sizeof(NormSpeedTimeLinear)];
+        char speedIndefinite[sizeof(SpeedIndefinite)];
+        char normSpeedIndefinite[sizeof(NormSpeedIndefinite)];
+#if OMNI3_PROFILED_MOVEMENTS
+        char spaceSpeedTrapezoid[sizeof(SpaceSpeedTrapezoid)];
+        char spaceSpeedSCurve[sizeof(SpaceSpeedSCurve)];
+#endif
+        double alignment;
+        MovementSlot *nextFree;
+    };
 
     /**
-     * Index of the first free element of the array
+     * Statically allocated pool, from which all the movements objects (but Still singleton) are taken, so that
+     * scheduling a movement never uses the heap
      */
-    uint8_t freeIndex = 0;
+    MovementSlot movementsPool[MOVEMENTS_POOL_SIZE];
+
+    /**
+     * Head of the list of free slots of the movements pool, nullptr if the pool is full
+     */
+    MovementSlot *freeSlots = nullptr;
+
+    /**
+     * This method takes a free slot from the pool and constructs in it a movement of the given type
+     * @tparam T        type of the movement
+     * @param args      arguments of the constructor of the movement
+     * @return pointer to the constructed movement, nullptr if the pool is full
+     */
+    template<class T, class... Args>
+    T* createMovement(Args... args) {
+        static_assert(sizeof(T) <= sizeof(MovementSlot), "Movement type does not fit in the pool slots");
+
+        /* If there are no free slots, return nullptr */
+        MovementSlot *slot = this->freeSlots;
+        if(slot == nullptr) {
+            return nullptr;
+        }
+
+        /* Otherwise, remove the slot from the free list and construct the movement in it */
+        this->freeSlots = slot->nextFree;
+        return new (slot) T(args...);
+    }
+
+    /**
+     * This method destroys a movement taken from the pool and gives its slot back to the pool; Still singleton is
+     * ignored, since it doesn't belong to the pool
+     * @param movement  movement to be destroyed
+     */
+    void destroyMovement(Movement *movement) {
+        if(movement == nullptr || movement == Still::getInstance()) {
+            return;
+        }
+        movement->~Movement();
+
+        /* Push the slot at the head of the free list */
+        MovementSlot *slot = reinterpret_cast<MovementSlot*>(movement);
+        slot->nextFree = this->freeSlots;
+        this->freeSlots = slot;
+    }
+
+    /**
+     * Queue of scheduled movements: the first one is the current movement
+     */
+    RingBuffer<FiniteMovement*, MAX_MOVEMENTS> movementsSchedule;
+
+    /**
+     * Movement performed if movementSchedule is empty; it's set to Still every time a new FiniteMovement is scheduled;
+     * so there is no need to call addStop(), unless last scheduled movement was an IndefiniteMovement
+     */
+    IndefiniteMovement *defaultMovement = Still::getInstance();
 
     /**
      * Coefficients that, multiplied by the square of the corresponding speed component, returns the braking space
      */
     double frictionCoefficient[DOF]{};
 
+    /**
+     * Limits of profiled movements: planar and angular acceleration, planar and angular jerk
+     */
+    double profileLimits[4] = {D_LINEAR_ACCELERATION, D_ANGULAR_ACCELERATION, D_LINEAR_JERK, D_ANGULAR_JERK};
+
+    /**
+     * Planar distance in meters from the target of the current movement within which it is blended into the next one,
+     * 0.0 if blending is disabled
+     */
+    double cornerTolerance = 0.0;
+
+    /**
+     * This method checks whether the current movement can be blended into the next one: both must have a target
+     * position and the robot must be within cornerTolerance of the target of the current one
+     * @param position      current position of the robot ([m, m, rad])
+     * @return true if the current movement can be removed from the schedule, false otherwise
+     */
+    bool isCornerReached(const double *position) const {
+        if(this->cornerTolerance <= 0.0 || this->movementsSchedule.size() < 2) {
+            return false;
+        }
+        const double *target = this->movementsSchedule[0]->getTarget();
+        if(target == nullptr || this->movementsSchedule[1]->getTarget() == nullptr) {
+            return false;
+        }
+        return vectorsSumMag(target[POS_X] - position[POS_X], target[POS_Y] - position[POS_Y]) <=
+                this->cornerTolerance;
+    }
+
+    /**
+     * This method decodes a little-endian int16, independently of the byte order of the MCU
+     * @param data      first of the two bytes
+     * @return decoded number
+     */
+    static int16_t decodeInt16(const uint8_t *data) {
+        return (int16_t)readLE16(data);
+    }
+
     /**
      * This method sets the given IndefiniteMovement as current
-     * @param indefiniteMovement    movement to be set
+     * @param indefiniteMovement    movement to be set; if nullptr (i.e. because the pool is full), nothing changes
+     * @return true if movement was set, false otherwise
      */
-    void setIndefiniteMovement(IndefiniteMovement *indefiniteMovement) {
+    bool setIndefiniteMovement(IndefiniteMovement *indefiniteMovement) {
+        if(indefiniteMovement == nullptr) {
+            return false;
+        }
+
         /* Unschedule current IndefiniteMovement */
-        this->defaultMovement->free();
+        this->destroyMovement(this->defaultMovement);
 
         /* Set current indefinite movement */
         this->defaultMovement = indefiniteMovement;
+        return true;
     }
 
     /**
-     * This method appends the given FiniteMovement to the schedule
-     * @param finiteMovement        movement to be appended
-     * @return true if movement was appended, false otherwise
+     * This method constructs a FiniteMovement of the given type in the pool and appends it to the schedule
+     * @tparam T            type of the movement
+     * @param replaceTail   if true, the movement replaces the last scheduled one (if any) instead of being appended
+     * @param args          arguments of the constructor of the movement
+     * @return true if movement was appended, false otherwise (i.e. because schedule is full)
      */
-    bool appendFiniteMovement(FiniteMovement *finiteMovement) {
-        /* If schedule is full, delete finiteMovement object and return false */
-        if(freeIndex >= MAX_MOVEMENTS) {
-            delete finiteMovement;
+    template<class T, class... Args>
+    bool appendFiniteMovement(bool replaceTail, Args... args) {
+        /* Replacing the tail of an empty schedule is the same as appending */
+        replaceTail = replaceTail && !this->movementsSchedule.isEmpty();
+
+        /* If schedule is full, return false */
+        if(!replaceTail && this->movementsSchedule.isFull()) {
+            return false;
+        }
+
+        /* If the pool is full, return false */
+        FiniteMovement *finiteMovement = this->createMovement<T>(args...);
+        if(finiteMovement == nullptr) {
             return false;
         }
 
         /* Unschedule IndefiniteMovement that may be instanced */
         addStop();
 
-        /* Otherwise, place finiteMovement in the schedule, increment freeIndex and return true */
-        this->movementsSchedule[freeIndex] = finiteMovement;
-        freeIndex++;
+        /* Otherwise, place finiteMovement in the schedule and return true */
+        if(replaceTail) {
+            this->destroyMovement(this->movementsSchedule.back());
+            this->movementsSchedule.back() = finiteMovement;
+        }
+        else {
+            this->movementsSchedule.push(finiteMovement);
+        }
         return true;
     }
 
@@ -725,6 +1285,12 @@ public:
         this->frictionCoefficient[FORWARD] = forwardFrictionK;
         this->frictionCoefficient[STRAFE] = strafeFrictionK;
         this->frictionCoefficient[THETA] = angularFrictionK;
+
+        /* Link all the slots of the pool in the free list */
+        for(uint8_t i=0; i<MOVEMENTS_POOL_SIZE; i++) {
+            this->movementsPool[i].nextFree = this->freeSlots;
+            this->freeSlots = &this->movementsPool[i];
+        }
     }
 
     /**
@@ -732,6 +1298,16 @@ public:
      */
     Movements() : Movements(0.0, 0.0, 0.0) {}
 
+    /**
+     * Scheduled movements point inside the pool of the object, so it can't be copied
+     */
+    Movements(const Movements&) = delete;
+
+    /**
+     * Delete assign operator
+     */
+    void operator = (const Movements&) = delete;
+
     /**
      * Setter for friction constants
      * @param forwardFrictionK  coefficient of friction on forward component of speed vector
@@ -744,6 +1320,41 @@ public:
         this->frictionCoefficient[THETA] = angularFrictionK;
     }
 
+    /**
+     * Setter for the limits of profiled movements; they apply to the movements scheduled afterwards
+     * @param linearAcc     maximum planar acceleration in m/s^2
+     * @param angularAcc    maximum angular acceleration in rad/s^2
+     * @param linearJerk    maximum planar jerk in m/s^3, used by S-curve movements only
+     * @param angularJerk   maximum angular jerk in rad/s^3, used by S-curve movements only
+     * @return true if all the limits are positive and were set, false otherwise
+     */
+    bool setProfileLimits(double linearAcc, double angularAcc, double linearJerk, double angularJerk) {
+        if(linearAcc <= 0.0 || angularAcc <= 0.0 || linearJerk <= 0.0 || angularJerk <= 0.0) {
+            return false;
+        }
+        this->profileLimits[0] = linearAcc;
+        this->profileLimits[1] = angularAcc;
+        this->profileLimits[2] = linearJerk;
+        this->profileLimits[3] = angularJerk;
+        return true;
+    }
+
+    /**
+     * Setter for the corner tolerance: when the robot gets within this distance of the target of a movement that is
+     * followed by another one with a target position (i.e. a waypoint of a polyline), the next movement starts
+     * immediately, so the robot carries speed through the corner instead of stopping on it; profiled movements start
+     * their profile from the current speed
+     * @param tolerance     planar distance in meters, 0.0 (default) for disabling blending
+     * @return true if tolerance was set, false if it is negative
+     */
+    bool setCornerTolerance(double tolerance) {
+        if(tolerance < 0.0) {
+            return false;
+        }
+        this->cornerTolerance = tolerance;
+        return true;
+    }
+
     /**
      * Schedules a Still movement; this method is called every time a new FiniteMovement is scheduled, so there is no
      * need to manually call it in order to schedule a stop, unless if last scheduled movement was an indefinite one
@@ -757,9 +1368,10 @@ public:
      * @param forward   requested forward speed's magnitude
      * @param strafe    requested strafe speed's magnitude
      * @param angular   requested angular speed's magnitude
+     * @return boolean indicating whether the movement was scheduled or not (i.e. because the pool is full)
      */
-    void addConstantSpeedMovement(double forward, double strafe, double angular) {
-        this->setIndefiniteMovement(new SpeedIndefinite(forward, strafe, angular));
+    bool addConstantSpeedMovement(double forward, double strafe, double angular) {
+        return this->setIndefiniteMovement(this->createMovement<SpeedIndefinite>(forward, strafe, angular));
     }
 
     /**
@@ -767,22 +1379,23 @@ public:
      * @param speedNorm     requested norm of planar speed vector (it must be in range [0.0, 1.0])
      * @param theta         requested angle defining the direction of the speed vector
      * @param angularNorm   requested norm of angular speed vector (it must be in range [-1.0, 1.0])
-     * @return boolean indicating whether the movement was scheduled or not (i.e. because schedule is full)
+     * @return boolean indicating whether the movement was scheduled or not (i.e. because the pool is full)
      */
     bool addConstantNormSpeedMovement(double speedNorm, double theta, double angularNorm) {
-        this->setIndefiniteMovement(new NormSpeedIndefinite(speedNorm, theta, angularNorm));
+        return this->setIndefiniteMovement(this->createMovement<NormSpeedIndefinite>(speedNorm, theta, angularNorm));
     }
 
     /**
      * Schedule a finite movement that ends when position is reached or time limit is reached, whatever comes first
-     * @param x         target x position
-     * @param y         target y position
-     * @param phi       target phi position
-     * @param duration  duration of the movement
+     * @param x             target x position
+     * @param y             target y position
+     * @param phi           target phi position
+     * @param duration      duration of the movement
+     * @param replaceTail   if true, the movement replaces the last scheduled one instead of being appended
      * @return boolean indicating whether the movement was scheduled or not (i.e. because schedule is full)
      */
-    bool addTargetPosTime(double x, double y, double phi, double duration) {
-        return this->appendFiniteMovement(new SpaceTimeLinear(x, y, phi, duration));
+    bool addTargetPosTime(double x, double y, double phi, double duration, bool replaceTail = false) {
+        return this->appendFiniteMovement<SpaceTimeLinear>(replaceTail, x, y, phi, duration);
     }
 
     /**
@@ -792,10 +1405,38 @@ public:
      * @param phi           target phi position
      * @param speedMag      requested positive magnitude of planar speed vector
      * @param angularMag    requested positive magnitude of angular speed vector
+     * @param replaceTail   if true, the movement replaces the last scheduled one instead of being appended
      * @return boolean indicating whether the movement was scheduled or not (i.e. because schedule is full)
      */
-    bool addTargetPosSpeed(double x, double y, double phi, double speedMag, double angularMag) {
-        return this->appendFiniteMovement(new SpaceSpeedLinear(x, y, phi, speedMag, angularMag));
+    bool addTargetPosSpeed(double x, double y, double phi, double speedMag, double angularMag,
+                           bool replaceTail = false) {
+        return this->appendFiniteMovement<SpaceSpeedLinear>(replaceTail, x, y, phi, speedMag, angularMag);
+    }
+
+    /**
+     * Schedule a route of finite movements like addTargetPosSpeed(), one for each of the given packed waypoints, all
+     * with the same speeds; waypoints are appended in order until the schedule is full
+     * @param waypoints     packed waypoints, WAYPOINT_SIZE bytes each: x and y in millimeters, phi in centiradians
+     * @param count         number of waypoints
+     * @param speedMag      requested positive magnitude of planar speed vector
+     * @param angularMag    requested positive magnitude of angular speed vector
+     * @return number of waypoints scheduled, counting from the first one; 0 if speeds are not valid
+     */
+    uint8_t addTargetPosSpeedBatch(const uint8_t *waypoints, uint8_t count, double speedMag, double angularMag) {
+        if(!(speedMag > 0.0 && angularMag > 0.0 && isfinite(speedMag) && isfinite(angularMag))) {
+            return 0;
+        }
+        uint8_t accepted = 0;
+        for(; accepted < count; accepted++) {
+            const uint8_t *waypoint = &waypoints[accepted * WAYPOINT_SIZE];
+            if(!this->addTargetPosSpeed(Movements::decodeInt16(&waypoint[0]) * WAYPOINT_LINEAR_UNIT,
+                                        Movements::decodeInt16(&waypoint[2]) * WAYPOINT_LINEAR_UNIT,
+                                        Movements::decodeInt16(&waypoint[4]) * WAYPOINT_ANGULAR_UNIT,
+                                        speedMag, angularMag)) {
+                break;
+            }
+        }
+        return accepted;
     }
 
     /**
@@ -805,25 +1446,82 @@ public:
      * @param phi           target phi position
      * @param speedNorm     requested norm of planar speed vector (it must be in range [0.0, 1.0])
      * @param angularNorm   requested norm of angular speed vector (it must be in range [0.0, 1.0])
+     * @param replaceTail   if true, the movement replaces the last scheduled one instead of being appended
      * @return boolean indicating whether the movement was scheduled or not (i.e. because schedule is full)
      */
-    bool addTargetPosNormSpeed(double x, double y, double phi, double speedNorm, double angularNorm) {
+    bool addTargetPosNormSpeed(double x, double y, double phi, double speedNorm, double angularNorm,
+                               bool replaceTail = false) {
         if(speedNorm < 0.0 || speedNorm > 1.0 || angularNorm < 0.0 || angularNorm > 1.0) {
             return false;
         }
-        return this->appendFiniteMovement(new SpaceNormSpeedLinear(x, y, phi, speedNorm, angularNorm));
+        return this->appendFiniteMovement<SpaceNormSpeedLinear>(replaceTail, x, y, phi, speedNorm, angularNorm);
+    }
+
+    /**
+     * Schedule a finite movement that reaches the target position along a straight line, with a trapezoidal speed
+     * profile limited by the given speeds and by the acceleration limits set with setProfileLimits()
+     * @param x             target x position
+     * @param y             target y position
+     * @param phi           target phi position
+     * @param speedMag      requested positive maximum magnitude of planar speed vector
+     * @param angularMag    requested positive maximum magnitude of angular speed vector
+     * @param replaceTail   if true, the movement replaces the last scheduled one instead of being appended
+     * @return boolean indicating whether the movement was scheduled or not (i.e. because schedule is full, or
+     * because profiled movements are compiled out by OMNI3_PROFILED_MOVEMENTS)
+     */
+#if OMNI3_PROFILED_MOVEMENTS
+    bool addTargetPosTrapezoid(double x, double y, double phi, double speedMag, double angularMag,
+                               bool replaceTail = false) {
+        if(speedMag <= 0.0 || angularMag <= 0.0) {
+            return false;
+        }
+        return this->appendFiniteMovement<SpaceSpeedTrapezoid>(replaceTail, x, y, phi, speedMag, angularMag,
+                profileLimits[0], profileLimits[1]);
+    }
+#else
+    bool addTargetPosTrapezoid(double, double, double, double, double, bool = false) {
+        return false;
+    }
+#endif
+
+    /**
+     * Schedule a finite movement that reaches the target position along a straight line, with an S-curve speed
+     * profile limited by the given speeds and by the acceleration and jerk limits set with setProfileLimits()
+     * @param x             target x position
+     * @param y             target y position
+     * @param phi           target phi position
+     * @param speedMag      requested positive maximum magnitude of planar speed vector
+     * @param angularMag    requested positive maximum magnitude of angular speed vector
+     * @param replaceTail   if true, the movement replaces the last scheduled one instead of being appended
+     * @return boolean indicating whether the movement was scheduled or not (i.e. because schedule is full, or
+     * because profiled movements are compiled out by OMNI3_PROFILED_MOVEMENTS)
+     */
+#if OMNI3_PROFILED_MOVEMENTS
+    bool addTargetPosSCurve(double x, double y, double phi, double speedMag, double angularMag,
+                            bool replaceTail = false) {
+        if(speedMag <= 0.0 || angularMag <= 0.0) {
+            return false;
+        }
+        return this->appendFiniteMovement<SpaceSpeedSCurve>(replaceTail, x, y, phi, speedMag, angularMag,
+                profileLimits[0], profileLimits[1], profileLimits[2], profileLimits[3]);
+    }
+#else
+    bool addTargetPosSCurve(double, double, double, double, double, bool = false) {
+        return false;
     }
+#endif
 
     /**
      * Schedule a finite movement that ends when time limit is reached
-     * @param forward   requested forward speed's magnitude
-     * @param strafe    requested strafe speed's magnitude
-     * @param angular   requested angular speed's magnitude
-     * @param duration  duration of the movement
+     * @param forward       requested forward speed's magnitude
+     * @param strafe        requested strafe speed's magnitude
+     * @param angular       requested angular speed's magnitude
+     * @param duration      duration of the movement
+     * @param replaceTail   if true, the movement replaces the last scheduled one instead of being appended
      * @return boolean indicating whether the movement was scheduled or not (i.e. because schedule is full)
      */
-    bool addTargetSpeedTime(double forward, double strafe, double angular, double duration) {
-        return this->appendFiniteMovement(new SpeedTimeLinear(forward, strafe, angular, duration));
+    bool addTargetSpeedTime(double forward, double strafe, double angular, double duration, bool replaceTail = false) {
+        return this->appendFiniteMovement<SpeedTimeLinear>(replaceTail, forward, strafe, angular, duration);
     }
 
     /**
@@ -832,10 +1530,12 @@ public:
      * @param theta         requested angle defining the direction of the speed vector
      * @param angularNorm   requested norm of angular speed vector (it must be in range [-1.0, 1.0])
      * @param duration      duration of the movement
+     * @param replaceTail   if true, the movement replaces the last scheduled one instead of being appended
      * @return boolean indicating whether the movement was scheduled or not (i.e. because schedule is full)
      */
-    bool addTargetNormSpeedTime(double speedNorm, double theta, double angularNorm, double duration) {
-        return this->appendFiniteMovement(new NormSpeedTimeLinear(speedNorm, theta, angularNorm, duration));
+    bool addTargetNormSpeedTime(double speedNorm, double theta, double angularNorm, double duration,
+                                bool replaceTail = false) {
+        return this->appendFiniteMovement<NormSpeedTimeLinear>(replaceTail, speedNorm, theta, angularNorm, duration);
     }
 
     /**
@@ -848,7 +1548,7 @@ public:
      */
     bool handle(const double *currentPosition, const double *currentSpeed, unsigned long time, double *targetSpeed) {
         /* If there are no scheduled movements, perform the default indefinite movement */
-        if (freeIndex <= 0) {
+        if (this->movementsSchedule.isEmpty()) {
             return this->defaultMovement->getSpeed(time, targetSpeed);
         }
 
@@ -858,26 +1558,107 @@ public:
         brakingSpace[STRAFE] = pow2(currentSpeed[STRAFE]) * frictionCoefficient[STRAFE];
         brakingSpace[THETA] = pow2(currentSpeed[THETA]) * frictionCoefficient[THETA];
 
-        /* While current movement is finished, shift schedule of one position */
-        while(this->movementsSchedule[0]->isFinished(currentPosition, brakingSpace, time)) {
-            delete movementsSchedule[0];
-            for(int i=0; i<freeIndex-1; i++) {
-                movementsSchedule[i] = movementsSchedule[i+1];
-            }
-            freeIndex--;
-            movementsSchedule[freeIndex] = nullptr;
+        /* If the robot is close enough to the corner, blend current movement into the next one */
+        if (this->isCornerReached(currentPosition)) {
+            this->destroyMovement(this->movementsSchedule.front());
+            this->movementsSchedule.pop();
+            this->movementsSchedule.front()->setEntrySpeed(currentSpeed);
+        }
+
+        /* While current movement is finished, remove it from the schedule */
+        while(!this->movementsSchedule.isEmpty() &&
+              this->movementsSchedule.front()->isFinished(currentPosition, brakingSpace, time)) {
+            this->destroyMovement(this->movementsSchedule.front());
+            this->movementsSchedule.pop();
         }
 
         /* If there are no scheduled movements, perform the default indefinite movement,
            otherwise perform current finite movement */
-        return freeIndex <= 0 ? this->defaultMovement->getSpeed(time, targetSpeed) :
-                this->movementsSchedule[0]->getSpeed(time, targetSpeed);
+        return this->movementsSchedule.isEmpty() ? this->defaultMovement->getSpeed(time, targetSpeed) :
+                this->movementsSchedule.front()->getSpeed(time, targetSpeed);
+    }
+
+    /**
+     * This method removes all the scheduled movements and sets Still as default movement, so that the robot stops
+     */
+    void clear() {
+        while(!this->movementsSchedule.isEmpty()) {
+            this->destroyMovement(this->movementsSchedule.front());
+            this->movementsSchedule.pop();
+        }
+        this->addStop();
+    }
+
+    /**
+     * This method removes the last scheduled finite movement
+     * @return true if a movement was removed, false if the schedule is empty
+     */
+    bool removeTail() {
+        if(this->movementsSchedule.isEmpty()) {
+            return false;
+        }
+        this->destroyMovement(this->movementsSchedule.back());
+        return this->movementsSchedule.popBack();
+    }
+
+    /**
+     * This method returns the type of a scheduled movement
+     * @param index     position of the movement in the schedule: 0 is the current one, 1 the next one and so on; the
+     *                  position after the last finite movement is the default indefinite movement
+     * @param type      pointer where the type of the movement is stored, if it exists
+     * @return true if a movement exists at the given position, false otherwise
+     */
+    bool peek(uint8_t index, MovementType *type) const {
+        if(index < this->movementsSchedule.size()) {
+            *type = this->movementsSchedule[index]->getType();
+            return true;
+        }
+        if(index == this->movementsSchedule.size()) {
+            *type = this->defaultMovement->getType();
+            return true;
+        }
+        return false;
+    }
+
+    /**
+     * This method returns the type of the movement that will be performed after the current one
+     * @param type      pointer where the type of the movement is stored, if it exists
+     * @return true if there is a next movement, false if the current movement is the default indefinite one
+     */
+    bool peekNext(MovementType *type) const {
+        return this->peek(1, type);
+    }
+
+    /**
+     * Getter for the number of scheduled finite movements
+     * @return number of finite movements in the schedule, including the current one
+     */
+    uint8_t getScheduledMovements() const {
+        return this->movementsSchedule.size();
+    }
+
+    /**
+     * Getter for the number of free slots of the schedule, so that the schedule can be kept filled without exceeding
+     * its capacity
+     * @return number of finite movements that can still be scheduled
+     */
+    uint8_t getFreeSlots() const {
+        return this->movementsSchedule.freeSlots();
+    }
+
+    /**
+     * Getter for the RAM taken by the movements pool, which is most of the one taken by Movements
+     * @return size in bytes of the pool
+     */
+    static constexpr size_t getPoolBytes() {
+        return sizeof(Movements::movementsPool);
     }
 
     /**
      * Undefine max number of movements so that this define is kept private
      */
     #undef MAX_MOVEMENTS
+    #undef MOVEMENTS_POOL_SIZE
 };
 
 #undef pow2
@@ -5,15 +5,58 @@
 #include <EEPROM.h>
 
 #include "wheel.h"
+#include "kinematics.h"
 #include "movements.h"
+#include "lock_free.h"
+#include "control_timer.h"
+#include "control_task.h"
+#include "watchdog.h"
+#include "profiler.h"
+#include "deadline_monitor.h"
+#include "calibration.h"
+#include "param_store.h"
+#include "scheduler.h"
+#include "telemetry.h"
+#include "flight_recorder.h"
+#include "crc.h"
+#include "footprint.h"
+#include "quadrature_encoder.h"
 #include "motor_drivers/MDD3A.h"
 #include "motor_drivers/MR001004.h"
+#include "motor_drivers/BusMotor.h"
 
 /**
  * Maximum number of arguments a function called through handleMessage can have
  */
 #define MAX_ARGS 7
 
+/**
+ * Maximum payload length of a report frame
+ */
+#define REPORT_MAX_PAYLOAD 60
+
+/**
+ * Tester writing a telemetry frame; its message is also the one of the frames streamed by beginTelemetry()
+ */
+#define TELEMETRY_TESTER 5
+
+/**
+ * Function dumping the flight recorder; its message is also the one of the dump frames
+ */
+#define FLIGHT_RECORDER_FUNCTION 4
+
+static_assert(PROFILER_STAGES*PROFILER_STAGE_SIZE <= REPORT_MAX_PAYLOAD, "Profiler report doesn't fit a report frame");
+static_assert(TELEMETRY_PAYLOAD_SIZE <= REPORT_MAX_PAYLOAD, "Telemetry doesn't fit a report frame");
+static_assert(FLIGHT_DUMP_HEADER_SIZE + FLIGHT_RECORD_SIZE <= REPORT_MAX_PAYLOAD, "Flight record doesn't fit a frame");
+static_assert(DEADLINE_REPORT_SIZE <= REPORT_MAX_PAYLOAD, "Deadline counters don't fit a report frame");
+
+/**
+ * Capacity of the queue of commands posted to the control task by postMessage() and postWaypoints(), on dual-core MCUs
+ */
+#ifndef OMNI3_COMMAND_QUEUE_SIZE
+#define OMNI3_COMMAND_QUEUE_SIZE 8
+#endif
+
 /**
  * Omni3 is a 3-wheel drive robot and the number of wheels is of course 3
  */
@@ -38,58 +81,64 @@
 #define W_LEFT 2
 
 /**
- * Tangent of 30 degrees, or PI/6
- */
-#define TAN30 0.57735027
-
-/**
- * Cosine of 30 degrees, or PI/6
- */
-#define COS30 0.86602540
-
-/**
- * Cosine of 30 degrees, or PI/6
+ * Scale of the odometry position accumulators, i.e. units per meter: x and y are integrated as Q32.32 fixed-point
+ * numbers, whose resolution doesn't degrade with the distance from home as floating-point would
  */
-#define SIN30 0.5
+#define ODOMETRY_SCALE 4294967296.0
 
 /**
- * Cosine of 180 degrees, or PI
+ * Policy applied when a requested speed vector would drive some wheel beyond its maximum speed
+ * NONE                 the request is not feasible: the robot is emergency stopped
+ * UNIFORM              the whole (forward, strafe, theta) vector is scaled down, so the robot keeps the requested
+ *                      direction and curvature at the maximum feasible speed
+ * ROTATION_PRIORITY    theta is kept (and scaled down only if it is not feasible by itself), while translation is
+ *                      scaled down to the speed margin left by rotation on each wheel
  */
-#define COS180 -1.0
+enum class Desaturation : uint8_t {NONE=0, UNIFORM=1, ROTATION_PRIORITY=2};
 
+#ifdef OMNI3_MULTI_CORE
 /**
- * Struct containing all information necessary for instancing a Omni3 object
+ * Snapshot of the robot state published by the control task at every period, see BasicOmni3::getSnapshot()
  */
-typedef struct omni3_params_s {
+struct omni3_snapshot_s {
     /**
-     * Wheels' maximum angular speed in radians per second
+     * Time of the snapshot in milliseconds
      */
-    double maxWheelSpeed;
+    unsigned long time;
 
     /**
-     * Wheels' radius in meters
+     * Position of the robot: position[POS_X]: meters, position[POS_Y]: meters, position[POS_PHI]: radians
      */
-    double wheelsRadius;
+    double position[DOF];
 
     /**
-     * Robot's radius (i.e. the distance between the center of the robot and a wheel) in meters
+     * Speed of the robot: speed[FORWARD]: m/s, speed[STRAFE]: m/s, speed[THETA]: rad/s
      */
-    double robotRadius;
+    double speed[DOF];
 
     /**
-     * PID constants
+     * Number of free slots of the movements schedule
      */
-    double kP, kI, kD;
+    uint8_t freeMovementSlots;
+};
+#endif
 
+/**
+ * Class template for defining and controlling 3-wheel omnidirectional robots; the wheel type is resolved at compile
+ * time, so that a robot whose wheels all use the same driver and encoder types can be statically allocated and have its
+ * control path inlined: Omni3 is the instantiation with runtime-polymorphic wheels
+ * @tparam WheelT   type of the wheels, an instantiation of BasicWheel
+ */
+template<class WheelT>
+class BasicOmni3 {
+public:
     /**
-     * Friction constants
+     * Kinematics of the robot, generated at compile time from the mounting angles of its wheels
      */
-     double fwdFrictionK, strFrictionK, angFrictionK;
+    typedef BasicKinematics<Omni3Geometry> Kinematics;
 
-} omni3_params_t;
+    static_assert(Kinematics::WHEELS == WHEELS_NUM, "Geometry doesn't match the number of wheels");
 
-class Omni3 {
-public:
     /**
      * Omni3 constructor, receiving as argument 3 Wheels objects and a parameters structure
      * @param rightWheel    pointer to the Wheel object, that handles the wheel at 2 o'clock
@@ -97,8 +146,10 @@ public:
      * @param leftWheel     pointer to the Wheel object, that handles the wheel at 10 o'clock
      * @param parameters    omni3_params_t with the desired information
      */
-    Omni3(Wheel* rightWheel, Wheel* backWheel, Wheel* leftWheel, omni3_params_t parameters) :
-    movementsHandler(Movements(parameters.fwdFrictionK, parameters.strFrictionK, parameters.angFrictionK)){
+    BasicOmni3(WheelT* rightWheel, WheelT* backWheel, WheelT* leftWheel, omni3_params_t parameters) :
+    movementsHandler(parameters.fwdFrictionK, parameters.strFrictionK, parameters.angFrictionK){
+        this->parameters = parameters;
+
         /* Set array of Wheel pointers */
         wheels[W_RIGHT] = rightWheel;
         wheels[W_BACK] = backWheel;
@@ -112,7 +163,9 @@ public:
         for (auto & wheel : wheels) {
             wheel->setMaxSpeed(parameters.maxWheelSpeed);
             wheel->setPID(parameters.kP, parameters.kI, parameters.kD);
+            wheel->setFeedForward(parameters.kS, parameters.kV, parameters.kA);
         }
+        BasicOmni3::reportFootprint();
     }
 
     /**
@@ -122,8 +175,10 @@ public:
      * @param leftWheel     pointer to the Wheel object, that handles the wheel at 10 o'clock
      * @param memAddr       starting memory address where data is stored
      */
-    Omni3(Wheel* rightWheel, Wheel* backWheel, Wheel* leftWheel, int memAddr) :
-            Omni3(rightWheel, backWheel, leftWheel, Omni3::readStoredData(memAddr)) {}
+    BasicOmni3(WheelT* rightWheel, WheelT* backWheel, WheelT* leftWheel, int memAddr) :
+            BasicOmni3(rightWheel, backWheel, leftWheel, BasicOmni3::readStoredData(memAddr)) {
+        this->memAddr = memAddr;
+    }
 
     /**
      * This method asynchronously handles the movement of the robot: it must be called inside the main Arduino loop
@@ -131,9 +186,9 @@ public:
     void handle();
 
     /**
-     * This static method reads from memory omni3 parameters
+     * This static method reads from memory omni3 parameters stored by commitParameters() or ParamStore::write()
      * @param memAddr   starting memory address where data is stored
-     * @return parameters read
+     * @return parameters read, or ParamStore::defaults() if no valid image of the current version is stored
      */
     static omni3_params_t readStoredData(int memAddr);
 
@@ -144,7 +199,21 @@ public:
     bool home();
 
     /**
-     * This method instantly stops the robot; Arduino reset is needed in order to make the robot work again
+     * Getter for the current position of the robot, computed by odometry since last home()
+     * @param position  array of len DOF where position[POS_X]: meters, position[POS_Y]: meters, position[POS_PHI]:
+     *                  radians are stored
+     */
+    void getPosition(double* position) const;
+
+    /**
+     * Getter for the number of encoder steps each wheel turned since last home(), the exact input of odometry
+     * @param steps     array of len WHEELS_NUM where steps are stored
+     */
+    void getWheelsSteps(long* steps) const;
+
+    /**
+     * This method instantly stops the robot; Arduino reset is needed in order to make the robot work again; the flight
+     * recorder is frozen, so that it keeps the cycles before the stop until it is dumped with function 4
      */
     void emergencyStop();
 
@@ -156,6 +225,17 @@ public:
      */
     bool handleMessage(byte message, double* args);
 
+    /**
+     * This method schedules a route of movements of type 4 (target position and speeds), one for each of the given
+     * packed waypoints (see Movements::addTargetPosSpeedBatch()), in a single pass
+     * @param waypoints     packed waypoints, WAYPOINT_SIZE bytes each: x and y in millimeters, phi in centiradians
+     * @param count         number of waypoints
+     * @param speedMag      requested positive magnitude of planar speed vector, shared by all the waypoints
+     * @param angularMag    requested positive magnitude of angular speed vector, shared by all the waypoints
+     * @return number of waypoints scheduled, counting from the first one
+     */
+    uint8_t handleWaypointsMessage(const uint8_t* waypoints, uint8_t count, double speedMag, double angularMag);
+
     /**
      * This method sets, for each wheel, the maximum speed it can be reached
      * @param speed     max speed of each wheel in rad/s: it's important that this speed can be reached by every wheel
@@ -182,7 +262,490 @@ public:
      */
     void setPIDConstants(double kP, double kI, double kD);
 
+    /**
+     * This method sets, for each wheel, the time constant of the low-pass filter of the PID derivative term
+     * @param timeConstant  time constant in seconds, 0.0 for an unfiltered derivative (see setDerivativeFilter() of
+     *                      BasicWheel)
+     */
+    void setDerivativeFilter(double timeConstant);
+
+    /**
+     * This method sets the friction constants used by movements for estimating the braking space
+     * @param forwardFrictionK  coefficient of friction on forward component of speed vector
+     * @param strafeFrictionK   coefficient of friction on strafe component of speed vector
+     * @param angularFrictionK  coefficient of friction on angular component of speed vector
+     */
+    void setFrictionConstants(double forwardFrictionK, double strafeFrictionK, double angularFrictionK);
+
+    /**
+     * This method schedules current parameters to be written to EEPROM; bytes are written by handle(), one per call
+     * and only where they changed, so the control loop isn't stalled
+     * @param memAddr   starting memory address where data is stored; it is remembered for function 3
+     * @return true if the commit was scheduled, false if the address is not valid
+     */
+    bool commitParameters(int memAddr);
+
+    /**
+     * This method sets the limits of profiled movements (movement types 8 and 9), applied to the movements scheduled
+     * afterwards
+     * @param linearAcc     maximum planar acceleration in m/s^2 (default D_LINEAR_ACCELERATION)
+     * @param angularAcc    maximum angular acceleration in rad/s^2 (default D_ANGULAR_ACCELERATION)
+     * @param linearJerk    maximum planar jerk in m/s^3, for S-curves (default D_LINEAR_JERK)
+     * @param angularJerk   maximum angular jerk in rad/s^3, for S-curves (default D_ANGULAR_JERK)
+     * @return true if all the limits are positive and were set, false otherwise
+     */
+    bool setProfileLimits(double linearAcc, double angularAcc, double linearJerk, double angularJerk);
+
+    /**
+     * This method sets the distance from a waypoint within which a movement with a target position is blended into the
+     * next one, so that the robot doesn't stop on the waypoint (see Movements::setCornerTolerance())
+     * @param tolerance     planar distance in meters, 0.0 (default) for disabling blending
+     * @return true if tolerance was set, false if it is negative
+     */
+    bool setCornerTolerance(double tolerance);
+
+    /**
+     * This method sets the policy applied when a requested speed vector is not feasible; default is UNIFORM
+     * @param mode      desaturation policy
+     */
+    void setDesaturation(Desaturation mode);
+
+    /**
+     * This method sets, for each wheel, feed-forward motor model constants to the given parameters
+     * @param kS        static friction offset in PWM units
+     * @param kV        velocity gain in PWM units per rad/s
+     * @param kA        acceleration gain in PWM units per rad/s^2
+     */
+    void setFeedForward(double kS, double kV, double kA);
+
+    /**
+     * This method starts the calibration of wheels' maximum speed and PID constants (see BasicCalibration): it runs
+     * step by step inside handle(), which doesn't perform movements meanwhile; scheduled movements are cleared and
+     * the robot spins in place, so position must be reset with home() afterwards; when calibration is done, results
+     * are applied and, if parameters were read from EEPROM, they are committed back there
+     * @return true if calibration started, false if it is already running or fixed-rate mode is active
+     */
+    bool beginCalibration();
+
+    /**
+     * Getter for the state of the calibration started by beginCalibration()
+     * @return state of the calibration
+     */
+    CalibrationState getCalibrationState() const;
+
+    /**
+     * This method sets the period of a task of handle(); by default every task runs at each call, while e.g. the
+     * planner can run at 50-100 Hz and leave more time to the wheels' PID and to communications; in fixed-rate mode
+     * the wheels' PID runs in the control interrupt, and the wheels task only collects its steps
+     * @param task      task of handle()
+     * @param period    period in microseconds, 0 for running at each call of handle()
+     */
+    void setTaskPeriod(SchedulerTask task, unsigned long period);
+
+    /**
+     * This method sets, for each wheel, the alpha-beta tracker estimating its speed (see Wheel::setSpeedEstimator())
+     * @param alpha     position gain of the tracker in range (0, 1), 0.0 (default) for differentiating the encoders
+     */
+    void setSpeedEstimator(double alpha);
+
+    /**
+     * Getter for the number of movements that can still be scheduled
+     * @return number of free slots of the movements schedule
+     */
+    uint8_t getFreeMovementSlots() const;
+
+    /**
+     * This method starts the fixed-rate mode: wheels' encoders reading and PID are performed by a timer interrupt at
+     * the given frequency, while handle() keeps running odometry, movements and kinematics from the main loop; since
+     * elapsed time is constant, PID avoids divisions and its gains don't depend on how often handle() is called
+     * @param frequency     control loop frequency in Hz (e.g. 1000)
+     * @return true if the timer was started, false if the frequency is not feasible, there is no timer available on
+     *                      this MCU, OMNI3_TIMER_ISR is not defined or another Omni3 object is already using it
+     */
+    bool beginFixedRate(unsigned int frequency);
+
+    /**
+     * This method stops the fixed-rate mode: wheels are handled again by handle()
+     */
+    void endFixedRate();
+
+    /**
+     * This method starts the dual-core mode, on MCUs with a second core (see ControlTask): handle() and the commands
+     * posted by postMessage() and postWaypoints() are executed by a task running on a core of its own at the given
+     * frequency, which publishes the robot state for getSnapshot() after each run; Arduino loop() is left to the
+     * communication, e.g. to a RemoteSerialProtocol, and must not call handle() nor handleMessage() anymore; report
+     * frames are written by the control task, each one with a single write()
+     * @param frequency     control loop frequency in Hz (e.g. 2000)
+     * @return true if the task was started, false if this MCU has a single core, fixed-rate mode is running or another
+     *                      Omni3 object is already using the control task
+     */
+    bool beginDualCore(unsigned int frequency);
+
+    /**
+     * This method stops the dual-core mode, after the control task completes its current run; handle() must be called
+     * by the main loop again
+     */
+    void endDualCore();
+
+#ifdef OMNI3_MULTI_CORE
+    /**
+     * This method posts a message to the control task, which handles it with handleMessage() before its next run; it
+     * must be called by a single context, usually the main loop on the other core
+     * @param message   message byte, as in handleMessage()
+     * @param args      array of as many arguments as the 3 LSB of message
+     * @return true if the message was queued, false if the queue is full
+     */
+    bool postMessage(byte message, const double* args);
+
+    /**
+     * This method posts a batch of waypoints to the control task, which schedules them with handleWaypointsMessage()
+     * before its next run; it must be called by the same context of postMessage()
+     * @param waypoints     packed waypoints, as in handleWaypointsMessage()
+     * @param count         number of waypoints
+     * @param speedMag      planar speed magnitude in m/s
+     * @param angularMag    angular speed magnitude in rad/s
+     * @return number of queued waypoints: at most the free slots of the last snapshot, 0 if the queue is full or the
+     *                      previous batch is still waiting for the control task
+     */
+    uint8_t postWaypoints(const uint8_t* waypoints, uint8_t count, double speedMag, double angularMag);
+
+    /**
+     * This method copies the last state published by the control task; it can be called from any single context
+     * @param snapshot  pointer where the snapshot is stored
+     */
+    void getSnapshot(omni3_snapshot_s* snapshot) const;
+#endif
+
+    /**
+     * This method sets the stream report frames of testers are written to
+     * @param stream    stream for reports (e.g. &Serial), nullptr for disabling testers that write reports
+     */
+    void setReportStream(Print *stream);
+
+    /**
+     * This method sets the bus shared by the wheels' smart controllers (see BusMotor and BusEncoder): the commands
+     * staged by the wheels are sent with a single MotorBus::flush() right after the wheels' PID (in the control
+     * interrupt in fixed-rate mode), after each calibration step, and on emergency stop; wheels' testers called from
+     * outside handle() must be followed by a flush()
+     * @param bus       bus of the wheels' controllers, nullptr if wheels drive their motors directly
+     */
+    void setMotorBus(MotorBus *bus);
+
+    /**
+     * This method starts streaming telemetry frames to the report stream: at the end of handle(), at the given period,
+     * position and speed of the robot and state of each wheel are encoded into a report frame with the message of
+     * tester TELEMETRY_TESTER (see TelemetryStream for the payload); frames are written only when the transmit buffer
+     * has room for a whole one, older unsent frames are replaced by newer ones
+     * @param period    period in microseconds, 0 for a frame at each call of handle()
+     * @return true if streaming started, false if no report stream is set or if telemetry is compiled out by
+     * OMNI3_TELEMETRY
+     */
+    bool beginTelemetry(unsigned long period);
+
+    /**
+     * This method stops streaming telemetry frames
+     */
+    void endTelemetry();
+
+    /**
+     * Getter for the profiler of handle() stages; it collects data only if OMNI3_PROFILER is defined
+     * @return reference to the profiler
+     */
+    Profiler& getProfiler();
+
+    /**
+     * Getter for the monitor of handle() deadline, which also configures degraded mode (see DeadlineMonitor)
+     * @return reference to the deadline monitor
+     */
+    DeadlineMonitor& getDeadlineMonitor();
+
+    /**
+     * This method starts the hardware watchdog (see ControlWatchdog), fed by each call of handle(): if handle() is not
+     * called within the timeout, the watchdog interrupt stops the motors as emergencyStop() does, also in fixed-rate
+     * mode, and counts the stall; if handle() is not called within another timeout, the board is reset; a stop that
+     * can't be sent to the motor bus (see setMotorBus()) is counted, and not sent again until the next flush, so smart
+     * controllers should also stop on their own when commands stop arriving
+     * @param timeout   timeout in milliseconds, rounded up to the ones of the watchdog (e.g. 250)
+     * @return true if the watchdog was started, false if this MCU has no supported watchdog, OMNI3_WATCHDOG_ISR is
+     *                  not defined, the timeout is not feasible or another Omni3 object is already using the watchdog
+     */
+    bool beginWatchdog(unsigned long timeout);
+
+    /**
+     * This method stops the hardware watchdog
+     */
+    void endWatchdog();
+
 private:
+    /**
+     * Wheels' target PWM values, handed off from handle() to the control interrupt; sequence is increased by every
+     * planner run, so that the wheels get the targets once per run, as in handle()
+     */
+    struct wheels_targets_s {
+        control_t pwm[WHEELS_NUM];
+        uint8_t sequence;
+    };
+
+    /**
+     * Wheels' cumulative encoder steps and number of control periods, handed off from the control interrupt to handle()
+     */
+    struct wheels_steps_s {
+        long steps[WHEELS_NUM];
+        unsigned long cycles;
+    };
+
+    /**
+     * Object whose controlStep() is called by the control timer interrupt, nullptr if fixed-rate mode is not running
+     */
+    static BasicOmni3* fixedRateInstance;
+
+    /**
+     * Object whose dualCoreStep() is called by the control task, nullptr if dual-core mode is not running
+     */
+    static BasicOmni3* dualCoreInstance;
+
+#ifdef OMNI3_MULTI_CORE
+    /**
+     * Command posted to the control task: a message for handleMessage(), or, if waypointsCount is not 0, the batch
+     * stored in postedWaypoints for handleWaypointsMessage(), with speed and angular magnitudes in args
+     */
+    struct command_s {
+        byte message;
+        uint8_t waypointsCount;
+        double args[MAX_ARGS];
+    };
+
+    /**
+     * Queue of the commands posted to the control task
+     */
+    SpscQueue<command_s, OMNI3_COMMAND_QUEUE_SIZE + 1> commands;
+
+    /**
+     * Batch of waypoints posted by postWaypoints(); there is a single one, since a batch can fill the movements
+     * schedule anyway
+     */
+    uint8_t postedWaypoints[OMNI3_MAX_MOVEMENTS * WAYPOINT_SIZE];
+
+    /**
+     * True from when postWaypoints() fills postedWaypoints until the control task has scheduled them
+     */
+    volatile bool waypointsPending = false;
+
+    /**
+     * State published by the control task
+     */
+    SeqLock<omni3_snapshot_s> snapshotBuffer;
+
+    /**
+     * Function called by the control task
+     */
+    static void dualCoreTask();
+
+    /**
+     * This method performs one period of the control task: it handles the posted commands, runs handle() and
+     * publishes the robot state
+     */
+    void dualCoreStep();
+
+    /**
+     * This method publishes the current robot state for getSnapshot()
+     */
+    void publishSnapshot();
+#endif
+
+    /**
+     * True if wheels are handled by the control timer interrupt
+     */
+    bool fixedRate = false;
+
+    /**
+     * Period of the control timer interrupt in seconds
+     */
+    double fixedPeriod = 0.0;
+
+    /**
+     * Buffer of the targets computed by handle(), read by controlStep()
+     */
+    DoubleBuffer<wheels_targets_s> targetsBuffer;
+
+    /**
+     * Buffer of the steps counted by controlStep(), read by handle()
+     */
+    SeqLock<wheels_steps_s> stepsBuffer;
+
+    /**
+     * Steps counted by controlStep(); it is accessed by the control interrupt only
+     */
+    wheels_steps_s totalSteps {};
+
+    /**
+     * Steps read by last execution of handle()
+     */
+    wheels_steps_s lastSteps {};
+
+    /**
+     * Sequence number of the last targets published by handle()
+     */
+    uint8_t targetsSequence = 0;
+
+    /**
+     * Sequence number of the last targets set to the wheels by controlStep(); it is accessed by the control interrupt
+     * only
+     */
+    uint8_t appliedTargetsSequence = 0;
+
+    /**
+     * True while controlStep() is running; wheels' encoders may re-enable interrupts, so it is used for skipping a
+     * period instead of re-entering when an execution lasts more than the period
+     */
+    volatile bool isControlStepRunning = false;
+
+    /**
+     * Execution time statistics of handle() stages
+     */
+    Profiler profiler;
+
+    /**
+     * Deadline tracking of handle() and state of degraded mode
+     */
+    DeadlineMonitor deadlineMonitor;
+
+    /**
+     * Object whose handle() feeds the watchdog, nullptr if the watchdog is not running
+     */
+    static BasicOmni3* watchdogInstance;
+
+    /**
+     * Function called by the watchdog interrupt when handle() stalls
+     */
+    static void watchdogInterrupt();
+
+    /**
+     * Stream report frames are written to, nullptr if none
+     */
+    Print *reportStream = nullptr;
+
+    /**
+     * Bus shared by the wheels' controllers, nullptr if none
+     */
+    MotorBus *motorBus = nullptr;
+
+    /**
+     * Double buffer of telemetry frames
+     */
+    TelemetryStream telemetry;
+
+    /**
+     * True while telemetry frames are streamed
+     */
+    bool isTelemetryStreaming = false;
+
+    /**
+     * Log of the last control cycles
+     */
+    FlightRecorder flightRecorder;
+
+    /**
+     * Wheels' target PWM values last set by setWheelsSpeed(), recorded by the flight recorder
+     */
+    control_t targetsPWM[WHEELS_NUM] = {control_t(0.0), control_t(0.0), control_t(0.0)};
+
+    /**
+     * This method writes the next frame of a flight recorder dump, if one is in progress and the link has room for it
+     */
+    void handleDump();
+
+    /**
+     * This method encodes a snapshot of the robot state into a telemetry frame and publishes it
+     */
+    void captureTelemetry();
+
+    /**
+     * This method writes a report frame to the report stream, if it fits its transmit buffer
+     * @param message   message of the tester requesting the report
+     * @param payload   report data
+     * @param len       number of bytes of payload, at most REPORT_MAX_PAYLOAD
+     * @return true if the report was written, false otherwise
+     */
+    bool sendReport(byte message, const uint8_t* payload, uint8_t len);
+
+    /**
+     * Function called by the control timer interrupt
+     */
+    static void fixedRateInterrupt();
+
+    /**
+     * This method reports at build time the RAM taken by the robot and by its components, if OMNI3_RAM_REPORT is
+     * defined (see RamReport); it does nothing at runtime
+     */
+    static void reportFootprint();
+
+    /**
+     * This method performs one fixed-rate control period: it reads wheels' targets, runs their PID and publishes the
+     * counted steps; it is called from the control timer interrupt
+     */
+    void controlStep();
+
+    /**
+     * This method is the sample phase of the control loop: it reads all the wheels' encoders back to back inside a
+     * single critical section, so that the following actuate phase and kinematics work on a consistent snapshot;
+     * interrupts are left disabled, so that it can be called from the control interrupt as well
+     * @return timestamp of the snapshot in microseconds
+     */
+    unsigned long sampleWheels();
+
+    /**
+     * This method sets wheels' target speeds, given the translation and rotation components of each of them; speeds
+     * exceeding the maximum one are scaled down according to desaturation, then they are set if all of them are
+     * feasible; in fixed-rate mode targets are handed off to the control interrupt
+     * @param translation   array of translation components of wheels' speeds, in rad/s or normalized
+     * @param rotation      rotation component, the same for every wheel, in rad/s or normalized
+     * @param isNormalized  true if speeds are normalized, i.e. fractions of wheels' maximum speeds
+     * @return true if all the speeds are feasible, false otherwise (no speed is set)
+     */
+    bool setWheelsSpeed(const control_t* translation, control_t rotation, bool isNormalized);
+
+    /**
+     * Calibration of wheels' maximum speed and PID constants
+     */
+    BasicCalibration<WheelT> calibration;
+
+    /**
+     * Current parameters of the robot, kept up to date by setters and written to EEPROM by commitParameters()
+     */
+    omni3_params_t parameters;
+
+    /**
+     * EEPROM address parameters were read from or last committed to, -1 if none
+     */
+    int memAddr = -1;
+
+    /**
+     * Deferred writer of parameters to EEPROM
+     */
+    ParamStore paramStore;
+
+    /**
+     * This method runs the wheels task: it runs the wheels' PID (or reads the steps counted by the control interrupt),
+     * counts their steps for odometry and records the cycle in the flight recorder
+     */
+    void handleWheels();
+
+    /**
+     * This method sends the commands staged by the wheels with a single transaction, if they share a motor bus
+     */
+    void commitMotors();
+
+    /**
+     * This method performs one step of the calibration and, when it is done, applies its results
+     */
+    void handleCalibration();
+
+    /**
+     * Policy applied when a requested speed vector is not feasible
+     */
+    Desaturation desaturation = Desaturation::UNIFORM;
+
     /**
      * Wheels array elements are ordered as follows: looking the robot from the top, place an imaginary clock dial where
      * the positive forward direction of the robot is at 12 o'clock; proceeding clockwise:
@@ -190,7 +753,7 @@ private:
      * - wheels[W_BACK] Wheel will be at 6 o'clock
      * - wheels[W_LEFT] Wheel will be at 10 o'clock
      */
-    Wheel* wheels[WHEELS_NUM]{};
+    WheelT* wheels[WHEELS_NUM]{};
 
     /**
      * Handler of the robot's movements
@@ -208,84 +771,162 @@ private:
      * displacement[ANGULAR]: radians; home() can be called only if displacement is 0; the current speed of the robot
      * can be easily computed by dividing the displacement by the time elapsed
      */
-    double displacement[DOF] = {0.0, 0.0, 0.0};
+    control_t displacement[DOF] = {control_t(0.0), control_t(0.0), control_t(0.0)};
 
     /**
-     * Timestamp in milliseconds of last execution
+     * Current speed of the robot, computed by the last run of odometry: currentSpeed[FORWARD]: m/s,
+     * currentSpeed[STRAFE]: m/s, currentSpeed[THETA]: rad/s
      */
-    unsigned long lastTime = 0;
+    double currentSpeed[DOF] = {0.0, 0.0, 0.0};
 
     /**
-     * Wheels' radius in meters
+     * Encoder steps each wheel turned since last home(), counted by the wheels task; integer counts, so that no
+     * rounding error accumulates however long the wheels task runs between two runs of odometry
      */
-    double R = 1.0;
+    long odometrySteps[WHEELS_NUM] = {0, 0, 0};
 
     /**
-     * Robot's radius (i.e. the distance between the center of the robot and a wheel) in meters
+     * Value of odometrySteps at the last run of odometry
      */
-    double L = 1.0;
+    long integratedSteps[WHEELS_NUM] = {0, 0, 0};
+
+    /**
+     * Time in seconds covered by the steps counted since the last run of odometry
+     */
+    double pendingTime = 0.0;
+
+    /**
+     * Position x and y of the robot in Q32.32 fixed-point meters (see ODOMETRY_SCALE), where odometry integrates the
+     * displacement; currentPosition holds their conversion
+     */
+    int64_t positionAccumulator[2] = {0, 0};
 
     /**
-     * Cosine of 30 degrees divided by wheels' radius
+     * Heading in Q0.64 fixed-point turns (see toTurns()) when the sum of odometrySteps was headingBaseSteps: the
+     * heading is a linear function of the sum of wheels' steps, so it is computed from their absolute count instead of
+     * integrated
      */
-    double C30_R = 1.0;
+    uint64_t headingBase = 0;
 
     /**
-     * Sine of 30 degrees divided by wheels' radius
+     * Sum of odometrySteps when the heading was headingBase
      */
-    double S30_R = 1.0;
+    long headingBaseSteps = 0;
 
     /**
-     * Cosine of 180 degrees divided by wheels' radius
+     * Meters the robot moves for each step of the combinations of wheels' steps given by Kinematics::forward() and
+     * Kinematics::strafe(): R in meters per step
      */
-    double C180_R = 1.0;
+    double displacementPerStep = 0.0;
 
     /**
-     * Tangent of 30 degrees times wheels' radius
+     * Turns of the robot for each step of the sum of wheels' steps, R/(3*L) radians, in Q0.64 fixed point: multiplying
+     * it by a number of steps wraps around at full turns, so the heading is reduced to one turn exactly in integers,
+     * and its resolution doesn't degrade with the accumulated rotation as floating-point would
      */
-    double T30R = 1.0;
+    uint64_t headingPerStep = 0;
 
     /**
-     * Wheels' radius divided by 3
+     * Part of the turns per step below the resolution of headingPerStep, in turns: it is 0 with single precision
+     * doubles, whose R/(3*L) has no bits that low
      */
-    double R_3 = 1.0;
+    double headingPerStepRemainder = 0.0;
+
+    /**
+     * Timestamp in microseconds of the last wheels' sample
+     */
+    unsigned long lastSampleTime = 0;
+
+    /**
+     * Scheduler of handle() tasks
+     */
+    RateScheduler<SCHEDULER_TASKS> scheduler;
+
+    /**
+     * Wheels' radius in meters
+     */
+    double R = 1.0;
+
+    /**
+     * Robot's radius (i.e. the distance between the center of the robot and a wheel) in meters
+     */
+    double L = 1.0;
+
+    /**
+     * Inverse of wheels' radius
+     */
+    control_t ONE_R = control_t(1.0);
+
+    /**
+     * Wheels' radius
+     */
+    control_t R_C = control_t(1.0);
 
     /**
      * Robot's radius divided by wheels' radius
      */
-    double L_R = 1.0;
+    control_t L_R = control_t(1.0);
 
     /**
      * Wheels' radius divided by 3 times robot's radius
      */
-    double R_3L = 1.0;
+    control_t R_3L = control_t(1.0);
 
     /**
      * This method computes the robot displacement, given each wheel's displacement
      * @param angularDisplacement   array of wheels' angular displacements in radians
      */
-    void directKinematics(const double* angularDisplacement);
+    void directKinematics(const control_t* angularDisplacement);
 
     /**
      * This method computes and sets wheels' angular speeds, given the desired robot speed vector
      * @param speed     array of speeds: speed[FORWARD]: m/s, speed[STRAFE]: m/s, speed[THETA]: rad/s
-     * @returns true if the movement is feasible, false otherwise
+     * @returns true if the movement is feasible (after desaturation), false otherwise
      */
-    bool inverseKinematics(const double* speed) const;
+    bool inverseKinematics(const double* speed);
 
     /**
      * This method computes and sets wheels' angular speeds, given the desired robot normalized speed vector;
      * @param speed     array of speeds: speed[FORWARD]: [-1, 1], speed[STRAFE]: [1, 1], speed[THETA]: [-1, 1]
      *                  if mP is the magnitude of forward and strafe components' sum vector, mP must be in range [0, 1];
-     *                  also, mP + abs(theta) must be in range [0, 1]
-     * @returns true if the movement is feasible, false otherwise
+     *                  also, mP + abs(theta) must be in range [0, 1], otherwise the vector is desaturated
+     * @returns true if the movement is feasible (after desaturation), false otherwise
+     */
+    bool normalizedInverseKinematics(const double* speed);
+
+    /**
+     * This method runs direct kinematics and odometry on the steps counted since the last run and updates the current
+     * speed of the robot; it runs only when position is needed, by the planner, the odometry task or telemetry
      */
-    bool normalizedInverseKinematics(const double* speed) const;
+    void updateOdometry();
 
     /**
-     * This method computes and sets robot's current position from the current position and the displacement
+     * This method computes robot's displacement from wheels' steps and integrates it into the current position; the
+     * heading is computed from the absolute count of the steps
+     * @param steps     array of wheels' steps since the last run
      */
-    void odometry();
+    void odometry(const long* steps);
+
+    /**
+     * This method computes the heading corresponding to a number of steps
+     * @param stepsSum  sum of the steps of the wheels since last home()
+     * @return heading in radians, in range [0, 2*PI)
+     */
+    double headingAt(long stepsSum) const;
+
+    /**
+     * This method converts a fraction of a turn to Q0.64 fixed point, where 2^64 is a full turn, without rounding
+     * @param turns     fraction of a turn, in range [0.0, 1.0]
+     * @param remainder where the part of turns below the resolution of the result is stored, if not nullptr
+     * @return fixed-point turns, wrapping around to 0 at a full turn
+     */
+    static uint64_t toTurns(double turns, double *remainder = nullptr);
+
+    /**
+     * This method computes the displacement of the robot for each wheel's step and sets the current heading as the base
+     * of the following ones; it is called when radii change, so that the heading doesn't jump
+     */
+    void updateOdometryConstants();
 
     /**
      * This method handles a movement message received through communication channel (for example Serial)
@@ -297,9 +938,17 @@ private:
     bool handleMovementsMessage(uint8_t movementType, uint8_t argsLen, double* args);
 
     /**
-     * This method handles a tester message received through communication channel (for example Serial)
+     * This method handles a tester message received through communication channel (for example Serial); reports are
+     * written to the report stream, testers 0, 1 and 2 need OMNI3_PROFILER:
+     * - 0: report min, max and mean execution time of each profiled stage (see Profiler::writeStages())
+     * - 1: report loop budget, number of loops and overrun counters (see Profiler::writeOverruns())
+     * - 2: reset profiler statistics
+     * - 3: report deadline, overrun and watchdog counters and degraded mode (see DeadlineMonitor::writeCounters())
+     * - 4: reset deadline counters, leaving degraded mode
+     * - 5: write a telemetry frame (see beginTelemetry())
+     * Testers are compiled out if OMNI3_TESTERS is 0
      * @param testType      number from 0 to 7 indicating the type of test
-     * @return true if message was handled correctly, false otherwise
+     * @return true if message was handled correctly, false otherwise (always if testers are compiled out)
      */
     bool handleTestersMessage(uint8_t testType);
 
@@ -313,7 +962,13 @@ private:
     bool handleSettersMessage(uint8_t setterType, uint8_t argsLen, double* args);
 
     /**
-     * This method handles a function message received through communication channel (for example Serial)
+     * This method handles a function message received through communication channel (for example Serial):
+     * - 0: remove all the scheduled movements and stop the robot (aborting calibration, if running)
+     * - 1: remove the last scheduled movement
+     * - 2: start calibration (see beginCalibration())
+     * - 3: commit parameters to the EEPROM address they were read from (see commitParameters())
+     * - 4: dump the flight recorder to the report stream, one record after the other starting from the oldest one, in
+     *      report frames written by handle() as the link has room for them (see FlightRecorder)
      * @param functionType  number from 0 to 7 indicating the type of function
      * @return true if message was handled correctly, false otherwise
      */
@@ -321,5 +976,14 @@ private:
 
 };
 
+#include "omni3_impl.h"
+
+/**
+ * Robot handled through the MotorDriver interface, for robots mixing different drivers
+ */
+typedef BasicOmni3<Wheel> Omni3;
+
+/* Omni3 is instantiated once, in omni3.cpp */
+extern template class BasicOmni3<Wheel>;
 
 #endif
@@ -0,0 +1,1184 @@
+#ifndef OMNI3_OMNI3_IMPL_H
+#define OMNI3_OMNI3_IMPL_H
+
+/* Definitions of BasicOmni3 methods; this file is included by omni3.h and must not be included directly */
+
+template<class WheelT>
+BasicOmni3<WheelT>* BasicOmni3<WheelT>::fixedRateInstance = nullptr;
+
+template<class WheelT>
+BasicOmni3<WheelT>* BasicOmni3<WheelT>::dualCoreInstance = nullptr;
+
+template<class WheelT>
+BasicOmni3<WheelT>* BasicOmni3<WheelT>::watchdogInstance = nullptr;
+
+/* Public methods */
+template<class WheelT>
+omni3_params_t BasicOmni3<WheelT>::readStoredData(int memAddr) {
+    /* Read and validate the image at given memory address, falling back to defaults if it is not valid */
+    omni3_params_t data = ParamStore::defaults();
+    ParamStore::load(memAddr, &data);
+    return data;
+}
+
+template<class WheelT>
+void BasicOmni3<WheelT>::handle() {
+    /* Read current time */
+    unsigned long time = millis();
+    unsigned long now = micros();
+    unsigned long loopStart = this->profiler.now();
+    unsigned long stageStart = loopStart;
+
+    /* The loop is alive: feed the watchdog and check how long ago the previous call started */
+    if (BasicOmni3::watchdogInstance == this) {
+        ControlWatchdog::feed();
+    }
+    this->deadlineMonitor.check(now);
+
+    /* Calibration drives the wheels by itself, movements are suspended until it ends */
+    this->paramStore.handle();
+    this->telemetry.handle(this->reportStream);
+    this->handleDump();
+    if (this->calibration.isRunning()) {
+        this->handleCalibration();
+        this->lastSampleTime = now;
+        return;
+    }
+
+    /* Run the wheels' PID and accumulate their displacement */
+    if (this->scheduler.isDue((uint8_t)SchedulerTask::WHEELS, now)) {
+        this->handleWheels();
+        this->profiler.record(ProfilerStage::WHEELS, stageStart);
+    }
+
+    /* From the steps counted since the last run, compute current position and speed of the robot; this is needed only
+     * by the planner, or when asked to be kept up to date by the odometry task */
+    bool isPlannerDue = this->scheduler.isDue((uint8_t)SchedulerTask::PLANNER, now);
+    bool isOdometryDue = this->scheduler.isDue((uint8_t)SchedulerTask::ODOMETRY, now);
+    bool isUpdated = (isOdometryDue || isPlannerDue) && this->pendingTime > 0.0;
+    if (isUpdated) {
+        this->updateOdometry();
+    }
+
+    /* With no period, the planner runs on each new odometry update instead of spinning on the same data */
+    if (isPlannerDue && (isUpdated || this->scheduler.getPeriod((uint8_t)SchedulerTask::PLANNER) > 0)) {
+        /* Compute target speed vector, wheels keep it until the next run */
+        double targetSpeed[DOF] = {0.0, 0.0, 0.0};
+        stageStart = this->profiler.now();
+        bool isNormalized = this->movementsHandler.handle(currentPosition, currentSpeed, time, targetSpeed);
+        this->profiler.record(ProfilerStage::MOVEMENTS, stageStart);
+
+        /* Compute inverse kinematics, requesting speeds to the motors: if some is unfeasible, emergency stop */
+        stageStart = this->profiler.now();
+        bool isFeasible = isNormalized ? normalizedInverseKinematics(targetSpeed) : inverseKinematics(targetSpeed);
+        this->profiler.record(ProfilerStage::INVERSE_KINEMATICS, stageStart);
+        if (!isFeasible) {
+            this->emergencyStop();
+        }
+    }
+
+    /* Snapshot the state for telemetry and send it if the link has room */
+    if (this->isTelemetryStreaming && this->scheduler.isDue((uint8_t)SchedulerTask::TELEMETRY, now)) {
+        this->captureTelemetry();
+        this->telemetry.handle(this->reportStream);
+    }
+    this->profiler.record(ProfilerStage::LOOP, loopStart);
+}
+
+template<class WheelT>
+bool BasicOmni3<WheelT>::home() {
+    /* If currentSpeed is not { 0.0, 0.0, 0.0 }, return false */
+    if (this->displacement[FORWARD] != control_t(0.0) ||
+        this->displacement[STRAFE] != control_t(0.0) ||
+        this->displacement[THETA] != control_t(0.0) )
+    {
+        return false;
+    }
+
+    /* Otherwise (the robot is still), set current position to { 0.0, 0.0, 0.0 } and count steps from now */
+    for (double & i : this->currentPosition) {
+        i = 0.0;
+    }
+    for (uint8_t i=0; i<WHEELS_NUM; i++) {
+        this->odometrySteps[i] = 0;
+        this->integratedSteps[i] = 0;
+    }
+    this->positionAccumulator[0] = 0;
+    this->positionAccumulator[1] = 0;
+    this->headingBase = 0;
+    this->headingBaseSteps = 0;
+    return true;
+}
+
+template<class WheelT>
+void BasicOmni3<WheelT>::getPosition(double *position) const {
+    for (uint8_t i=0; i<DOF; i++) {
+        position[i] = this->currentPosition[i];
+    }
+}
+
+template<class WheelT>
+void BasicOmni3<WheelT>::getWheelsSteps(long *steps) const {
+    for (uint8_t i=0; i<WHEELS_NUM; i++) {
+        steps[i] = this->odometrySteps[i];
+    }
+}
+
+template<class WheelT>
+void BasicOmni3<WheelT>::emergencyStop() {
+    /* Keep the record of what led here */
+    this->flightRecorder.freeze();
+
+    /* Set max speed to every wheel to 0; interrupts are disabled, since wheels may be handled by the control timer */
+    noInterrupts();
+    for (auto & wheel : wheels) {
+        wheel->setMaxSpeed(0.0);
+    }
+    this->commitMotors();
+    interrupts();
+    for (auto & target : this->targetsPWM) {
+        target = control_t(0.0);
+    }
+}
+
+template<class WheelT>
+bool BasicOmni3<WheelT>::handleMessage(byte message, double *args) {
+    uint8_t argsLen = message & 0b00000111;
+    byte msgType = message >> 3;
+    /* Movements */
+    if (msgType >= 0b10000) {
+        return handleMovementsMessage(msgType & 0b1111, argsLen, args);
+    }
+    else {
+        /* Testers and setters */
+        if (msgType >= 0b01000) {
+            if(argsLen==0) {
+                return handleTestersMessage(msgType & 0b111);
+            }
+            else {
+                return handleSettersMessage(msgType & 0b111, argsLen, args);
+            }
+        }
+        /* Functions */
+        else {
+            return handleFunctionsMessage(msgType & 0b111);
+        }
+    }
+}
+
+template<class WheelT>
+uint8_t BasicOmni3<WheelT>::handleWaypointsMessage(const uint8_t *waypoints, uint8_t count, double speedMag,
+                                                   double angularMag) {
+    return this->movementsHandler.addTargetPosSpeedBatch(waypoints, count, speedMag, angularMag);
+}
+
+template<class WheelT>
+void BasicOmni3<WheelT>::setMaxWheelSpeed(double speed) {
+    /* For each wheel, set max speed */
+    noInterrupts();
+    for (auto & wheel : wheels) {
+        wheel->setMaxSpeed(speed);
+    }
+    interrupts();
+    this->parameters.maxWheelSpeed = speed;
+}
+
+template<class WheelT>
+void BasicOmni3<WheelT>::setWheelsRadius(double wheelsRadius) {
+    /* Set various constants */
+    this->parameters.wheelsRadius = wheelsRadius;
+    this->R = wheelsRadius;
+    this->ONE_R = control_t(1.0 / wheelsRadius);
+    this->R_C = control_t(wheelsRadius);
+    this->L_R = control_t(this->L / wheelsRadius);
+    this->R_3L = control_t(wheelsRadius / (WHEELS_NUM*this->L));
+    this->updateOdometryConstants();
+}
+
+template<class WheelT>
+void BasicOmni3<WheelT>::setRobotRadius(double robotRadius) {
+    /* Set various constants */
+    this->parameters.robotRadius = robotRadius;
+    this->L = robotRadius;
+    this->L_R = control_t(robotRadius / this->R);
+    this->R_3L = control_t(this->R / (WHEELS_NUM*robotRadius));
+    this->updateOdometryConstants();
+}
+
+template<class WheelT>
+void BasicOmni3<WheelT>::setPIDConstants(double kP, double kI, double kD) {
+    /* For each wheel, set PID constants */
+    noInterrupts();
+    for (auto & wheel : wheels) {
+        wheel->setPID(kP, kI, kD);
+    }
+    interrupts();
+    this->parameters.kP = kP;
+    this->parameters.kI = kI;
+    this->parameters.kD = kD;
+}
+
+template<class WheelT>
+void BasicOmni3<WheelT>::setDerivativeFilter(double timeConstant) {
+    noInterrupts();
+    for (auto & wheel : wheels) {
+        wheel->setDerivativeFilter(timeConstant);
+    }
+    interrupts();
+}
+
+template<class WheelT>
+void BasicOmni3<WheelT>::setFeedForward(double kS, double kV, double kA) {
+    /* For each wheel, set motor model constants */
+    noInterrupts();
+    for (auto & wheel : wheels) {
+        wheel->setFeedForward(kS, kV, kA);
+    }
+    interrupts();
+    this->parameters.kS = kS;
+    this->parameters.kV = kV;
+    this->parameters.kA = kA;
+}
+
+template<class WheelT>
+void BasicOmni3<WheelT>::setFrictionConstants(double forwardFrictionK, double strafeFrictionK, double angularFrictionK) {
+    this->movementsHandler.setFrictionConstants(forwardFrictionK, strafeFrictionK, angularFrictionK);
+    this->parameters.fwdFrictionK = forwardFrictionK;
+    this->parameters.strFrictionK = strafeFrictionK;
+    this->parameters.angFrictionK = angularFrictionK;
+}
+
+template<class WheelT>
+bool BasicOmni3<WheelT>::commitParameters(int memAddr) {
+    if (!this->paramStore.commit(memAddr, this->parameters)) {
+        return false;
+    }
+    this->memAddr = memAddr;
+    return true;
+}
+
+template<class WheelT>
+bool BasicOmni3<WheelT>::setProfileLimits(double linearAcc, double angularAcc, double linearJerk, double angularJerk) {
+    return this->movementsHandler.setProfileLimits(linearAcc, angularAcc, linearJerk, angularJerk);
+}
+
+template<class WheelT>
+bool BasicOmni3<WheelT>::setCornerTolerance(double tolerance) {
+    return this->movementsHandler.setCornerTolerance(tolerance);
+}
+
+template<class WheelT>
+void BasicOmni3<WheelT>::setDesaturation(Desaturation mode) {
+    this->desaturation = mode;
+}
+
+template<class WheelT>
+bool BasicOmni3<WheelT>::beginCalibration() {
+    /* In fixed-rate mode wheels are driven by the control interrupt, which calibration can't bypass */
+    if (this->fixedRate || this->calibration.isRunning()) {
+        return false;
+    }
+    this->movementsHandler.clear();
+    this->calibration.begin(micros());
+    return true;
+}
+
+template<class WheelT>
+CalibrationState BasicOmni3<WheelT>::getCalibrationState() const {
+    return this->calibration.getState();
+}
+
+template<class WheelT>
+void BasicOmni3<WheelT>::setTaskPeriod(SchedulerTask task, unsigned long period) {
+    this->scheduler.setPeriod((uint8_t)task, period);
+}
+
+template<class WheelT>
+void BasicOmni3<WheelT>::setSpeedEstimator(double alpha) {
+    /* For each wheel, set the tracker gains */
+    noInterrupts();
+    for (auto & wheel : wheels) {
+        wheel->setSpeedEstimator(alpha);
+    }
+    interrupts();
+}
+
+template<class WheelT>
+uint8_t BasicOmni3<WheelT>::getFreeMovementSlots() const {
+    return movementsHandler.getFreeSlots();
+}
+
+template<class WheelT>
+bool BasicOmni3<WheelT>::beginFixedRate(unsigned int frequency) {
+    /* Only one object at a time can use the control timer */
+    if (BasicOmni3::fixedRateInstance != nullptr) {
+        return BasicOmni3::fixedRateInstance == this && this->fixedRate;
+    }
+
+    /* Robots of other BasicOmni3 types may be using the control timer as well; in dual-core mode, the control task
+       already runs at a fixed rate */
+    if (ControlTimer::getPeriod() > 0.0 || BasicOmni3::dualCoreInstance == this) {
+        return false;
+    }
+
+    /* Start the timer and configure wheels before the first interrupt can be served */
+    noInterrupts();
+    if (!ControlTimer::begin(frequency, BasicOmni3::fixedRateInterrupt)) {
+        interrupts();
+        return false;
+    }
+    this->fixedPeriod = ControlTimer::getPeriod();
+    for (auto & wheel : wheels) {
+        wheel->setFixedPeriod(this->fixedPeriod);
+    }
+    this->lastSteps = this->totalSteps;
+    this->fixedRate = true;
+    BasicOmni3::fixedRateInstance = this;
+    interrupts();
+    return true;
+}
+
+template<class WheelT>
+void BasicOmni3<WheelT>::setReportStream(Print *stream) {
+    this->reportStream = stream;
+}
+
+template<class WheelT>
+void BasicOmni3<WheelT>::setMotorBus(MotorBus *bus) {
+    this->motorBus = bus;
+}
+
+template<class WheelT>
+bool BasicOmni3<WheelT>::beginTelemetry(unsigned long period) {
+    if (!TelemetryStream::ENABLED || this->reportStream == nullptr) {
+        return false;
+    }
+    this->scheduler.setPeriod((uint8_t)SchedulerTask::TELEMETRY, period);
+    this->isTelemetryStreaming = true;
+    return true;
+}
+
+template<class WheelT>
+void BasicOmni3<WheelT>::endTelemetry() {
+    this->isTelemetryStreaming = false;
+}
+
+template<class WheelT>
+Profiler& BasicOmni3<WheelT>::getProfiler() {
+    return this->profiler;
+}
+
+template<class WheelT>
+DeadlineMonitor& BasicOmni3<WheelT>::getDeadlineMonitor() {
+    return this->deadlineMonitor;
+}
+
+template<class WheelT>
+bool BasicOmni3<WheelT>::beginWatchdog(unsigned long timeout) {
+    /* Only one object at a time can use the watchdog */
+    if (BasicOmni3::watchdogInstance != nullptr) {
+        return BasicOmni3::watchdogInstance == this;
+    }
+    if (ControlWatchdog::getTimeout() > 0) {
+        return false;
+    }
+    BasicOmni3::watchdogInstance = this;
+    if (!ControlWatchdog::begin(timeout, BasicOmni3::watchdogInterrupt)) {
+        BasicOmni3::watchdogInstance = nullptr;
+        return false;
+    }
+    return true;
+}
+
+template<class WheelT>
+void BasicOmni3<WheelT>::endWatchdog() {
+    if (BasicOmni3::watchdogInstance != this) {
+        return;
+    }
+    ControlWatchdog::end();
+    BasicOmni3::watchdogInstance = nullptr;
+}
+
+template<class WheelT>
+void BasicOmni3<WheelT>::endFixedRate() {
+    if (BasicOmni3::fixedRateInstance != this) {
+        return;
+    }
+
+    /* Stop the timer, then wheels are handled by handle() again */
+    noInterrupts();
+    ControlTimer::end();
+    BasicOmni3::fixedRateInstance = nullptr;
+    this->fixedRate = false;
+    for (auto & wheel : wheels) {
+        wheel->setFixedPeriod(0.0);
+    }
+    interrupts();
+    this->lastSampleTime = micros();
+}
+
+#ifdef OMNI3_MULTI_CORE
+template<class WheelT>
+bool BasicOmni3<WheelT>::beginDualCore(unsigned int frequency) {
+    /* Only one object at a time can use the control task */
+    if (BasicOmni3::dualCoreInstance != nullptr) {
+        return BasicOmni3::dualCoreInstance == this;
+    }
+    if (this->fixedRate || ControlTask::getPeriod() > 0.0) {
+        return false;
+    }
+
+    /* Publish the state before the first run, so that the other core can already read the free slots */
+    this->publishSnapshot();
+    this->lastSampleTime = micros();
+    BasicOmni3::dualCoreInstance = this;
+    if (!ControlTask::begin(frequency, BasicOmni3::dualCoreTask)) {
+        BasicOmni3::dualCoreInstance = nullptr;
+        return false;
+    }
+    return true;
+}
+#else
+template<class WheelT>
+bool BasicOmni3<WheelT>::beginDualCore(unsigned int) {
+    /* Single core MCU: there is no core for the control task */
+    return false;
+}
+#endif
+
+template<class WheelT>
+void BasicOmni3<WheelT>::endDualCore() {
+    if (BasicOmni3::dualCoreInstance != this) {
+        return;
+    }
+    ControlTask::end();
+    BasicOmni3::dualCoreInstance = nullptr;
+}
+
+#ifdef OMNI3_MULTI_CORE
+template<class WheelT>
+bool BasicOmni3<WheelT>::postMessage(byte message, const double *args) {
+    command_s command;
+    command.message = message;
+    command.waypointsCount = 0;
+    for (uint8_t i=0; i<(message & 0b00000111); i++) {
+        command.args[i] = args[i];
+    }
+    return this->commands.push(command);
+}
+
+template<class WheelT>
+uint8_t BasicOmni3<WheelT>::postWaypoints(const uint8_t *waypoints, uint8_t count, double speedMag,
+                                          double angularMag) {
+    /* Movements queued and not handled yet are not counted by the snapshot, the control task rejects the excess */
+    omni3_snapshot_s snapshot = this->snapshotBuffer.read();
+    count = min(count, snapshot.freeMovementSlots);
+    if (count == 0 || this->waypointsPending) {
+        return 0;
+    }
+
+    /* The batch is owned by the control task from when the command is pushed until it clears waypointsPending */
+    memcpy(this->postedWaypoints, waypoints, count * WAYPOINT_SIZE);
+    command_s command;
+    command.message = 0;
+    command.waypointsCount = count;
+    command.args[0] = speedMag;
+    command.args[1] = angularMag;
+    this->waypointsPending = true;
+    if (!this->commands.push(command)) {
+        this->waypointsPending = false;
+        return 0;
+    }
+    return count;
+}
+
+template<class WheelT>
+void BasicOmni3<WheelT>::getSnapshot(omni3_snapshot_s *snapshot) const {
+    *snapshot = this->snapshotBuffer.read();
+}
+#endif
+
+/* Private methods */
+#ifdef OMNI3_MULTI_CORE
+template<class WheelT>
+void BasicOmni3<WheelT>::dualCoreTask() {
+    BasicOmni3 *instance = BasicOmni3::dualCoreInstance;
+    if (instance != nullptr) {
+        instance->dualCoreStep();
+    }
+}
+
+template<class WheelT>
+void BasicOmni3<WheelT>::dualCoreStep() {
+    /* Commands are handled by the same context as handle(), so they need no synchronization with it */
+    command_s command;
+    while (this->commands.pop(&command)) {
+        if (command.waypointsCount > 0) {
+            this->handleWaypointsMessage(this->postedWaypoints, command.waypointsCount, command.args[0],
+                                         command.args[1]);
+            OMNI3_MEMORY_BARRIER();
+            this->waypointsPending = false;
+        }
+        else {
+            this->handleMessage(command.message, command.args);
+        }
+    }
+    this->handle();
+    this->publishSnapshot();
+}
+
+template<class WheelT>
+void BasicOmni3<WheelT>::publishSnapshot() {
+    omni3_snapshot_s snapshot;
+    snapshot.time = millis();
+    for (uint8_t i=0; i<DOF; i++) {
+        snapshot.position[i] = this->currentPosition[i];
+        snapshot.speed[i] = this->currentSpeed[i];
+    }
+    snapshot.freeMovementSlots = this->movementsHandler.getFreeSlots();
+    this->snapshotBuffer.write(snapshot);
+}
+#endif
+
+template<class WheelT>
+void BasicOmni3<WheelT>::handleWheels() {
+    long steps[WHEELS_NUM];
+    int pwm[WHEELS_NUM];
+    unsigned long sampleTime;
+    if (this->fixedRate) {
+        /* Collect steps counted by the control interrupt since last call; if no period elapsed, there is nothing new */
+        wheels_steps_s totalSteps = this->stepsBuffer.read();
+        unsigned long cycles = totalSteps.cycles - this->lastSteps.cycles;
+        if (cycles == 0) {
+            return;
+        }
+        sampleTime = micros();
+        for (uint8_t i=0; i<WHEELS_NUM; i++) {
+            steps[i] = totalSteps.steps[i] - this->lastSteps.steps[i];
+        }
+        this->pendingTime += cycles * this->fixedPeriod;
+        this->lastSteps = totalSteps;
+
+        /* Drivers are updated by the control interrupt */
+        noInterrupts();
+        for (uint8_t i=0; i<WHEELS_NUM; i++) {
+            pwm[i] = wheels[i]->getOutputPWM();
+        }
+        interrupts();
+    }
+    else {
+        /* Sample all the encoders at the same instant, then run each wheel's PID on the snapshot */
+        sampleTime = this->sampleWheels();
+        interrupts();
+        for (uint8_t i=0; i<WHEELS_NUM; i++) {
+            wheels[i]->actuate(sampleTime);
+            steps[i] = wheels[i]->getLastSteps();
+            pwm[i] = wheels[i]->getOutputPWM();
+        }
+        this->commitMotors();
+        this->pendingTime += (sampleTime - this->lastSampleTime) * MICROS;
+        this->lastSampleTime = sampleTime;
+    }
+
+    /* Count steps for odometry and record the cycle */
+    for (uint8_t i=0; i<WHEELS_NUM; i++) {
+        this->odometrySteps[i] += steps[i];
+    }
+    Movements::MovementType movement = Movements::MovementType::STILL;
+    this->movementsHandler.peek(0, &movement);
+    this->flightRecorder.record(sampleTime, steps, this->targetsPWM, pwm, (uint8_t)movement);
+}
+
+template<class WheelT>
+void BasicOmni3<WheelT>::commitMotors() {
+    if (this->motorBus != nullptr) {
+        this->motorBus->flush();
+    }
+}
+
+template<class WheelT>
+void BasicOmni3<WheelT>::handleCalibration() {
+    CalibrationState state = this->calibration.handle(this->wheels, micros());
+    this->commitMotors();
+    if (state != CalibrationState::DONE) {
+        return;
+    }
+
+    /* Apply results; the velocity gain of the motor model is updated only if feed-forward is in use */
+    double kP, kI, kD;
+    this->calibration.getPID(&kP, &kI, &kD);
+    this->setMaxWheelSpeed(this->calibration.getMaxSpeed());
+    this->setPIDConstants(kP, kI, kD);
+    if (this->parameters.kV != 0.0) {
+        this->setFeedForward(this->parameters.kS, this->wheels[W_RIGHT]->getTestVelocityGain(this->parameters.kS),
+                             this->parameters.kA);
+    }
+
+    /* Then write them back where they were read from */
+    if (this->memAddr >= 0) {
+        this->commitParameters(this->memAddr);
+    }
+}
+
+template<class WheelT>
+void BasicOmni3<WheelT>::directKinematics(const control_t* angularDisplacement) {
+    /* forward = tan(30°)*R * (wR - wL) */
+    this->displacement[FORWARD] = R_C * Kinematics::forward(angularDisplacement);
+
+    /* strafe = R/3 * (wR - 2*wB + wL) */
+    this->displacement[STRAFE] = R_C * Kinematics::strafe(angularDisplacement);
+
+    /* theta = R/(3*L) * (wR + wB + wL) */
+    this->displacement[THETA] = R_3L * Kinematics::rotation(angularDisplacement);
+}
+
+template<class WheelT>
+bool BasicOmni3<WheelT>::inverseKinematics(const double* speed) {
+    /* wR = sin(30°)/R * strafe + cos(30°)/R * forward + L/R * theta
+     * wB = cos(180°)/R * strafe + L/R * theta
+     * wL = sin(30°)/R * strafe - cos(30°)/R * forward + L/R * theta */
+    control_t translation[WHEELS_NUM];
+    Kinematics::inverse(ONE_R * control_t(speed[FORWARD]), ONE_R * control_t(speed[STRAFE]), translation);
+    const control_t T = L_R * control_t(speed[THETA]);
+
+    return this->setWheelsSpeed(translation, T, false);
+}
+
+template<class WheelT>
+bool BasicOmni3<WheelT>::normalizedInverseKinematics(const double* speed) {
+    /* wR = sin(30°)*strafe + cos(30°)*forward + theta
+     * wB = cos(180°)*strafe + theta
+     * wL = sin(30°)*strafe - cos(30°)*forward + theta */
+    control_t translation[WHEELS_NUM];
+    Kinematics::inverse(control_t(speed[FORWARD]), control_t(speed[STRAFE]), translation);
+    const control_t T = control_t(speed[THETA]);
+
+    return this->setWheelsSpeed(translation, T, true);
+}
+
+template<class WheelT>
+bool BasicOmni3<WheelT>::setWheelsSpeed(const control_t* translation, control_t rotation, bool isNormalized) {
+    const control_t ZERO = control_t(0.0);
+    const control_t ONE = control_t(1.0);
+
+    /* Express both components of each wheel's speed as fractions of its maximum speed, where 1 is the limit */
+    control_t normTranslation[WHEELS_NUM], normRotation[WHEELS_NUM];
+    for (uint8_t i=0; i<WHEELS_NUM; i++) {
+        normTranslation[i] = isNormalized ? translation[i] : wheels[i]->normalizeSpeed(translation[i]);
+        normRotation[i] = isNormalized ? rotation : wheels[i]->normalizeSpeed(rotation);
+    }
+
+    /* Find the scale factors of translation and rotation keeping every wheel in range */
+    control_t translationScale = ONE, rotationScale = ONE;
+    if (this->desaturation == Desaturation::UNIFORM) {
+        /* The fastest wheel sets the scale of the whole vector */
+        control_t peak = ONE;
+        for (uint8_t i=0; i<WHEELS_NUM; i++) {
+            control_t wheelSpeed = normTranslation[i] + normRotation[i];
+            if (wheelSpeed < ZERO) {
+                wheelSpeed = -wheelSpeed;
+            }
+            if (wheelSpeed > peak) {
+                peak = wheelSpeed;
+            }
+        }
+        translationScale = rotationScale = ONE / peak;
+    }
+    else if (this->desaturation == Desaturation::ROTATION_PRIORITY) {
+        /* Rotation is scaled only if it can't be performed alone */
+        control_t peak = ONE;
+        for (const control_t & r : normRotation) {
+            control_t magnitude = r < ZERO ? -r : r;
+            if (magnitude > peak) {
+                peak = magnitude;
+            }
+        }
+        rotationScale = ONE / peak;
+
+        /* Translation gets what is left: |k*t + r| <= 1 as long as k*|t| <= 1 - r*sign(t) */
+        for (uint8_t i=0; i<WHEELS_NUM; i++) {
+            if (normTranslation[i] == ZERO) {
+                continue;
+            }
+            control_t magnitude = normTranslation[i];
+            control_t margin = ONE - rotationScale * normRotation[i];
+            if (magnitude < ZERO) {
+                magnitude = -magnitude;
+                margin = ONE + rotationScale * normRotation[i];
+            }
+            if (margin < ZERO) {
+                margin = ZERO;
+            }
+            if (translationScale * magnitude > margin) {
+                translationScale = margin / magnitude;
+            }
+        }
+    }
+
+    /* Convert every speed to PWM, without setting any of them if one is not feasible */
+    control_t pwm[WHEELS_NUM];
+    for (uint8_t i=0; i<WHEELS_NUM; i++) {
+        control_t normSpeed = translationScale * normTranslation[i] + rotationScale * normRotation[i];
+
+        /* Rounding of the scale factors must not turn a desaturated speed into an unfeasible one */
+        if (this->desaturation != Desaturation::NONE) {
+            normSpeed = constrain(normSpeed, -ONE, ONE);
+        }
+        if (!wheels[i]->normalizedSpeedToPWM(normSpeed, &pwm[i])) {
+            return false;
+        }
+    }
+
+    /* In degraded mode, scale all the speeds down so that the fastest wheel doesn't exceed the cap */
+    if (this->deadlineMonitor.isDegraded()) {
+        const control_t cap = control_t(this->deadlineMonitor.getSpeedCap() * MotorDriver::MAX_PWM);
+        control_t peak = cap;
+        for (const control_t & target : pwm) {
+            control_t magnitude = target < ZERO ? -target : target;
+            if (magnitude > peak) {
+                peak = magnitude;
+            }
+        }
+        if (peak > cap) {
+            const control_t scale = cap / peak;
+            for (control_t & target : pwm) {
+                target = target * scale;
+            }
+        }
+    }
+
+    /* In fixed-rate mode hand off the targets to the control interrupt, otherwise set them directly */
+    if (this->fixedRate) {
+        wheels_targets_s &targets = this->targetsBuffer.writeBuffer();
+        for (uint8_t i=0; i<WHEELS_NUM; i++) {
+            targets.pwm[i] = pwm[i];
+        }
+        targets.sequence = ++this->targetsSequence;
+        this->targetsBuffer.publish();
+    }
+    else {
+        for (uint8_t i=0; i<WHEELS_NUM; i++) {
+            wheels[i]->setTargetPWM(pwm[i]);
+        }
+    }
+    for (uint8_t i=0; i<WHEELS_NUM; i++) {
+        this->targetsPWM[i] = pwm[i];
+    }
+    return true;
+}
+
+template<class WheelT>
+void BasicOmni3<WheelT>::fixedRateInterrupt() {
+    BasicOmni3 *instance = BasicOmni3::fixedRateInstance;
+    if (instance != nullptr) {
+        instance->controlStep();
+    }
+}
+
+template<class WheelT>
+void BasicOmni3<WheelT>::watchdogInterrupt() {
+    BasicOmni3 *instance = BasicOmni3::watchdogInstance;
+    if (instance == nullptr) {
+        return;
+    }
+
+    /* handle() stalled: stop the motors as emergencyStop() does, interrupts are already disabled; a motor bus is not
+       flushed if the stalled loop was flushing it, and in both cases nothing sends the stop again until fixed-rate mode
+       or handle() flush the next commands, so the failure is counted */
+    instance->flightRecorder.freeze();
+    for (auto & wheel : instance->wheels) {
+        wheel->setMaxSpeed(0.0);
+    }
+    if (instance->motorBus != nullptr && !instance->motorBus->flushFromInterrupt()) {
+        instance->deadlineMonitor.recordFailedStop();
+    }
+    instance->deadlineMonitor.recordStall();
+}
+
+template<class WheelT>
+void BasicOmni3<WheelT>::controlStep() {
+    /* If previous period is still running (i.e. an encoder re-enabled interrupts), skip this one */
+    if (this->isControlStepRunning) {
+        this->profiler.recordControlOverrun();
+        return;
+    }
+    this->isControlStepRunning = true;
+
+    /* Sample all the encoders at the same instant, then apply last published targets, run each wheel's PID and count
+       its steps */
+    this->sampleWheels();
+    const wheels_targets_s &targets = this->targetsBuffer.read();
+    bool isTargetsNew = targets.sequence != this->appliedTargetsSequence;
+    this->appliedTargetsSequence = targets.sequence;
+    for (uint8_t i=0; i<WHEELS_NUM; i++) {
+        if (isTargetsNew) {
+            wheels[i]->setTargetPWM(targets.pwm[i]);
+        }
+        this->totalSteps.steps[i] += wheels[i]->handleFixedRate();
+    }
+    this->commitMotors();
+    this->totalSteps.cycles++;
+
+    /* Publish counted steps for handle() */
+    this->stepsBuffer.write(this->totalSteps);
+    this->isControlStepRunning = false;
+}
+
+template<class WheelT>
+unsigned long BasicOmni3<WheelT>::sampleWheels() {
+    /* Take a single timestamp and read all the encoders back to back with interrupts disabled; encoders may re-enable
+       interrupts when read (the Encoder library does), so they are disabled again after each read */
+    noInterrupts();
+    unsigned long time = micros();
+    for (auto & wheel : wheels) {
+        wheel->sample();
+        noInterrupts();
+    }
+    return time;
+}
+
+template<class WheelT>
+void BasicOmni3<WheelT>::updateOdometry() {
+    /* Wheels' steps and displacement since the last run */
+    unsigned long stageStart = this->profiler.now();
+    long steps[WHEELS_NUM];
+    control_t angularDisplacement[WHEELS_NUM];
+    for (uint8_t i=0; i<WHEELS_NUM; i++) {
+        steps[i] = this->odometrySteps[i] - this->integratedSteps[i];
+        this->integratedSteps[i] = this->odometrySteps[i];
+        angularDisplacement[i] = WheelT::stepsToAngle(steps[i]);
+    }
+    directKinematics(angularDisplacement);
+    this->profiler.record(ProfilerStage::DIRECT_KINEMATICS, stageStart);
+    stageStart = this->profiler.now();
+    odometry(steps);
+    this->profiler.record(ProfilerStage::ODOMETRY, stageStart);
+
+    for (uint8_t i=0; i<DOF; i++) {
+        this->currentSpeed[i] = static_cast<double>(this->displacement[i]) / this->pendingTime;
+    }
+    this->pendingTime = 0.0;
+}
+
+template<class WheelT>
+void BasicOmni3<WheelT>::odometry(const long *steps) {
+    /* Compute robot's displacement from wheels' steps, exact integers, instead of their rounded angles */
+    const double dX = this->displacementPerStep * Kinematics::forward(steps);
+    const double dY = this->displacementPerStep * Kinematics::strafe(steps);
+
+    /* The heading only depends on the total count of steps, so it doesn't accumulate errors however long the robot
+       runs */
+    long stepsSum = 0;
+    for (long wheelSteps : this->odometrySteps) {
+        stepsSum += wheelSteps;
+    }
+    const double phi = this->headingAt(stepsSum);
+
+    /* Compute average angle during last movement */
+    double dTheta = phi - this->currentPosition[POS_PHI];
+    if (dTheta > PI) {
+        dTheta -= TWO_PI;
+    }
+    else if (dTheta < -PI) {
+        dTheta += TWO_PI;
+    }
+    const double alpha = this->currentPosition[POS_PHI] + dTheta / 2.0;
+    double sinAlpha, cosAlpha;
+    fastSinCos(alpha, &sinAlpha, &cosAlpha);
+
+    /* x' = x + dX*cos(alpha) - dY*sin(alpha), accumulated in fixed point */
+    this->positionAccumulator[0] += (int64_t)floor((cosAlpha * dX - sinAlpha * dY) * ODOMETRY_SCALE + 0.5);
+    this->currentPosition[POS_X] = this->positionAccumulator[0] / ODOMETRY_SCALE;
+
+    /* y' = y + dX*sin(alpha) + dY*cos(alpha), accumulated in fixed point */
+    this->positionAccumulator[1] += (int64_t)floor((sinAlpha * dX + cosAlpha * dY) * ODOMETRY_SCALE + 0.5);
+    this->currentPosition[POS_Y] = this->positionAccumulator[1] / ODOMETRY_SCALE;
+
+    /* phi' in [0, 2*PI) */
+    this->currentPosition[POS_PHI] = phi;
+}
+
+template<class WheelT>
+double BasicOmni3<WheelT>::headingAt(long stepsSum) const {
+    /* Full turns wrap around in the 64-bit product, even for negative steps, so only the fraction of the last turn is
+       converted to radians */
+    const long steps = stepsSum - this->headingBaseSteps;
+    uint64_t turns = this->headingBase + (uint64_t)(int64_t)steps * this->headingPerStep;
+    double heading = ((double)turns / 18446744073709551616.0 + steps * this->headingPerStepRemainder) * TWO_PI;
+    if (heading < 0.0) {
+        heading += TWO_PI;
+    }
+    return heading < TWO_PI ? heading : heading - TWO_PI;
+}
+
+template<class WheelT>
+uint64_t BasicOmni3<WheelT>::toTurns(double turns, double *remainder) {
+    /* Each half is converted from a value with no more significant bits than the double, so no rounding happens */
+    const double high = floor(turns * 4294967296.0);
+    const double low = floor((turns * 4294967296.0 - high) * 4294967296.0);
+    if (remainder != nullptr) {
+        *remainder = ((turns * 4294967296.0 - high) * 4294967296.0 - low) / 4294967296.0 / 4294967296.0;
+    }
+    return ((uint64_t)high << 32) + (uint64_t)low;
+}
+
+template<class WheelT>
+void BasicOmni3<WheelT>::updateOdometryConstants() {
+    /* Steps not integrated yet will be converted with the new constants */
+    long stepsSum = 0;
+    for (long steps : this->integratedSteps) {
+        stepsSum += steps;
+    }
+    this->headingBase = toTurns(this->currentPosition[POS_PHI] / TWO_PI);
+    this->headingBaseSteps = stepsSum;
+    this->displacementPerStep = WheelT::stepsToRadians * this->R;
+    this->headingPerStep = toTurns(fmod(WheelT::stepsToRadians * this->R / (WHEELS_NUM*this->L) / TWO_PI, 1.0),
+                                   &this->headingPerStepRemainder);
+}
+
+template<class WheelT>
+bool BasicOmni3<WheelT>::handleMovementsMessage(uint8_t movementType, uint8_t argsLen, double *args) {
+    switch(movementType) {
+        case 0:
+            if (argsLen==0) {
+                movementsHandler.addStop();
+                return true;
+            }
+            break;
+        case 1:
+            if (argsLen==3) {
+                return movementsHandler.addConstantSpeedMovement(args[0], args[1], args[2]);
+            }
+            break;
+        case 2:
+            if (argsLen==3) {
+                return movementsHandler.addConstantNormSpeedMovement(args[0], args[1], args[2]);
+            }
+            break;
+        case 3:
+            if (argsLen==4) {
+                return movementsHandler.addTargetPosTime(args[0], args[1], args[2], args[3]);
+            }
+            break;
+        case 4:
+            if (argsLen==5) {
+                return movementsHandler.addTargetPosSpeed(
+                        args[0], args[1], args[2], args[3], args[4]);
+            }
+            break;
+        case 5:
+            if (argsLen==5) {
+                return movementsHandler.addTargetPosNormSpeed(
+                        args[0], args[1], args[2], args[3], args[4]);
+            }
+            break;
+        case 6:
+            if (argsLen==4) {
+                return movementsHandler.addTargetSpeedTime(
+                        args[0], args[1], args[2], args[3]);
+            }
+            break;
+        case 7:
+            if (argsLen==4) {
+                return movementsHandler.addTargetNormSpeedTime(
+                        args[0], args[1], args[2], args[3]);
+            }
+            break;
+        case 8:
+            if (argsLen==5) {
+                return movementsHandler.addTargetPosTrapezoid(
+                        args[0], args[1], args[2], args[3], args[4]);
+            }
+            break;
+        case 9:
+            if (argsLen==5) {
+                return movementsHandler.addTargetPosSCurve(
+                        args[0], args[1], args[2], args[3], args[4]);
+            }
+            break;
+        default:
+            return false;
+    }
+    return false;
+}
+
+template<class WheelT>
+bool BasicOmni3<WheelT>::handleTestersMessage(uint8_t testType) {
+#if OMNI3_TESTERS
+    /* Tester message is the one handleMessage() received, since testers have no arguments */
+    byte message = (0b01000 | testType) << 3;
+    uint8_t payload[REPORT_MAX_PAYLOAD];
+#endif
+    switch (testType) {
+#if OMNI3_TESTERS
+        case 0:
+            return Profiler::ENABLED && sendReport(message, payload, this->profiler.writeStages(payload));
+        case 1:
+            return Profiler::ENABLED && sendReport(message, payload, this->profiler.writeOverruns(payload));
+        case 2:
+            this->profiler.reset();
+            return Profiler::ENABLED;
+        case 3:
+            return sendReport(message, payload, this->deadlineMonitor.writeCounters(payload));
+        case 4:
+            this->deadlineMonitor.reset();
+            return true;
+        case TELEMETRY_TESTER:
+            if (!TelemetryStream::ENABLED || this->reportStream == nullptr) {
+                return false;
+            }
+            this->captureTelemetry();
+            this->telemetry.handle(this->reportStream);
+            return true;
+#endif
+        default:
+            return false;
+    }
+    return false;
+}
+
+template<class WheelT>
+void BasicOmni3<WheelT>::captureTelemetry() {
+    /* Bring the position up to date with the steps counted since the last run of odometry */
+    if (this->pendingTime > 0.0) {
+        this->updateOdometry();
+    }
+
+    uint8_t *payload = this->telemetry.payload();
+    uint8_t len = TelemetryStream::write32(payload, 0, millis());
+    for (double position : this->currentPosition) {
+        len = TelemetryStream::writeFixed(payload, len, position);
+    }
+    len = TelemetryStream::write16(payload, len, this->currentSpeed[FORWARD], 1000);
+    len = TelemetryStream::write16(payload, len, this->currentSpeed[STRAFE], 1000);
+    len = TelemetryStream::write16(payload, len, this->currentSpeed[THETA], 1000);
+
+    /* Wheels' state may be updated by the control interrupt in fixed-rate mode */
+    noInterrupts();
+    for (auto & wheel : wheels) {
+        len = TelemetryStream::write16(payload, len, wheel->getActualSpeed(), 1000);
+        len = TelemetryStream::write16(payload, len, wheel->getTargetPWM(), 100);
+        len = TelemetryStream::write16(payload, len, wheel->getLastError(), 100);
+        len = TelemetryStream::write16(payload, len, wheel->getOutputPWM(), 1);
+    }
+    interrupts();
+    this->telemetry.publish((0b01000 | TELEMETRY_TESTER) << 3);
+}
+
+template<class WheelT>
+void BasicOmni3<WheelT>::handleDump() {
+    if (!this->flightRecorder.getDumping()) {
+        return;
+    }
+
+    /* Write the next frame of the dump, if the link has room for it */
+    uint8_t payload[REPORT_MAX_PAYLOAD];
+    uint8_t len = this->flightRecorder.writeDump(payload, REPORT_MAX_PAYLOAD);
+    if (this->sendReport(FLIGHT_RECORDER_FUNCTION << 3, payload, len)) {
+        this->flightRecorder.nextDump(len);
+    }
+}
+
+template<class WheelT>
+void BasicOmni3<WheelT>::reportFootprint() {
+    /* Each wheel is reported once, the robot holds pointers to them */
+    OMNI3_REPORT_RAM(BasicOmni3, BasicOmni3, sizeof(BasicOmni3));
+    OMNI3_REPORT_RAM(BasicOmni3, WheelT, sizeof(WheelT));
+    OMNI3_REPORT_RAM(BasicOmni3, Movements, sizeof(Movements));
+    OMNI3_REPORT_RAM(BasicOmni3, MovementsPool, Movements::getPoolBytes());
+#ifdef OMNI3_MULTI_CORE
+    OMNI3_REPORT_RAM(BasicOmni3, decltype(BasicOmni3::commands), sizeof(BasicOmni3::commands));
+    OMNI3_REPORT_RAM(BasicOmni3, decltype(BasicOmni3::snapshotBuffer), sizeof(BasicOmni3::snapshotBuffer));
+#endif
+    OMNI3_REPORT_RAM(BasicOmni3, BasicCalibration<WheelT>, sizeof(BasicCalibration<WheelT>));
+    OMNI3_REPORT_RAM(BasicOmni3, ParamStore, sizeof(ParamStore));
+    OMNI3_REPORT_RAM(BasicOmni3, TelemetryStream, sizeof(TelemetryStream));
+    OMNI3_REPORT_RAM(BasicOmni3, FlightRecorder, sizeof(FlightRecorder));
+    OMNI3_REPORT_RAM(BasicOmni3, Profiler, sizeof(Profiler));
+    OMNI3_REPORT_RAM(BasicOmni3, DeadlineMonitor, sizeof(DeadlineMonitor));
+}
+
+template<class WheelT>
+bool BasicOmni3<WheelT>::sendReport(byte message, const uint8_t *payload, uint8_t len) {
+    if (this->reportStream == nullptr || this->reportStream->availableForWrite() < len + 4) {
+        return false;
+    }
+
+    /* Write header, payload and CRC of everything but the sync byte with a single write(), so that frames written by
+       the control task are not interleaved with the ones of the other core */
+    uint8_t frame[3 + REPORT_MAX_PAYLOAD + 1] = {REPORT_SYNC, message, len};
+    memcpy(&frame[3], payload, len);
+    frame[3 + len] = crc8(0, &frame[1], len + 2);
+    this->reportStream->write(frame, len + 4);
+    return true;
+}
+
+template<class WheelT>
+bool BasicOmni3<WheelT>::handleSettersMessage(uint8_t setterType, uint8_t argsLen, double *args) {
+    /* Lengths and radii must be positive, gains finite; changes are live, commit them with function 3 */
+    if (argsLen != (setterType <= 2 ? 1 : 3)) {
+        return false;
+    }
+    for (uint8_t i=0; i<argsLen; i++) {
+        if (!isfinite(args[i])) {
+            return false;
+        }
+    }
+    switch (setterType) {
+        case 0:
+            if (args[0] <= 0.0) {
+                return false;
+            }
+            this->setMaxWheelSpeed(args[0]);
+            return true;
+        case 1:
+            if (args[0] <= 0.0) {
+                return false;
+            }
+            this->setWheelsRadius(args[0]);
+            return true;
+        case 2:
+            if (args[0] <= 0.0) {
+                return false;
+            }
+            this->setRobotRadius(args[0]);
+            return true;
+        case 3:
+            this->setPIDConstants(args[0], args[1], args[2]);
+            return true;
+        case 4:
+            this->setFrictionConstants(args[0], args[1], args[2]);
+            return true;
+        case 5:
+            this->setFeedForward(args[0], args[1], args[2]);
+            return true;
+        default:
+            return false;
+    }
+}
+
+template<class WheelT>
+bool BasicOmni3<WheelT>::handleFunctionsMessage(uint8_t functionType) {
+    switch (functionType) {
+        case 0:
+            movementsHandler.clear();
+            calibration.abort();
+            return true;
+        case 1:
+            return movementsHandler.removeTail();
+        case 2:
+            return beginCalibration();
+        case 3:
+            return commitParameters(this->memAddr);
+        case FLIGHT_RECORDER_FUNCTION:
+            if (!FlightRecorder::ENABLED || this->reportStream == nullptr) {
+                return false;
+            }
+            this->flightRecorder.beginDump();
+            return true;
+        default:
+            return false;
+    }
+}
+
+#endif //OMNI3_OMNI3_IMPL_H
@@ -1,17 +1,25 @@
 #include "omni3.h"
+#include "serial_protocol.h"
 
-Omni3 *robot;
+/* Encoders are decoded by QuadratureEncoder on pin-change interrupt pins, which needs OMNI3_PIN_CHANGE_ISR: on the
+   Mega, 10-13 and 50-53 are all on port B, so a single interrupt vector serves every edge */
+typedef BasicWheel<MotorDriver, QuadratureEncoder> RobotWheel;
+typedef BasicOmni3<RobotWheel> Robot;
+
+Robot *robot;
+BasicSerialProtocol<Robot> *protocol;
 
 void setup() {
-    robot = new Omni3(new Wheel(new MDD3A(3, 4), new Encoder(9, 10)),
-                      new Wheel(new MDD3A(5, 6), new Encoder(11, 12)),
-                      new Wheel(new MDD3A(7, 8), new Encoder(13, 14)),
+    Serial.begin(115200);
+    robot = new Robot(new RobotWheel(new MDD3A(3, 4), new QuadratureEncoder(10, 11)),
+                      new RobotWheel(new MDD3A(5, 6), new QuadratureEncoder(12, 13)),
+                      new RobotWheel(new MDD3A(7, 8), new QuadratureEncoder(50, 51)),
                       0);
+    protocol = new BasicSerialProtocol<Robot>(robot, &Serial);
 }
 
 void loop() {
-    double args[MAX_ARGS];
-    robot->handleMessage(0, args);
+    protocol->handle();
     robot->handle();
 
 }
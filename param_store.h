@@ -0,0 +1,234 @@
+#ifndef OMNI3_PARAM_STORE_H
+#define OMNI3_PARAM_STORE_H
+
+#include "Arduino.h"
+#include <EEPROM.h>
+
+#include "crc.h"
+#include "bytes.h"
+#include "wheel.h"
+
+/**
+ * Default wheels' maximum angular speed in radians per second, used when no valid parameters are stored
+ */
+#define D_MAX_WHEEL_SPEED 10.0
+
+/**
+ * Default wheels' radius in meters, used when no valid parameters are stored
+ */
+#define D_WHEELS_RADIUS 0.03
+
+/**
+ * Default robot's radius in meters, used when no valid parameters are stored
+ */
+#define D_ROBOT_RADIUS 0.15
+
+/**
+ * Default friction constants, used when no valid parameters are stored
+ */
+#define D_FRICTION_K 1.0
+
+/**
+ * First byte of a stored parameters image
+ */
+#define PARAMS_MAGIC 0x3A
+
+/**
+ * Version of the stored parameters layout; it must be increased whenever fields of omni3_params_t change, so that
+ * images written by older firmware are rejected instead of being misread
+ */
+#define PARAMS_VERSION 2
+
+/**
+ * Number of fields of omni3_params_t
+ */
+#define PARAMS_FIELDS 12
+
+/**
+ * Size in bytes of a stored parameters image: magic, version, number of fields, fields as little-endian IEEE-754
+ * float32 numbers, CRC-8 (see crc.h) of all the previous bytes
+ */
+#define PARAMS_IMAGE_SIZE (3 + 4*PARAMS_FIELDS + 1)
+
+/**
+ * Struct containing all information necessary for instancing a Omni3 object
+ */
+typedef struct omni3_params_s {
+    /**
+     * Wheels' maximum angular speed in radians per second
+     */
+    double maxWheelSpeed;
+
+    /**
+     * Wheels' radius in meters
+     */
+    double wheelsRadius;
+
+    /**
+     * Robot's radius (i.e. the distance between the center of the robot and a wheel) in meters
+     */
+    double robotRadius;
+
+    /**
+     * PID constants
+     */
+    double kP, kI, kD;
+
+    /**
+     * Friction constants
+     */
+     double fwdFrictionK, strFrictionK, angFrictionK;
+
+    /**
+     * Feed-forward motor model constants of the wheels (see Wheel::setFeedForward()), all 0.0 for PID only
+     */
+    double kS, kV, kA;
+
+} omni3_params_t;
+
+static_assert(sizeof(omni3_params_t) == PARAMS_FIELDS*sizeof(double), "PARAMS_FIELDS doesn't match omni3_params_t");
+
+/**
+ * Class persisting omni3_params_t to EEPROM: the image has a versioned header and a CRC, and stores every field as a
+ * float32 number, so that its layout doesn't depend on the size of double, and small constants as kI keep their
+ * relative precision (a double is a float32 on AVR, so they are stored exactly there); commits are deferred: commit()
+ * only encodes the image, then each handle() writes at most one byte, skipping the ones that are already stored,
+ * since an EEPROM write takes about 3.3 ms and wears the cell
+ */
+class ParamStore {
+public:
+    /**
+     * This method returns the parameters used when no valid image is stored
+     * @return default parameters
+     */
+    static omni3_params_t defaults() {
+        return {D_MAX_WHEEL_SPEED, D_WHEELS_RADIUS, D_ROBOT_RADIUS, D_KP, D_KI, D_KD,
+                D_FRICTION_K, D_FRICTION_K, D_FRICTION_K, 0.0, 0.0, 0.0};
+    }
+
+    /**
+     * This static method reads and validates the image stored at the given address
+     * @param memAddr   starting memory address of the image
+     * @param params    pointer where parameters are stored, left untouched if the image is not valid
+     * @return true if a valid image of the current version was read, false otherwise
+     */
+    static bool load(int memAddr, omni3_params_t *params) {
+        uint8_t image[PARAMS_IMAGE_SIZE];
+        for(uint8_t i=0; i<PARAMS_IMAGE_SIZE; i++) {
+            image[i] = EEPROM.read(memAddr + i);
+        }
+        if(image[0] != PARAMS_MAGIC || image[1] != PARAMS_VERSION || image[2] != PARAMS_FIELDS ||
+           crc8(0, image, PARAMS_IMAGE_SIZE - 1) != image[PARAMS_IMAGE_SIZE - 1]) {
+            return false;
+        }
+        for(uint8_t i=0; i<PARAMS_FIELDS; i++) {
+            uint32_t raw = readLE32(&image[3 + 4*i]);
+            float value;
+            memcpy(&value, &raw, sizeof(value));
+            params->*ParamStore::field(i) = value;
+        }
+        return true;
+    }
+
+    /**
+     * This static method writes an image at the given address, blocking until it is completed; it is meant for
+     * provisioning in setup(), use commit() while the robot is running
+     * @param memAddr   starting memory address of the image
+     * @param params    parameters to be stored
+     */
+    static void write(int memAddr, const omni3_params_t &params) {
+        ParamStore store;
+        store.commit(memAddr, params);
+        while(store.isPending()) {
+            store.handle();
+        }
+    }
+
+    /**
+     * This method schedules the given parameters to be written at the given address; a commit still pending is
+     * replaced; fields are rounded to float32
+     * @param memAddr   starting memory address of the image
+     * @param params    parameters to be stored
+     * @return true if the commit was scheduled, false if the address is out of EEPROM
+     */
+    bool commit(int memAddr, const omni3_params_t &params) {
+        if(memAddr < 0 || memAddr + PARAMS_IMAGE_SIZE > (int)EEPROM.length()) {
+            return false;
+        }
+        this->image[0] = PARAMS_MAGIC;
+        this->image[1] = PARAMS_VERSION;
+        this->image[2] = PARAMS_FIELDS;
+        for(uint8_t i=0; i<PARAMS_FIELDS; i++) {
+            float value = (float)(params.*ParamStore::field(i));
+            uint32_t raw;
+            memcpy(&raw, &value, sizeof(raw));
+            writeLE32(this->image, 3 + 4*i, raw);
+        }
+        this->image[PARAMS_IMAGE_SIZE - 1] = crc8(0, this->image, PARAMS_IMAGE_SIZE - 1);
+        this->memAddr = memAddr;
+        this->index = 0;
+        return true;
+    }
+
+    /**
+     * This method writes the next byte of a pending commit that differs from the stored one; it must be called as
+     * often as possible (Omni3::handle() does it); on AVR it returns immediately while the previous byte is still being
+     * written, since both EEPROM.read() and EEPROM.write() would busy-wait for up to 3.3 ms for it to finish
+     */
+    void handle() {
+#ifdef __AVR__
+        if(this->index < PARAMS_IMAGE_SIZE && !eeprom_is_ready()) {
+            return;
+        }
+#endif
+
+        /* Reading is fast, so unchanged bytes are skipped within the same call */
+        while(this->index < PARAMS_IMAGE_SIZE) {
+            uint8_t i = this->index++;
+            if(EEPROM.read(this->memAddr + i) != this->image[i]) {
+                EEPROM.write(this->memAddr + i, this->image[i]);
+                return;
+            }
+        }
+    }
+
+    /**
+     * @return true if a commit is still being written, false otherwise
+     */
+    bool isPending() const {
+        return this->index < PARAMS_IMAGE_SIZE;
+    }
+
+private:
+    /**
+     * Image being written
+     */
+    uint8_t image[PARAMS_IMAGE_SIZE] {};
+
+    /**
+     * Starting memory address of the image being written
+     */
+    int memAddr = 0;
+
+    /**
+     * Index of the next byte of image to be checked, PARAMS_IMAGE_SIZE if there is no pending commit
+     */
+    uint8_t index = PARAMS_IMAGE_SIZE;
+
+    /**
+     * This method maps a field index of the image to the field of omni3_params_t; the order is part of the layout
+     * @param i     field index, in range [0, PARAMS_FIELDS)
+     * @return pointer to the field
+     */
+    static double omni3_params_t::* field(uint8_t i) {
+        static double omni3_params_t::* const fields[PARAMS_FIELDS] = {
+                &omni3_params_t::maxWheelSpeed, &omni3_params_t::wheelsRadius, &omni3_params_t::robotRadius,
+                &omni3_params_t::kP, &omni3_params_t::kI, &omni3_params_t::kD,
+                &omni3_params_t::fwdFrictionK, &omni3_params_t::strFrictionK, &omni3_params_t::angFrictionK,
+                &omni3_params_t::kS, &omni3_params_t::kV, &omni3_params_t::kA
+        };
+        return fields[i];
+    }
+};
+
+#endif //OMNI3_PARAM_STORE_H
@@ -0,0 +1,236 @@
+#ifndef OMNI3_PROFILER_H
+#define OMNI3_PROFILER_H
+
+#include "Arduino.h"
+#include "bytes.h"
+
+/**
+ * Default budget of Omni3::handle() in microseconds: executions lasting more are counted as loop overruns
+ */
+#ifndef OMNI3_PROFILER_BUDGET
+#define OMNI3_PROFILER_BUDGET 10000UL
+#endif
+
+/**
+ * Number of profiled stages
+ */
+#define PROFILER_STAGES 6
+
+/**
+ * Size in bytes of the statistics of one stage, as written by Profiler::writeStages()
+ */
+#define PROFILER_STAGE_SIZE 6
+
+/**
+ * Size in bytes of the counters written by Profiler::writeOverruns()
+ */
+#define PROFILER_OVERRUNS_SIZE 16
+
+/**
+ * Enumeration of the profiled stages of Omni3::handle(); values are the order in which they are reported
+ * WHEELS               sample and actuate phases of the wheels (reading steps from the control interrupt in
+ *                      fixed-rate mode)
+ * DIRECT_KINEMATICS    Omni3::directKinematics()
+ * ODOMETRY             Omni3::odometry()
+ * MOVEMENTS            Movements::handle()
+ * INVERSE_KINEMATICS   Omni3::inverseKinematics() or Omni3::normalizedInverseKinematics()
+ * LOOP                 whole Omni3::handle()
+ */
+enum class ProfilerStage : uint8_t {WHEELS=0, DIRECT_KINEMATICS=1, ODOMETRY=2, MOVEMENTS=3, INVERSE_KINEMATICS=4,
+                                    LOOP=5};
+
+#ifdef OMNI3_PROFILER
+
+/**
+ * Class collecting execution time statistics of the stages of Omni3::handle(); times are measured with micros(), i.e.
+ * with the Timer0 counter (4 microseconds resolution on 16 MHz AVRs); define OMNI3_PROFILER as a compiler flag for
+ * enabling it, otherwise it is replaced by an empty class and costs nothing
+ */
+class Profiler {
+public:
+    /**
+     * True if profiling is compiled in
+     */
+    static const bool ENABLED = true;
+
+    /**
+     * Constructor of Profiler class, with empty statistics
+     */
+    Profiler() {
+        this->clearStages();
+    }
+
+    /**
+     * This method returns the timestamp to be passed to record() at the end of a stage
+     * @return current time in microseconds
+     */
+    unsigned long now() const {
+        return micros();
+    }
+
+    /**
+     * This method adds the execution time of a stage to its statistics; executions of LOOP stage longer than the
+     * budget are counted as overruns
+     * @param stage     executed stage
+     * @param start     timestamp returned by now() when the stage started
+     */
+    void record(ProfilerStage stage, unsigned long start) {
+        unsigned long elapsed = micros() - start;
+        stage_stats_s &stats = this->stages[static_cast<uint8_t>(stage)];
+
+        /* Keep min and max, saturating to 16 bits */
+        uint16_t elapsed16 = elapsed > 0xFFFF ? 0xFFFF : (uint16_t)elapsed;
+        if(elapsed16 < stats.min) {
+            stats.min = elapsed16;
+        }
+        if(elapsed16 > stats.max) {
+            stats.max = elapsed16;
+        }
+
+        /* Before total overflows, halve it together with count: mean is kept, older executions weigh less */
+        if(stats.total > 0x7FFFFFFFUL) {
+            stats.total >>= 1;
+            stats.count >>= 1;
+        }
+        stats.total += elapsed;
+        stats.count++;
+
+        if(stage == ProfilerStage::LOOP) {
+            this->loops++;
+            if(elapsed > this->budget) {
+                this->loopOverruns++;
+            }
+        }
+    }
+
+    /**
+     * This method counts a control period skipped because the previous one was still running; it is called from the
+     * control interrupt
+     */
+    void recordControlOverrun() {
+        this->controlOverruns = this->controlOverruns + 1;
+    }
+
+    /**
+     * This method clears all the statistics and counters
+     */
+    void reset() {
+        this->clearStages();
+        this->loops = 0;
+        this->loopOverruns = 0;
+        noInterrupts();
+        this->controlOverruns = 0;
+        interrupts();
+    }
+
+    /**
+     * Setter for the budget of Omni3::handle()
+     * @param _budget   budget in microseconds
+     */
+    void setBudget(unsigned long _budget) {
+        this->budget = _budget;
+    }
+
+    /**
+     * This method writes the statistics of every stage, in ProfilerStage order; for each stage min, max and mean
+     * execution time in microseconds are written as little-endian 16-bit numbers (0 for stages never executed)
+     * @param buffer    array of len PROFILER_STAGES*PROFILER_STAGE_SIZE
+     * @return number of written bytes
+     */
+    uint8_t writeStages(uint8_t *buffer) const {
+        uint8_t len = 0;
+        for(const auto & stats : this->stages) {
+            unsigned long mean = stats.count == 0 ? 0 : stats.total / stats.count;
+            len = writeLE16(buffer, len, stats.count == 0 ? 0 : stats.min);
+            len = writeLE16(buffer, len, stats.max);
+            len = writeLE16(buffer, len, mean > 0xFFFF ? 0xFFFF : (uint16_t)mean);
+        }
+        return len;
+    }
+
+    /**
+     * This method writes budget, number of loops, loop overruns and control overruns as little-endian 32-bit numbers
+     * @param buffer    array of len PROFILER_OVERRUNS_SIZE
+     * @return number of written bytes
+     */
+    uint8_t writeOverruns(uint8_t *buffer) const {
+        noInterrupts();
+        unsigned long _controlOverruns = this->controlOverruns;
+        interrupts();
+
+        uint8_t len = 0;
+        len = writeLE32(buffer, len, this->budget);
+        len = writeLE32(buffer, len, this->loops);
+        len = writeLE32(buffer, len, this->loopOverruns);
+        len = writeLE32(buffer, len, _controlOverruns);
+        return len;
+    }
+
+private:
+    /**
+     * Statistics of a stage, times in microseconds
+     */
+    struct stage_stats_s {
+        uint16_t min, max;
+        unsigned long total;
+        unsigned long count;
+    };
+
+    /**
+     * Statistics of every stage, indexed by ProfilerStage
+     */
+    stage_stats_s stages[PROFILER_STAGES];
+
+    /**
+     * Budget of Omni3::handle() in microseconds
+     */
+    unsigned long budget = OMNI3_PROFILER_BUDGET;
+
+    /**
+     * Number of recorded executions of Omni3::handle()
+     */
+    unsigned long loops = 0;
+
+    /**
+     * Number of executions of Omni3::handle() lasting more than budget
+     */
+    unsigned long loopOverruns = 0;
+
+    /**
+     * Number of control periods skipped in fixed-rate mode
+     */
+    volatile unsigned long controlOverruns = 0;
+
+    /**
+     * This method clears the statistics of every stage
+     */
+    void clearStages() {
+        for(auto & stats : this->stages) {
+            stats.min = 0xFFFF;
+            stats.max = 0;
+            stats.total = 0;
+            stats.count = 0;
+        }
+    }
+};
+
+#else
+
+/**
+ * Empty replacement of the profiler, used when OMNI3_PROFILER is not defined: every call is optimized away
+ */
+class Profiler {
+public:
+    static const bool ENABLED = false;
+    unsigned long now() const { return 0; }
+    void record(ProfilerStage, unsigned long) {}
+    void recordControlOverrun() {}
+    void reset() {}
+    void setBudget(unsigned long) {}
+    uint8_t writeStages(uint8_t *) const { return 0; }
+    uint8_t writeOverruns(uint8_t *) const { return 0; }
+};
+
+#endif
+
+#endif //OMNI3_PROFILER_H
@@ -0,0 +1,122 @@
+#include "quadrature_encoder.h"
+
+#if defined(ESP32)
+#define OMNI3_ENCODER_ISR_ATTR IRAM_ATTR
+#else
+#define OMNI3_ENCODER_ISR_ATTR
+#endif
+
+const int8_t QuadratureEncoder::transitions[16] PROGMEM = {0, 1, -1, 2, -1, 0, -2, 1, 1, -2, 0, -1, 2, -1, 1, 0};
+QuadratureEncoder* QuadratureEncoder::encoders[OMNI3_QUADRATURE_ENCODERS] = {};
+volatile uint8_t QuadratureEncoder::encodersNum = 0;
+
+QuadratureEncoder::QuadratureEncoder(uint8_t pin1, uint8_t pin2) {
+    pinMode(pin1, INPUT_PULLUP);
+    pinMode(pin2, INPUT_PULLUP);
+#ifdef __AVR__
+    this->input1 = portInputRegister(digitalPinToPort(pin1));
+    this->input2 = portInputRegister(digitalPinToPort(pin2));
+    this->mask1 = digitalPinToBitMask(pin1);
+    this->mask2 = digitalPinToBitMask(pin2);
+#else
+    this->pin1 = pin1;
+    this->pin2 = pin2;
+#endif
+
+    /* Let pull-ups settle, then register the encoder before enabling its interrupts; encoders beyond the maximum are not
+       decoded */
+    delayMicroseconds(2);
+    this->state = this->readState();
+    noInterrupts();
+    uint8_t index = QuadratureEncoder::encodersNum;
+    if (index < OMNI3_QUADRATURE_ENCODERS) {
+        QuadratureEncoder::encoders[index] = this;
+        QuadratureEncoder::encodersNum = index + 1;
+    }
+    interrupts();
+    if (index < OMNI3_QUADRATURE_ENCODERS) {
+        bool attached1 = QuadratureEncoder::attachPin(pin1);
+        bool attached2 = QuadratureEncoder::attachPin(pin2);
+        this->attached = attached1 && attached2;
+    }
+}
+
+void QuadratureEncoder::write(int32_t _position) {
+    noInterrupts();
+    this->position = _position;
+    interrupts();
+}
+
+void OMNI3_ENCODER_ISR_ATTR QuadratureEncoder::handleInterrupt() {
+    uint8_t num = QuadratureEncoder::encodersNum;
+    for (uint8_t i=0; i<num; i++) {
+        QuadratureEncoder::encoders[i]->update();
+    }
+}
+
+#ifdef __AVR__
+
+bool QuadratureEncoder::attachPin(uint8_t pin) {
+#ifdef OMNI3_PIN_CHANGE_ISR
+    /* Pin-change interrupts are preferred, since each vector serves a whole port */
+    volatile uint8_t *pcicr = digitalPinToPCICR(pin);
+    if (pcicr != nullptr) {
+        uint8_t oldSREG = SREG;
+        cli();
+        *digitalPinToPCMSK(pin) |= _BV(digitalPinToPCMSKbit(pin));
+        *pcicr |= _BV(digitalPinToPCICRbit(pin));
+        SREG = oldSREG;
+        return true;
+    }
+#endif
+    int interrupt = digitalPinToInterrupt(pin);
+    if (interrupt != NOT_AN_INTERRUPT) {
+        attachInterrupt(interrupt, QuadratureEncoder::handleInterrupt, CHANGE);
+        return true;
+    }
+    return false;
+}
+
+/* Pin-change interrupt vectors: they are opt-in, since library objects are linked into every sketch, so they would
+   otherwise be taken even if QuadratureEncoder is never used, and conflict with other libraries using pin-change
+   interrupts (e.g. SoftwareSerial, PinChangeInterrupt, EnableInterrupt) */
+#ifdef OMNI3_PIN_CHANGE_ISR
+
+#ifdef PCINT0_vect
+ISR(PCINT0_vect) {
+    QuadratureEncoder::handleInterrupt();
+}
+#endif
+
+#ifdef PCINT1_vect
+ISR(PCINT1_vect) {
+    QuadratureEncoder::handleInterrupt();
+}
+#endif
+
+#ifdef PCINT2_vect
+ISR(PCINT2_vect) {
+    QuadratureEncoder::handleInterrupt();
+}
+#endif
+
+#ifdef PCINT3_vect
+ISR(PCINT3_vect) {
+    QuadratureEncoder::handleInterrupt();
+}
+#endif
+
+#endif
+
+#else
+
+bool QuadratureEncoder::attachPin(uint8_t pin) {
+    int interrupt = digitalPinToInterrupt(pin);
+    if (interrupt < 0) {
+        return false;
+    }
+    attachInterrupt(interrupt, QuadratureEncoder::handleInterrupt, CHANGE);
+    return true;
+}
+
+#endif
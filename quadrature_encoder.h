@@ -0,0 +1,155 @@
+#ifndef OMNI3_QUADRATURE_ENCODER_H
+#define OMNI3_QUADRATURE_ENCODER_H
+
+#include "Arduino.h"
+
+/**
+ * Maximum number of QuadratureEncoder objects: every interrupt decodes all of them, so it must not be larger than needed
+ */
+#ifndef OMNI3_QUADRATURE_ENCODERS
+#define OMNI3_QUADRATURE_ENCODERS 3
+#endif
+
+/**
+ * Class decoding a quadrature encoder from interrupts on both of its pins, a drop-in replacement of the Encoder
+ * library for BasicWheel, counting in the same direction:
+ * - on AVR, pins must be pin-change interrupt pins (on the Mega 10-15, 50-53 and A8-A15), or external interrupt pins;
+ *   the interrupt service routines read pins with direct port register reads and decode the transition with a 16
+ *   entries table; pin-change vectors are only defined if OMNI3_PIN_CHANGE_ISR is defined, otherwise only external
+ *   interrupt pins are attached
+ * - on the other architectures, pins are attached to interrupts with attachInterrupt()
+ * Every interrupt decodes all the encoders, so that encoders can share interrupt vectors and a pin-change vector serves
+ * all the pins of its port; read() takes an atomic snapshot of the position which doesn't enable interrupts, so that
+ * a robot can read all its encoders inside a single critical section
+ */
+class QuadratureEncoder {
+public:
+    /**
+     * Constructor of QuadratureEncoder class; it sets the pins as inputs with pull-up and enables their interrupts
+     * @param pin1      first pin of the encoder
+     * @param pin2      second pin of the encoder
+     */
+    QuadratureEncoder(uint8_t pin1, uint8_t pin2);
+
+    /**
+     * This method returns the position of the encoder; interrupts are disabled while it is copied, then restored to
+     * their previous state
+     * @return number of steps counted since construction or last write()
+     */
+    int32_t read() const {
+#ifdef __AVR__
+        uint8_t oldSREG = SREG;
+        cli();
+        int32_t copy = this->position;
+        SREG = oldSREG;
+        return copy;
+#else
+        /* Aligned 32-bit loads are atomic */
+        return this->position;
+#endif
+    }
+
+    /**
+     * This method sets the position of the encoder
+     * @param position  new position in steps
+     */
+    void write(int32_t position);
+
+    /**
+     * Getter for the state of the interrupts of the encoder
+     * @return true if both pins generate interrupts, false if some edge is only seen on interrupts of other encoders
+     */
+    bool isAttached() const {
+        return this->attached;
+    }
+
+    /**
+     * This method decodes all the encoders; it is called by the interrupt service routines and must not be called
+     * directly
+     */
+    static void handleInterrupt();
+
+private:
+    /**
+     * Position change for each transition, indexed by new state of pin2 and pin1 followed by old state of pin2 and
+     * pin1; transitions skipping a state are assumed to be 2 steps in the direction of an edge of pin1; it is stored
+     * in flash memory
+     */
+    static const int8_t transitions[16] PROGMEM;
+
+    /**
+     * Registered encoders, decoded by handleInterrupt()
+     */
+    static QuadratureEncoder* encoders[OMNI3_QUADRATURE_ENCODERS];
+
+    /**
+     * Number of registered encoders
+     */
+    static volatile uint8_t encodersNum;
+
+    /**
+     * Position in steps, written by interrupts
+     */
+    volatile int32_t position = 0;
+
+    /**
+     * Last state of pins: pin2 level in bit 1, pin1 level in bit 0
+     */
+    uint8_t state = 0;
+
+    /**
+     * True if both pins generate interrupts
+     */
+    bool attached = false;
+
+#ifdef __AVR__
+    /**
+     * Input registers of the ports of the pins
+     */
+    volatile uint8_t *input1;
+    volatile uint8_t *input2;
+
+    /**
+     * Bit masks of the pins in their ports
+     */
+    uint8_t mask1;
+    uint8_t mask2;
+#else
+    /**
+     * Pin numbers
+     */
+    uint8_t pin1;
+    uint8_t pin2;
+#endif
+
+    /**
+     * This method reads the current state of the pins
+     * @return pin2 level in bit 1, pin1 level in bit 0
+     */
+    uint8_t readState() const {
+#ifdef __AVR__
+        return ((*this->input2 & this->mask2) ? 2 : 0) | ((*this->input1 & this->mask1) ? 1 : 0);
+#else
+        return (digitalRead(this->pin2) == HIGH ? 2 : 0) | (digitalRead(this->pin1) == HIGH ? 1 : 0);
+#endif
+    }
+
+    /**
+     * This method decodes the transition from the last state to the current one
+     */
+    void update() {
+        uint8_t newState = this->readState();
+        int8_t change = (int8_t)pgm_read_byte(&QuadratureEncoder::transitions[(newState << 2) | this->state]);
+        this->position = this->position + change;
+        this->state = newState;
+    }
+
+    /**
+     * This method enables the interrupts of a pin
+     * @param pin       pin number
+     * @return true if the pin generates interrupts, false otherwise
+     */
+    static bool attachPin(uint8_t pin);
+};
+
+#endif //OMNI3_QUADRATURE_ENCODER_H
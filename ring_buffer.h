@@ -0,0 +1,161 @@
+#ifndef OMNI3_RING_BUFFER_H
+#define OMNI3_RING_BUFFER_H
+
+#include "Arduino.h"
+
+/**
+ * Fixed-capacity circular FIFO queue: all the operations are O(1) and no memory is allocated; it is not meant to be
+ * shared between main loop and interrupts
+ * @tparam T    type of the elements
+ * @tparam N    capacity of the queue
+ */
+template<class T, uint16_t N>
+class RingBuffer {
+    static_assert(N > 0, "RingBuffer capacity must be positive");
+
+public:
+    /**
+     * Maximum number of elements of the queue
+     */
+    static const uint16_t CAPACITY = N;
+
+    /**
+     * This method appends an element at the end of the queue
+     * @param item      element to be appended
+     * @return true if the element was appended, false if the queue is full
+     */
+    bool push(const T& item) {
+        if(this->isFull()) {
+            return false;
+        }
+        this->items[RingBuffer::wrap(this->head + this->count)] = item;
+        this->count++;
+        return true;
+    }
+
+    /**
+     * This method removes the element at the beginning of the queue
+     * @return true if an element was removed, false if the queue is empty
+     */
+    bool pop() {
+        if(this->isEmpty()) {
+            return false;
+        }
+        this->head = RingBuffer::wrap(this->head + 1);
+        this->count--;
+        return true;
+    }
+
+    /**
+     * This method removes the element at the end of the queue
+     * @return true if an element was removed, false if the queue is empty
+     */
+    bool popBack() {
+        if(this->isEmpty()) {
+            return false;
+        }
+        this->count--;
+        return true;
+    }
+
+    /**
+     * This method returns the element at the given position, counting from the beginning of the queue; index must be
+     * less than size()
+     * @param index     position of the element, 0 is the first one
+     * @return reference to the element
+     */
+    T& operator[](uint16_t index) {
+        return this->items[RingBuffer::wrap(this->head + index)];
+    }
+
+    /**
+     * This method returns the element at the given position, counting from the beginning of the queue; index must be
+     * less than size()
+     * @param index     position of the element, 0 is the first one
+     * @return const reference to the element
+     */
+    const T& operator[](uint16_t index) const {
+        return this->items[RingBuffer::wrap(this->head + index)];
+    }
+
+    /**
+     * This method returns the first element; the queue must not be empty
+     * @return reference to the first element
+     */
+    T& front() {
+        return (*this)[0];
+    }
+
+    /**
+     * This method returns the last element; the queue must not be empty
+     * @return reference to the last element
+     */
+    T& back() {
+        return (*this)[this->count - 1];
+    }
+
+    /**
+     * This method removes all the elements
+     */
+    void clear() {
+        this->head = 0;
+        this->count = 0;
+    }
+
+    /**
+     * Getter for the number of elements
+     * @return number of elements in the queue
+     */
+    uint16_t size() const {
+        return this->count;
+    }
+
+    /**
+     * Getter for the number of free slots
+     * @return number of elements that can still be appended
+     */
+    uint16_t freeSlots() const {
+        return N - this->count;
+    }
+
+    /**
+     * @return true if the queue has no elements, false otherwise
+     */
+    bool isEmpty() const {
+        return this->count == 0;
+    }
+
+    /**
+     * @return true if no elements can be appended, false otherwise
+     */
+    bool isFull() const {
+        return this->count >= N;
+    }
+
+private:
+    /**
+     * Storage of the elements
+     */
+    T items[N] {};
+
+    /**
+     * Position of the first element in items
+     */
+    uint16_t head = 0;
+
+    /**
+     * Number of elements
+     */
+    uint16_t count = 0;
+
+    /**
+     * This method wraps an index in range [0, 2*N) to range [0, N) without divisions
+     * @param index     index to be wrapped
+     * @return index in range [0, N)
+     */
+    static uint16_t wrap(uint16_t index) {
+        return index >= N ? index - N : index;
+    }
+};
+
+#endif //OMNI3_RING_BUFFER_H
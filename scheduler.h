@@ -0,0 +1,78 @@
+#ifndef OMNI3_SCHEDULER_H
+#define OMNI3_SCHEDULER_H
+
+#include "Arduino.h"
+
+/**
+ * Number of tasks scheduled by Omni3::handle()
+ */
+#define SCHEDULER_TASKS 4
+
+/**
+ * Enumeration of the tasks of Omni3::handle(), each one running at its own period
+ * WHEELS       sample and actuate phases of the wheels, i.e. their PID (reading steps from the control interrupt in
+ *              fixed-rate mode)
+ * ODOMETRY     direct kinematics and odometry on the wheels' displacement accumulated since the previous run; it also
+ *              runs whenever PLANNER runs, so that the planner always works on an up to date position
+ * PLANNER      Movements::handle() and inverse kinematics; wheels keep the target speeds between runs
+ * TELEMETRY    snapshot of odometry and wheels' state for the telemetry stream, only while it is enabled
+ */
+enum class SchedulerTask : uint8_t {WHEELS=0, ODOMETRY=1, PLANNER=2, TELEMETRY=3};
+
+/**
+ * Class implementing a cooperative scheduler of periodic tasks: the owner polls isDue() for each task as often as
+ * possible and runs the ones that are due; a task with period 0 runs at every poll
+ * @tparam TASKS    number of tasks
+ */
+template<uint8_t TASKS>
+class RateScheduler {
+public:
+    /**
+     * This method sets the period of a task
+     * @param task      index of the task, in range [0, TASKS)
+     * @param period    period in microseconds, 0 for running at every poll
+     */
+    void setPeriod(uint8_t task, unsigned long period) {
+        this->periods[task] = period;
+    }
+
+    /**
+     * Getter for the period of a task
+     * @param task      index of the task, in range [0, TASKS)
+     * @return period in microseconds
+     */
+    unsigned long getPeriod(uint8_t task) const {
+        return this->periods[task];
+    }
+
+    /**
+     * This method checks whether a task is due and, if so, marks it as run
+     * @param task      index of the task, in range [0, TASKS)
+     * @param time      current time in microseconds
+     * @return true if the task must run now, false otherwise
+     */
+    bool isDue(uint8_t task, unsigned long time) {
+        const unsigned long period = this->periods[task];
+        const unsigned long elapsed = time - this->lastRun[task];
+        if(elapsed < period) {
+            return false;
+        }
+
+        /* Keep the phase if the task is late by less than a period, otherwise restart from now instead of bursting */
+        this->lastRun[task] = period > 0 && elapsed < 2*period ? this->lastRun[task] + period : time;
+        return true;
+    }
+
+private:
+    /**
+     * Period of each task in microseconds
+     */
+    unsigned long periods[TASKS] {};
+
+    /**
+     * Time in microseconds each task was last due
+     */
+    unsigned long lastRun[TASKS] {};
+};
+
+#endif //OMNI3_SCHEDULER_H
@@ -0,0 +1,395 @@
+#ifndef OMNI3_SERIAL_PROTOCOL_H
+#define OMNI3_SERIAL_PROTOCOL_H
+
+#include "Arduino.h"
+#include "omni3.h"
+#include "crc.h"
+#include "bytes.h"
+
+/**
+ * First byte of a command frame whose arguments are little-endian float32 numbers
+ */
+#define PROTOCOL_SYNC_FLOAT 0xA5
+
+/**
+ * First byte of a command frame whose arguments are little-endian Q16.16 fixed-point numbers
+ */
+#define PROTOCOL_SYNC_FIXED 0xA6
+
+/**
+ * First byte of a waypoints frame, scheduling a route of movements of type 4
+ */
+#define PROTOCOL_SYNC_WAYPOINTS 0xA7
+
+/**
+ * First byte of an acknowledgement frame
+ */
+#define PROTOCOL_SYNC_ACK 0x5A
+
+/**
+ * First byte of the acknowledgement frame of a waypoints frame
+ */
+#define PROTOCOL_SYNC_WAYPOINTS_ACK 0x5C
+
+/**
+ * Maximum number of waypoints of a waypoints frame: more can't be scheduled at once anyway
+ */
+#define PROTOCOL_MAX_WAYPOINTS OMNI3_MAX_MOVEMENTS
+
+/**
+ * Size in bytes of the header of the body of a waypoints frame: count, sequence, planar and angular speeds
+ */
+#define PROTOCOL_WAYPOINTS_HEADER (2 + 2*PROTOCOL_ARG_SIZE)
+
+/**
+ * Size in bytes of each argument of a command frame
+ */
+#define PROTOCOL_ARG_SIZE 4
+
+/**
+ * Maximum size in bytes of the body of a frame: message, sequence and arguments of a command frame, or header and
+ * waypoints of a waypoints frame
+ */
+#define PROTOCOL_MAX_BODY max(2 + MAX_ARGS*PROTOCOL_ARG_SIZE, \
+                              PROTOCOL_WAYPOINTS_HEADER + PROTOCOL_MAX_WAYPOINTS*WAYPOINT_SIZE)
+
+static_assert(PROTOCOL_MAX_BODY <= 255, "Waypoints frame doesn't fit a frame body, lower OMNI3_MAX_MOVEMENTS");
+
+/**
+ * Size in bytes of an acknowledgement frame: sync, sequence, status, credits and CRC
+ */
+#define PROTOCOL_ACK_SIZE 5
+
+/**
+ * Class template implementing a non-blocking binary protocol on top of a Stream (e.g. Serial) for Omni3 robots:
+ * - command frame: sync (PROTOCOL_SYNC_FLOAT or PROTOCOL_SYNC_FIXED), message (as in Omni3::handleMessage()),
+ *   sequence, arguments (as many as the 3 LSB of message, 4 bytes each), CRC-8 (see crc.h) of message, sequence and
+ *   arguments
+ * - acknowledgement frame: PROTOCOL_SYNC_ACK, sequence of the command, status (see AckStatus), credits (number of free
+ *   slots of the movements schedule after the command), CRC-8 of sequence, status and credits
+ * - waypoints frame: PROTOCOL_SYNC_WAYPOINTS, count (at most PROTOCOL_MAX_WAYPOINTS), sequence, planar and angular
+ *   speeds (float32), count packed waypoints (see Omni3::handleWaypointsMessage()), CRC-8 of all but sync; it is
+ *   acknowledged by PROTOCOL_SYNC_WAYPOINTS_ACK, sequence, number of scheduled waypoints, credits, CRC-8
+ * Bytes are consumed from the Stream receive buffer as they come, so handle() never waits for a frame to be complete;
+ * credits let the host pipeline movements without overrunning the schedule
+ * @tparam Robot    type of the robot, an instantiation of BasicOmni3
+ */
+template<class Robot>
+class BasicSerialProtocol {
+public:
+    /**
+     * Status byte of acknowledgement frames
+     * OK           command was handled correctly
+     * REJECTED     command was received correctly, but handleMessage() returned false
+     * CRC_ERROR    command was corrupted and discarded, sequence may be corrupted as well
+     */
+    enum class AckStatus : uint8_t {OK=0, REJECTED=1, CRC_ERROR=2};
+
+    /**
+     * Constructor of BasicSerialProtocol class
+     * @param robot     robot receiving the commands
+     * @param stream    stream the frames are read from and acknowledgements are written to; it must implement
+     *                  availableForWrite(), like HardwareSerial does
+     */
+    BasicSerialProtocol(Robot *robot, Stream *stream) : robot(robot), stream(stream) {}
+
+    /**
+     * This method reads the available bytes and dispatches at most one complete command to the robot; it must be
+     * called inside the main Arduino loop, it never blocks
+     * @return true if a command was dispatched, false otherwise
+     */
+    bool handle() {
+        /* An acknowledgement that didn't fit the transmit buffer must be sent before reading further commands */
+        if(this->isAckPending && !this->sendAck()) {
+            return false;
+        }
+
+        /* Stop reading as soon as an acknowledgement is waiting, so that it is not overwritten */
+        while(!this->isAckPending && this->stream->available() > 0) {
+            if(this->parse((uint8_t)this->stream->read())) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+private:
+    /**
+     * Enumeration of the parser states, i.e. the next expected byte of a command frame
+     */
+    enum class State : uint8_t {SYNC, MESSAGE, SEQUENCE, ARGS, CRC};
+
+    /**
+     * Robot receiving the commands
+     */
+    Robot *robot;
+
+    /**
+     * Stream the frames are read from and acknowledgements are written to
+     */
+    Stream *stream;
+
+    /**
+     * Current state of the parser
+     */
+    State state = State::SYNC;
+
+    /**
+     * True if the arguments of the frame being parsed are Q16.16 fixed-point numbers, false if they are float32
+     */
+    bool isFixed = false;
+
+    /**
+     * True if the frame being parsed is a waypoints frame
+     */
+    bool isWaypoints = false;
+
+    /**
+     * Body of the frame being parsed: message, sequence and arguments
+     */
+    uint8_t body[PROTOCOL_MAX_BODY] {};
+
+    /**
+     * Number of bytes of body received so far
+     */
+    uint8_t bodyLen = 0;
+
+    /**
+     * Number of bytes of body the frame being parsed has
+     */
+    uint8_t expectedLen = 0;
+
+    /**
+     * CRC of the bytes of body received so far
+     */
+    uint8_t crc = 0;
+
+    /**
+     * Acknowledgement frame waiting to be sent
+     */
+    uint8_t ack[PROTOCOL_ACK_SIZE] {};
+
+    /**
+     * True if ack could not be sent yet
+     */
+    bool isAckPending = false;
+
+    /**
+     * This method feeds one byte to the parser and dispatches the command when its frame is complete
+     * @param data      received byte
+     * @return true if a command was dispatched, false otherwise
+     */
+    bool parse(uint8_t data) {
+        switch(this->state) {
+            /* Discard bytes until a frame start is found */
+            case State::SYNC:
+                if(data == PROTOCOL_SYNC_FLOAT || data == PROTOCOL_SYNC_FIXED || data == PROTOCOL_SYNC_WAYPOINTS) {
+                    this->isFixed = data == PROTOCOL_SYNC_FIXED;
+                    this->isWaypoints = data == PROTOCOL_SYNC_WAYPOINTS;
+                    this->bodyLen = 0;
+                    this->crc = 0;
+                    this->state = State::MESSAGE;
+                }
+                return false;
+
+            /* The 3 LSB of message are the number of arguments (or the byte is the count of waypoints), so the frame
+             * length is known from now on */
+            case State::MESSAGE:
+                if(this->isWaypoints) {
+                    if(data > PROTOCOL_MAX_WAYPOINTS) {
+                        this->state = State::SYNC;
+                        return false;
+                    }
+                    this->expectedLen = PROTOCOL_WAYPOINTS_HEADER + data*WAYPOINT_SIZE;
+                }
+                else {
+                    this->expectedLen = 2 + (data & 0b00000111)*PROTOCOL_ARG_SIZE;
+                }
+                this->store(data);
+                this->state = State::SEQUENCE;
+                return false;
+
+            case State::SEQUENCE:
+                this->store(data);
+                this->state = this->bodyLen < this->expectedLen ? State::ARGS : State::CRC;
+                return false;
+
+            case State::ARGS:
+                this->store(data);
+                if(this->bodyLen >= this->expectedLen) {
+                    this->state = State::CRC;
+                }
+                return false;
+
+            /* Frame is complete: on CRC match decode arguments and dispatch, then acknowledge */
+            case State::CRC:
+                this->state = State::SYNC;
+                if(data != this->crc) {
+                    this->queueAck(PROTOCOL_SYNC_ACK, static_cast<uint8_t>(AckStatus::CRC_ERROR));
+                    return false;
+                }
+                if(this->isWaypoints) {
+                    this->queueAck(PROTOCOL_SYNC_WAYPOINTS_ACK, this->dispatchWaypoints());
+                }
+                else {
+                    this->queueAck(PROTOCOL_SYNC_ACK,
+                                   static_cast<uint8_t>(this->dispatch() ? AckStatus::OK : AckStatus::REJECTED));
+                }
+                return true;
+        }
+        return false;
+    }
+
+    /**
+     * This method appends a byte to the body of the frame being parsed and updates its CRC
+     * @param data      received byte
+     */
+    void store(uint8_t data) {
+        this->body[this->bodyLen++] = data;
+        this->crc = crc8(this->crc, data);
+    }
+
+    /**
+     * This method decodes the arguments of the parsed frame and passes the command to the robot
+     * @return value returned by the robot's handleMessage()
+     */
+    bool dispatch() {
+        byte message = this->body[0];
+        uint8_t argsLen = message & 0b00000111;
+        double args[MAX_ARGS];
+
+        /* Arguments are decoded straight from the frame body */
+        for(uint8_t i=0; i<argsLen; i++) {
+            args[i] = this->decodeArg(&this->body[2 + i*PROTOCOL_ARG_SIZE]);
+        }
+        return this->robot->handleMessage(message, args);
+    }
+
+    /**
+     * This method passes the waypoints of the parsed frame to the robot; they are read straight from the frame body
+     * @return number of waypoints scheduled
+     */
+    uint8_t dispatchWaypoints() {
+        return this->robot->handleWaypointsMessage(&this->body[PROTOCOL_WAYPOINTS_HEADER], this->body[0],
+                                                   this->decodeArg(&this->body[2]),
+                                                   this->decodeArg(&this->body[2 + PROTOCOL_ARG_SIZE]));
+    }
+
+    /**
+     * This method decodes an argument of the parsed frame
+     * @param arg       first of the PROTOCOL_ARG_SIZE little-endian bytes of the argument
+     * @return decoded argument
+     */
+    double decodeArg(const uint8_t *arg) const {
+        uint32_t raw = readLE32(arg);
+        if(this->isFixed) {
+            return static_cast<double>(Fixed::fromRaw((int32_t)raw));
+        }
+        float value;
+        memcpy(&value, &raw, sizeof(value));
+        return value;
+    }
+
+    /**
+     * This method prepares the acknowledgement of the parsed frame and tries to send it
+     * @param sync      first byte of the acknowledgement, PROTOCOL_SYNC_ACK or PROTOCOL_SYNC_WAYPOINTS_ACK
+     * @param status    outcome of the command (see AckStatus), or number of scheduled waypoints
+     */
+    void queueAck(uint8_t sync, uint8_t status) {
+        uint8_t credits = this->robot->getFreeMovementSlots();
+        this->ack[0] = sync;
+        this->ack[1] = this->bodyLen > 1 ? this->body[1] : 0;
+        this->ack[2] = status;
+        this->ack[3] = credits;
+        this->ack[4] = crc8(0, &this->ack[1], PROTOCOL_ACK_SIZE-2);
+        this->isAckPending = true;
+        this->sendAck();
+    }
+
+    /**
+     * This method sends the pending acknowledgement, if it fits the transmit buffer
+     * @return true if it was sent, false otherwise
+     */
+    bool sendAck() {
+        if(this->stream->availableForWrite() < PROTOCOL_ACK_SIZE) {
+            return false;
+        }
+        this->stream->write(this->ack, PROTOCOL_ACK_SIZE);
+        this->isAckPending = false;
+        return true;
+    }
+};
+
+/**
+ * Serial protocol for Omni3 robots
+ */
+typedef BasicSerialProtocol<Omni3> SerialProtocol;
+
+#ifdef OMNI3_MULTI_CORE
+/**
+ * Class template adapting a robot in dual-core mode (see BasicOmni3::beginDualCore()) to BasicSerialProtocol, so that
+ * the protocol runs on the other core: commands are posted to the control task instead of being handled, then an OK
+ * acknowledgement means that a command was queued, and REJECTED that the queue was full or that the previous batch of
+ * waypoints is still waiting; credits are the free slots of the last snapshot published by the control task
+ * @tparam Robot    type of the robot, an instantiation of BasicOmni3
+ */
+template<class Robot>
+class RemoteRobot {
+public:
+    /**
+     * Constructor of RemoteRobot class
+     * @param robot     robot in dual-core mode receiving the commands
+     */
+    explicit RemoteRobot(Robot *robot) : robot(robot) {}
+
+    /**
+     * This method posts a message to the control task
+     * @param message   message byte, as in BasicOmni3::handleMessage()
+     * @param args      array of as many arguments as the 3 LSB of message
+     * @return true if the message was queued, false otherwise
+     */
+    bool handleMessage(byte message, double *args) {
+        return this->robot->postMessage(message, args);
+    }
+
+    /**
+     * This method posts a batch of waypoints to the control task
+     * @param waypoints     packed waypoints, as in BasicOmni3::handleWaypointsMessage()
+     * @param count         number of waypoints
+     * @param speedMag      planar speed magnitude in m/s
+     * @param angularMag    angular speed magnitude in rad/s
+     * @return number of queued waypoints
+     */
+    uint8_t handleWaypointsMessage(const uint8_t *waypoints, uint8_t count, double speedMag, double angularMag) {
+        return this->robot->postWaypoints(waypoints, count, speedMag, angularMag);
+    }
+
+    /**
+     * Getter for the number of movements that can still be scheduled, according to the last snapshot
+     * @return number of free slots of the movements schedule
+     */
+    uint8_t getFreeMovementSlots() const {
+        omni3_snapshot_s snapshot;
+        this->robot->getSnapshot(&snapshot);
+        return snapshot.freeMovementSlots;
+    }
+
+private:
+    /**
+     * Robot receiving the commands
+     */
+    Robot *robot;
+};
+
+/**
+ * Omni3 robot in dual-core mode, as seen by the core running the communication
+ */
+typedef RemoteRobot<Omni3> RemoteOmni3;
+
+/**
+ * Serial protocol for Omni3 robots in dual-core mode, running on the other core than the control task
+ */
+typedef BasicSerialProtocol<RemoteOmni3> RemoteSerialProtocol;
+#endif
+
+#endif //OMNI3_SERIAL_PROTOCOL_H
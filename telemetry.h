@@ -0,0 +1,169 @@
+#ifndef OMNI3_TELEMETRY_H
+#define OMNI3_TELEMETRY_H
+
+#include "Arduino.h"
+#include "footprint.h"
+#include "crc.h"
+#include "bytes.h"
+#include "fixed_point.h"
+
+/**
+ * First byte of a report frame, written to the report stream by testers and telemetry: sync, message of the tester,
+ * payload length, payload, CRC-8 (see crc.h) of message, length and payload
+ */
+#define REPORT_SYNC 0x5B
+
+/**
+ * Number of wheels whose state is streamed
+ */
+#define TELEMETRY_WHEELS 3
+
+/**
+ * Size in bytes of the payload of a telemetry frame:
+ * - time in milliseconds (uint32)
+ * - x, y in meters and phi in radians (Q16.16, int32)
+ * - forward and strafe speed in mm/s, angular speed in mrad/s (int16)
+ * - for each wheel: speed in mrad/s, target and PID error in hundredths of PWM unit, output PWM value (int16)
+ */
+#define TELEMETRY_PAYLOAD_SIZE (4 + 3*4 + 3*2 + TELEMETRY_WHEELS*4*2)
+
+/**
+ * Size in bytes of a telemetry frame: report frame header (sync, message, length), payload and CRC
+ */
+#define TELEMETRY_FRAME_SIZE (3 + TELEMETRY_PAYLOAD_SIZE + 1)
+
+#if OMNI3_TELEMETRY
+
+/**
+ * Class streaming telemetry frames, formatted as report frames, without blocking: snapshots are encoded into the back
+ * buffer and published by swapping it with the front one, which is written to the stream only when its transmit
+ * buffer has room for the whole frame; a snapshot published while the previous one is still waiting replaces it, so
+ * the host always gets the latest state and the control loop never waits for the link
+ */
+class TelemetryStream {
+public:
+    static const bool ENABLED = true;
+
+    /**
+     * This method returns the payload of the back buffer, to be filled with a snapshot by the encode methods
+     * @return pointer to TELEMETRY_PAYLOAD_SIZE bytes
+     */
+    uint8_t* payload() {
+        return &this->frames[1 - this->front][3];
+    }
+
+    /**
+     * This method completes the frame in the back buffer and makes it the one to be sent
+     * @param message   message byte of the report frame
+     */
+    void publish(byte message) {
+        uint8_t *frame = this->frames[1 - this->front];
+        frame[0] = REPORT_SYNC;
+        frame[1] = message;
+        frame[2] = TELEMETRY_PAYLOAD_SIZE;
+        frame[TELEMETRY_FRAME_SIZE - 1] = crc8(0, &frame[1], TELEMETRY_FRAME_SIZE - 2);
+        if(this->isPending) {
+            this->dropped++;
+        }
+        this->front = 1 - this->front;
+        this->isPending = true;
+    }
+
+    /**
+     * This method writes the published frame, if any, to the stream if its transmit buffer has room for it
+     * @param stream    stream for telemetry, nullptr if none
+     * @return true if a frame was written, false otherwise
+     */
+    bool handle(Print *stream) {
+        if(!this->isPending || stream == nullptr || stream->availableForWrite() < TELEMETRY_FRAME_SIZE) {
+            return false;
+        }
+        stream->write(this->frames[this->front], TELEMETRY_FRAME_SIZE);
+        this->isPending = false;
+        return true;
+    }
+
+    /**
+     * Getter for the number of frames replaced by a newer one before they could be sent
+     * @return number of dropped frames
+     */
+    unsigned long getDropped() const {
+        return this->dropped;
+    }
+
+    /**
+     * This method writes a little-endian 32-bit number
+     * @param buffer    buffer to write to
+     * @param len       index of buffer to write to
+     * @param value     number to be written
+     * @return len increased by the number of written bytes
+     */
+    static uint8_t write32(uint8_t *buffer, uint8_t len, uint32_t value) {
+        return writeLE32(buffer, len, value);
+    }
+
+    /**
+     * This method writes a number as a little-endian Q16.16 fixed-point number, saturating out of range values
+     * @param buffer    buffer to write to
+     * @param len       index of buffer to write to
+     * @param value     number to be written
+     * @return len increased by the number of written bytes
+     */
+    static uint8_t writeFixed(uint8_t *buffer, uint8_t len, double value) {
+        return TelemetryStream::write32(buffer, len, (uint32_t)Fixed(constrain(value, -32768.0, 32767.0)).getRaw());
+    }
+
+    /**
+     * This method writes a number scaled by the given factor as a little-endian int16, saturating out of range values
+     * @param buffer    buffer to write to
+     * @param len       index of buffer to write to
+     * @param value     number to be written
+     * @param scale     factor value is multiplied by, i.e. units of the written number per unit of value
+     * @return len increased by the number of written bytes
+     */
+    static uint8_t write16(uint8_t *buffer, uint8_t len, double value, double scale) {
+        return writeLE16(buffer, len, (uint16_t)(int16_t)lround(constrain(value * scale, -32767.0, 32767.0)));
+    }
+
+private:
+    /**
+     * Front and back frames
+     */
+    uint8_t frames[2][TELEMETRY_FRAME_SIZE] {};
+
+    /**
+     * Index of the front frame, the last published one
+     */
+    uint8_t front = 0;
+
+    /**
+     * True if the front frame was published and not sent yet
+     */
+    bool isPending = false;
+
+    /**
+     * Number of frames replaced before they could be sent
+     */
+    unsigned long dropped = 0;
+};
+
+#else
+
+/**
+ * Empty replacement of the telemetry stream, used when OMNI3_TELEMETRY is 0: every call is optimized away
+ */
+class TelemetryStream {
+public:
+    static const bool ENABLED = false;
+    uint8_t* payload() { return nullptr; }
+    void publish(byte) {}
+    bool handle(Print *) { return false; }
+    unsigned long getDropped() const { return 0; }
+    static uint8_t write32(uint8_t *, uint8_t len, uint32_t) { return len; }
+    static uint8_t writeFixed(uint8_t *, uint8_t len, double) { return len; }
+    static uint8_t write16(uint8_t *, uint8_t len, double, double) { return len; }
+};
+
+#endif
+
+#endif //OMNI3_TELEMETRY_H
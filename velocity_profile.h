@@ -0,0 +1,277 @@
+#ifndef OMNI3_VELOCITY_PROFILE_H
+#define OMNI3_VELOCITY_PROFILE_H
+
+#include "Arduino.h"
+
+/**
+ * Number of bisection iterations used by VelocityProfile::plan() for finding the peak speed of S-curves that can't
+ * reach the maximum speed; each iteration halves the error on the peak speed
+ */
+#define PROFILE_BISECTION_STEPS 20
+
+/**
+ * Class describing a time-optimal motion along one axis that ends at rest, with limited speed, acceleration and
+ * (optionally) jerk: with no jerk limit it is a trapezoidal profile, otherwise it is a 7-segment S-curve; the motion
+ * may start at a non-zero speed, e.g. when it is blended with the previous one; all the segment times are computed
+ * once by plan(), so that evaluate() only needs a few multiplications
+ */
+class VelocityProfile {
+public:
+    /**
+     * This method computes the profile covering the given distance
+     * @param distance      distance to be covered, it must be non-negative
+     * @param startSpeed    speed at the start of the profile; it is lowered if the profile can't stop within distance
+     * @param maxSpeed      speed limit, it must be positive
+     * @param maxAccel      acceleration limit, it must be positive
+     * @param maxJerk       jerk limit, 0.0 for a trapezoidal profile
+     */
+    void plan(double distance, double startSpeed, double maxSpeed, double maxAccel, double maxJerk) {
+        this->distance = distance;
+        this->maxAccel = maxAccel;
+        this->jerk = maxJerk;
+
+        /* Start speed must allow stopping within distance */
+        startSpeed = constrain(startSpeed, 0.0, maxSpeed);
+        this->setPhase(this->decel, startSpeed);
+        if(this->decel.space > distance) {
+            startSpeed = this->findSpeed(0.0, startSpeed, true);
+        }
+        this->startSpeed = startSpeed;
+
+        /* If the maximum speed can be reached, the profile cruises for the remaining distance */
+        this->setPeakSpeed(maxSpeed);
+        double remaining = distance - this->getPhasesSpace();
+        if(remaining < 0.0) {
+            /* Otherwise, find the peak speed whose acceleration and deceleration phases cover the whole distance */
+            if(maxJerk <= 0.0) {
+                this->setPeakSpeed(sqrt(distance * maxAccel + startSpeed * startSpeed / 2));
+            }
+            else {
+                this->setPeakSpeed(this->findSpeed(startSpeed, maxSpeed, false));
+            }
+            remaining = max(distance - this->getPhasesSpace(), 0.0);
+        }
+        this->cruiseTime = this->peakSpeed > 0.0 ? remaining / this->peakSpeed : 0.0;
+    }
+
+    /**
+     * This method evaluates the profile at the given time since its start
+     * @param time      time in seconds; before 0 the profile is at its start, after getDuration() at rest at its end
+     * @param position  pointer where the covered distance is stored
+     * @param speed     pointer where the speed is stored
+     */
+    void evaluate(double time, double *position, double *speed) const {
+        const double decelStart = this->accel.time + this->cruiseTime;
+        if(time <= 0.0) {
+            *position = 0.0;
+            *speed = this->startSpeed;
+        }
+        /* Acceleration phase is a rest-to-rest phase offset by the start speed */
+        else if(time < this->accel.time) {
+            this->evaluatePhase(this->accel, time, position, speed);
+            *position += this->startSpeed * time;
+            *speed += this->startSpeed;
+        }
+        else if(time <= decelStart) {
+            *position = this->accelSpace() + this->peakSpeed * (time - this->accel.time);
+            *speed = this->peakSpeed;
+        }
+        /* Deceleration is a rest-to-rest phase mirrored in time and space */
+        else if(time < this->getDuration()) {
+            this->evaluatePhase(this->decel, this->getDuration() - time, position, speed);
+            *position = this->distance - *position;
+        }
+        else {
+            *position = this->distance;
+            *speed = 0.0;
+        }
+    }
+
+    /**
+     * @return duration of the whole profile in seconds
+     */
+    double getDuration() const {
+        return this->accel.time + this->cruiseTime + this->decel.time;
+    }
+
+private:
+    /**
+     * Phase changing speed by a given amount, starting from rest: jerk segment, constant acceleration segment (empty
+     * if the acceleration limit is not reached) and jerk segment mirrored
+     */
+    struct phase_s {
+        /**
+         * Speed at the end of the phase
+         */
+        double speed;
+
+        /**
+         * Maximum acceleration reached during the phase
+         */
+        double peakAccel;
+
+        /**
+         * Duration of each jerk segment, 0.0 for trapezoidal profiles
+         */
+        double jerkTime;
+
+        /**
+         * Duration of the phase
+         */
+        double time;
+
+        /**
+         * Distance covered by the phase
+         */
+        double space;
+    };
+
+    /**
+     * Distance covered by the whole profile
+     */
+    double distance = 0.0;
+
+    /**
+     * Acceleration limit
+     */
+    double maxAccel = 1.0;
+
+    /**
+     * Jerk limit, 0.0 if the acceleration steps (trapezoidal profile)
+     */
+    double jerk = 0.0;
+
+    /**
+     * Speed at the start of the profile
+     */
+    double startSpeed = 0.0;
+
+    /**
+     * Speed at the end of the acceleration phase
+     */
+    double peakSpeed = 0.0;
+
+    /**
+     * Acceleration phase, from startSpeed to peakSpeed
+     */
+    phase_s accel {};
+
+    /**
+     * Deceleration phase, from peakSpeed to rest
+     */
+    phase_s decel {};
+
+    /**
+     * Duration of the constant speed phase
+     */
+    double cruiseTime = 0.0;
+
+    /**
+     * This method computes acceleration and deceleration phases for the given peak speed
+     * @param speed     peak speed, not lower than startSpeed
+     */
+    void setPeakSpeed(double speed) {
+        this->peakSpeed = speed;
+        this->setPhase(this->accel, speed - this->startSpeed);
+        this->setPhase(this->decel, speed);
+    }
+
+    /**
+     * @return distance covered by the acceleration phase
+     */
+    double accelSpace() const {
+        return this->accel.space + this->startSpeed * this->accel.time;
+    }
+
+    /**
+     * @return distance covered by acceleration and deceleration phases
+     */
+    double getPhasesSpace() const {
+        return this->accelSpace() + this->decel.space;
+    }
+
+    /**
+     * This method finds by bisection the highest speed in the given range for which the phases fit the distance
+     * @param low       lowest speed, whose phases are assumed to fit
+     * @param high      highest speed
+     * @param isStart   true if the searched speed is the start speed (with no acceleration phase), false if it is the
+     *                  peak speed reached from startSpeed
+     * @return found speed; phases are left computed for an arbitrary speed of the range
+     */
+    double findSpeed(double low, double high, bool isStart) {
+        const double savedStart = this->startSpeed;
+        for(uint8_t i=0; i<PROFILE_BISECTION_STEPS; i++) {
+            double speed = (low + high) / 2;
+            if(isStart) {
+                this->startSpeed = speed;
+            }
+            this->setPeakSpeed(speed);
+            if(this->getPhasesSpace() > this->distance) {
+                high = speed;
+            }
+            else {
+                low = speed;
+            }
+        }
+        this->startSpeed = savedStart;
+        return low;
+    }
+
+    /**
+     * This method computes a phase changing speed from rest to the given one
+     * @param phase     phase to be computed
+     * @param speed     speed at the end of the phase
+     */
+    void setPhase(phase_s &phase, double speed) const {
+        phase.speed = speed;
+        if(this->jerk <= 0.0) {
+            phase.peakAccel = this->maxAccel;
+            phase.jerkTime = 0.0;
+            phase.time = speed / this->maxAccel;
+        }
+        /* If the acceleration limit is reached, it is kept between the two jerk segments, otherwise they touch */
+        else if(speed * this->jerk >= this->maxAccel * this->maxAccel) {
+            phase.peakAccel = this->maxAccel;
+            phase.jerkTime = this->maxAccel / this->jerk;
+            phase.time = speed / this->maxAccel + phase.jerkTime;
+        }
+        else {
+            phase.jerkTime = sqrt(speed / this->jerk);
+            phase.peakAccel = this->jerk * phase.jerkTime;
+            phase.time = 2*phase.jerkTime;
+        }
+
+        /* Speed is point-symmetric around the middle of the phase, so the mean speed is half the final speed */
+        phase.space = speed * phase.time / 2;
+    }
+
+    /**
+     * This method evaluates a phase starting from rest
+     * @param phase     phase to be evaluated
+     * @param time      time in seconds, in range [0, phase.time]
+     * @param position  pointer where the covered distance is stored
+     * @param speed     pointer where the speed is stored
+     */
+    void evaluatePhase(const phase_s &phase, double time, double *position, double *speed) const {
+        /* Increasing acceleration */
+        if(time < phase.jerkTime) {
+            *speed = this->jerk * time*time / 2;
+            *position = this->jerk * time*time*time / 6;
+        }
+        /* Constant acceleration */
+        else if(time <= phase.time - phase.jerkTime) {
+            const double t = time - phase.jerkTime;
+            const double jerkSpeed = phase.peakAccel * phase.jerkTime / 2;
+            *speed = jerkSpeed + phase.peakAccel * t;
+            *position = phase.jerkTime * jerkSpeed / 3 + jerkSpeed * t + phase.peakAccel * t*t / 2;
+        }
+        /* Decreasing acceleration, i.e. the first segment mirrored around the end of the phase */
+        else {
+            const double t = phase.time - time;
+            *speed = phase.speed - this->jerk * t*t / 2;
+            *position = phase.space - (phase.speed * t - this->jerk * t*t*t / 6);
+        }
+    }
+};
+
+#endif //OMNI3_VELOCITY_PROFILE_H
@@ -0,0 +1,101 @@
+#include "watchdog.h"
+
+void (* volatile ControlWatchdog::callback)() = nullptr;
+unsigned long ControlWatchdog::timeout = 0;
+
+/* The vector is opt-in: library objects are linked into every sketch, so it would otherwise be taken even if the
+   watchdog is never started, and conflict with sleep and low-power libraries using it */
+#if defined(__AVR__) && defined(WDTCSR) && defined(OMNI3_WATCHDOG_ISR)
+
+#include <avr/wdt.h>
+
+/* Largest prescaler of the watchdog: 8 s where WDP3 exists, 2 s otherwise */
+#ifdef WDP3
+#define WD_MAX_PRESCALER 9
+#else
+#define WD_MAX_PRESCALER 7
+#endif
+
+bool ControlWatchdog::begin(unsigned long _timeout, void (*_callback)()) {
+    if(_timeout == 0 || _callback == nullptr) {
+        return false;
+    }
+
+    /* Find the smallest prescaler whose timeout (16 ms << prescaler) is not shorter than the requested one */
+    uint8_t prescaler = 0;
+    while((16UL << prescaler) < _timeout) {
+        if(prescaler == WD_MAX_PRESCALER) {
+            return false;
+        }
+        prescaler++;
+    }
+    uint8_t config = _BV(WDIE) | _BV(WDE) | (prescaler & 0x07);
+#ifdef WDP3
+    if(prescaler & 0x08) {
+        config |= _BV(WDP3);
+    }
+#endif
+
+    uint8_t oldSREG = SREG;
+    cli();
+    ControlWatchdog::callback = _callback;
+    ControlWatchdog::timeout = 16UL << prescaler;
+
+    /* Timed sequence: the new configuration must be written within 4 cycles from setting WDCE */
+    wdt_reset();
+    WDTCSR = _BV(WDCE) | _BV(WDE);
+    WDTCSR = config;
+    SREG = oldSREG;
+    return true;
+}
+
+void ControlWatchdog::end() {
+    uint8_t oldSREG = SREG;
+    cli();
+
+    /* WDE can't be cleared while the reset flag of a previous watchdog reset is set */
+    wdt_reset();
+    MCUSR &= ~_BV(WDRF);
+    WDTCSR = _BV(WDCE) | _BV(WDE);
+    WDTCSR = 0;
+    ControlWatchdog::callback = nullptr;
+    ControlWatchdog::timeout = 0;
+    SREG = oldSREG;
+}
+
+void ControlWatchdog::feed() {
+    wdt_reset();
+
+    /* The interrupt clears WDIE, leaving only the reset armed: the loop recovered, so arm the interrupt again */
+    if(!(WDTCSR & _BV(WDIE))) {
+        WDTCSR |= _BV(WDIE);
+    }
+}
+
+ISR(WDT_vect) {
+    ControlWatchdog::interrupt();
+}
+
+#else
+
+/* No supported watchdog on this architecture, or its vector is not compiled */
+bool ControlWatchdog::begin(unsigned long, void (*)()) {
+    return false;
+}
+
+void ControlWatchdog::end() {}
+
+void ControlWatchdog::feed() {}
+
+#endif
+
+unsigned long ControlWatchdog::getTimeout() {
+    return ControlWatchdog::timeout;
+}
+
+void ControlWatchdog::interrupt() {
+    void (*function)() = ControlWatchdog::callback;
+    if(function != nullptr) {
+        function();
+    }
+}
@@ -0,0 +1,55 @@
+#ifndef OMNI3_WATCHDOG_H
+#define OMNI3_WATCHDOG_H
+
+#include "Arduino.h"
+
+/**
+ * Static class handling the hardware watchdog in interrupt and reset mode: if it is not fed within the timeout, its
+ * interrupt calls the callback, then, if it is not fed within another timeout, the board is reset; it is available on
+ * AVRs only (the watchdog timeout is 16 ms times a power of two, up to 8 s on ATmega2560/1280), and only if
+ * OMNI3_WATCHDOG_ISR is defined, since it defines the watchdog interrupt vector; otherwise begin() returns false
+ */
+class ControlWatchdog {
+public:
+    /**
+     * This method starts the watchdog with the shortest timeout not shorter than the given one
+     * @param timeout       requested timeout in milliseconds
+     * @param callback      function called when the watchdog expires for the first time, from interrupt context
+     * @return true if the watchdog was started, false if the timeout is not feasible or there is no watchdog available
+     */
+    static bool begin(unsigned long timeout, void (*callback)());
+
+    /**
+     * This method stops the watchdog
+     */
+    static void end();
+
+    /**
+     * This method restarts the watchdog timeout; if the watchdog already expired once, it also arms the callback again
+     */
+    static void feed();
+
+    /**
+     * This method returns the actual timeout of the watchdog
+     * @return timeout in milliseconds, or 0 if the watchdog is not running
+     */
+    static unsigned long getTimeout();
+
+    /**
+     * This method is called by the interrupt service routine; it must not be called directly
+     */
+    static void interrupt();
+
+private:
+    /**
+     * Function called when the watchdog expires
+     */
+    static void (* volatile callback)();
+
+    /**
+     * Actual timeout in milliseconds
+     */
+    static unsigned long timeout;
+};
+
+#endif //OMNI3_WATCHDOG_H
@@ -4,6 +4,7 @@
 #include "Arduino.h"
 #include "Encoder.h"
 #include "motor_driver.h"
+#include "fixed_point.h"
 
 /**
  * Default kP
@@ -20,30 +21,45 @@
  */
 #define D_KD 0.8
 
+/**
+ * Default time constant in seconds of the low-pass filter of the derivative term
+ */
+#define D_DERIVATIVE_FILTER 0.01
+
 /**
  * Seconds in 1 microsecond
  */
 #define MICROS 0.000001
 
 /**
- * Class for defining and controlling wheels
+ * Microseconds in one second
  */
-class Wheel {
+#define TO_MICROS 1000000L
+
+/**
+ * Class template for defining and controlling wheels; driver and encoder types are resolved at compile time, so that
+ * for a given robot the whole control path can be inlined: Wheel is the runtime-polymorphic instantiation, accepting
+ * any MotorDriver
+ * @tparam Driver       type of the motor driver, MotorDriver or one of its final child classes
+ * @tparam EncoderT     type of the encoder, it must provide int read(): Encoder library or QuadratureEncoder
+ */
+template<class Driver, class EncoderT>
+class BasicWheel {
 public:
     /**
      * Wheel constructor
      * @param driver    Driver for handling the wheel; it must be an instance of a child class of the class MotorDriver
      * @param encoder   Encoder for reading wheel position
      */
-    Wheel(MotorDriver *driver, Encoder *encoder) :
+    BasicWheel(Driver *driver, EncoderT *encoder) :
             driver(driver), encoder(encoder), maxSpeed(0) {
         /* Initialize PID constants and initialize speed to 0 */
-        this->kP = D_KP;
-        this->kI = D_KI;
-        this->kD = D_KD;
+        this->kP = control_t(D_KP);
+        this->kI = control_t(D_KI);
+        this->kD = control_t(D_KD);
         this->lastUpdateTime = micros();
-        this->actualSpeed = 0.0;
-        this->setNormalizedSpeed(0.0);
+        this->actualSpeed = control_t(0.0);
+        this->setNormalizedSpeed(control_t(0.0));
     }
 
     /**
@@ -53,36 +69,150 @@ public:
      * @param kD        Derivative constant
      */
     void setPID(double _kP, double _kI, double _kD) {
-        this->kP = _kP;
-        this->kI = _kI;
-        this->kD = _kD;
+        this->kP = control_t(_kP);
+        this->kI = control_t(_kI);
+        this->kD = control_t(_kD);
+        this->updateFixedRateGains();
+    }
+
+    /**
+     * This method sets the time constant of the first-order low-pass filter of the derivative term, which would
+     * otherwise amplify the quantization noise of the measured speed
+     * @param timeConstant  time constant in seconds, 0.0 for an unfiltered derivative; default D_DERIVATIVE_FILTER
+     */
+    void setDerivativeFilter(double timeConstant) {
+        this->derivativeFilter = control_t(timeConstant > 0.0 ? timeConstant : 0.0);
+        this->updateFixedRateGains();
+    }
+
+    /**
+     * This method sets the feed-forward motor model, whose output is added to the PID correction: the PWM value is
+     * modeled as kS*sign(speed) + kV*speed + kA*acceleration; when all the constants are 0.0 (default), the wheel is
+     * driven by PID only; non-finite constants (e.g. read from an uninitialized EEPROM) are taken as 0.0
+     * @param kS        static friction offset in PWM units
+     * @param kV        velocity gain in PWM units per rad/s; see getTestVelocityGain()
+     * @param kA        acceleration gain in PWM units per rad/s^2
+     */
+    void setFeedForward(double _kS, double _kV, double _kA) {
+        this->kS = control_t(isfinite(_kS) ? _kS : 0.0);
+        this->kV = control_t(isfinite(_kV) ? _kV : 0.0);
+        this->kA = control_t(isfinite(_kA) ? _kA : 0.0);
+        this->updateFeedForwardGains();
+    }
+
+    /**
+     * This method enables an alpha-beta tracker for estimating the wheel speed: instead of differentiating the encoder
+     * position at each update, which at low speed and high loop rates gives mostly 0 or 1 step, the tracker predicts
+     * the position from the estimated speed and corrects both by a fraction of the prediction error; beta is chosen
+     * for a critically damped response, i.e. beta = 2*(2-alpha) - 4*sqrt(1-alpha); lower alpha values give a smoother
+     * but slower estimate, e.g. alpha = 0.1 settles in about 30 updates
+     * @param alpha     position gain of the tracker in range (0, 1); any other value disables the tracker
+     */
+    void setSpeedEstimator(double alpha) {
+        this->trackerAlpha = control_t(alpha > 0.0 && alpha < 1.0 ? alpha : 0.0);
+        this->trackerBeta = control_t(alpha > 0.0 && alpha < 1.0 ? 2*(2-alpha) - 4*sqrt(1-alpha) : 0.0);
+        this->trackedOffset = control_t(0.0);
+        this->updateFixedRateGains();
+    }
+
+    /**
+     * This method computes the velocity gain of the motor model from the maximum speed found with testMaxSpeed(): at
+     * MAX_PWM the wheel turns at maxSpeed, so kV = (MAX_PWM - kS) / maxSpeed
+     * @param kS        static friction offset in PWM units, i.e. the lowest PWM value that makes the wheel turn
+     * @return velocity gain in PWM units per rad/s, 0.0 if maxSpeed is 0.0
+     */
+    double getTestVelocityGain(double _kS) const {
+        double speed = static_cast<double>(this->maxSpeed);
+        return speed > 0.0 ? (MotorDriver::MAX_PWM - _kS) / speed : 0.0;
     }
 
     /**
      * This method updates actual speed, performs PID actuation, sends commands to the driver and returns rotation
      * @return angular displacement of the wheel since last call of this method
      */
-    double handle() {
-        /* Get current time and compute elapsed time since last call of this method */
+    control_t handle() {
+        /* Get current time, then read the encoder and actuate */
         unsigned long time = micros();
-        double deltaTime = (time-lastUpdateTime) * MICROS;
+        this->sample();
+        return this->actuate(time);
+    }
+
+    /**
+     * This method is the sample phase of handle(): it only reads and stores the encoder position, so that all the
+     * wheels of a robot can be sampled back to back at the same instant, before actuating any of them
+     */
+    void sample() {
+        this->sampledEncoderValue = encoder->read();
+    }
+
+    /**
+     * This method is the actuate phase of handle(): from the position stored by last sample(), it updates actual speed,
+     * performs PID actuation, sends commands to the driver and returns rotation
+     * @param time      timestamp in microseconds of last sample()
+     * @return angular displacement of the wheel since previous actuate()
+     */
+    control_t actuate(unsigned long time) {
+        /* Compute elapsed time since last call of this method */
+        control_t deltaTime = BasicWheel::microsToSeconds(time-lastUpdateTime);
 
         /* Compute and update actual speed and store how many steps the wheel turned since last call of this method */
         int steps = this->updateActualSpeed(deltaTime);
 
-        /* If maxSpeed is 0.0, update PID, but discard result and stop the motor */
-        if(maxSpeed == 0.0) {
-            this->updatePID(deltaTime);
-            driver->setSpeed(MotorDriver::STILL_PWM);
+        /* Compute PID output and send it to the driver */
+        control_t accelGain = this->kAPWM == control_t(0.0) ? control_t(0.0) : this->kAPWM / deltaTime;
+        control_t derivativeAlpha = this->derivativeFilter == control_t(0.0) ?
+                control_t(1.0) : deltaTime / (this->derivativeFilter + deltaTime);
+        this->drive(this->updatePID(this->angularToPWM(this->actualSpeed), kI * deltaTime, kD / deltaTime,
+                                    derivativeAlpha, this->feedForward(accelGain)));
+
+        /* Update lastTime with the current one and return the number of radians the wheel turned */
+        this->lastUpdateTime = time;
+        return BasicWheel::stepsToAngle(steps);
+    }
+
+    /**
+     * This method sets the constant period at which handleFixedRate() is called, precomputing all the values that
+     * depend on it, so that no division is performed in the control loop
+     * @param period    period in seconds; 0.0 disables fixed-rate mode
+     */
+    void setFixedPeriod(double period) {
+        /* History of the other mode's period is meaningless for the new one */
+        this->resetPID();
+        this->fixedPeriod = control_t(period);
+        this->speedPerStep = period > 0.0 ?
+                control_t(TWO_PI / (stepsPerEncoderRevolution * motorGearRatio) / period) : control_t(0);
+        this->updateFixedRateGains();
+        this->updateFeedForwardGains();
+    }
+
+    /**
+     * This method is the fixed-rate version of actuate(): it must be called with the period set by setFixedPeriod(),
+     * usually from a timer interrupt, after sample(); from the position stored by sample(), it updates actual speed,
+     * performs PID actuation and sends commands to the driver
+     * @return number of encoder steps the wheel turned since last call of this method
+     */
+    int handleFixedRate() {
+        /* Compute the difference between sampled and last position */
+        int steps = this->sampledEncoderValue - lastEncoderValue;
+        this->lastEncoderValue = this->sampledEncoderValue;
+        this->lastSteps = steps;
+
+        /* Actual speed is a product with a precomputed constant, since elapsed time is constant */
+        control_t measuredPWM;
+        if(this->trackerAlpha == control_t(0.0)) {
+            this->actualSpeed = this->speedPerStep * steps;
+            measuredPWM = maxSpeed == control_t(0.0) ?
+                    this->angularToPWM(this->actualSpeed) : this->pwmPerStep * steps;
         }
-        /* Otherwise, send to the driver the PWM value computed by PID */
         else {
-            driver->setSpeed(this->updatePID(deltaTime));
+            this->trackSpeed(BasicWheel::stepsToAngle(steps), this->fixedPeriod, this->betaOverPeriod);
+            measuredPWM = this->angularToPWM(this->actualSpeed);
         }
 
-        /* Update lastTime with the current one and return the number of radians the wheel turned */
-        this->lastUpdateTime = time;
-        return Wheel::stepsToRadians * steps;
+        /* Compute PID output with precomputed gains and send it to the driver */
+        this->drive(this->updatePID(measuredPWM, this->kIPeriod, this->kDOverPeriod, this->derivativeAlphaPeriod,
+                                    this->feedForward(this->kAOverPeriod)));
+        return steps;
     }
 
     /**
@@ -90,11 +220,13 @@ public:
      * @param speed     requested speed in radians per second
      * @return number of radians the wheel rotated since last call of this function
      */
-    bool setSpeed(double speed) {
-        if(maxSpeed == 0.0) {
-            return this->setNormalizedSpeed(0.0);
+    bool setSpeed(control_t speed) {
+        control_t pwm;
+        if(!this->speedToPWM(speed, &pwm)) {
+            return false;
         }
-        return this->setNormalizedSpeed(speed / this->maxSpeed);
+        this->setTargetPWM(pwm);
+        return true;
     }
 
     /**
@@ -102,21 +234,69 @@ public:
      * @param normSpeed requested speed in range [-1, 1]
      * @return number of radians the wheel rotated since last call of this function
      */
-    bool setNormalizedSpeed(double normSpeed) {
+    bool setNormalizedSpeed(control_t normSpeed) {
+        control_t pwm;
+        if(!this->normalizedSpeedToPWM(normSpeed, &pwm)) {
+            return false;
+        }
+        this->setTargetPWM(pwm);
+        return true;
+    }
+
+    /**
+     * This method computes the target PWM value corresponding to a speed, without setting it
+     * @param speed     requested speed in radians per second
+     * @param pwm       pointer where the PWM value in range [-MAX_PWM, MAX_PWM] is stored, if speed is feasible
+     * @return true if the speed is feasible, false otherwise
+     */
+    bool speedToPWM(control_t speed, control_t *pwm) const {
+        return this->normalizedSpeedToPWM(this->normalizeSpeed(speed), pwm);
+    }
+
+    /**
+     * This method expresses a speed as a fraction of the maximum speed of the wheel
+     * @param speed     speed in radians per second
+     * @return normalized speed, feasible if in range [-1, 1]; 0 if maxSpeed is 0
+     */
+    control_t normalizeSpeed(control_t speed) const {
+        if(this->maxSpeed == control_t(0.0)) {
+            return control_t(0.0);
+        }
+        return speed / this->maxSpeed;
+    }
+
+    /**
+     * This method computes the target PWM value corresponding to a normalized speed, without setting it
+     * @param normSpeed requested speed in range [-1, 1]
+     * @param pwm       pointer where the PWM value in range [-MAX_PWM, MAX_PWM] is stored, if speed is feasible
+     * @return true if the speed is feasible, false otherwise
+     */
+    bool normalizedSpeedToPWM(control_t normSpeed, control_t *pwm) const {
         /* If requested speed is not zero, but maxSpeed is zero, return false */
-        if (normSpeed != 0.0 && this->maxSpeed == 0.0) {
+        if (normSpeed != control_t(0.0) && this->maxSpeed == control_t(0.0)) {
             return false;
         }
-        /* If requested speed is greater than maxSpeed, return false */
-        if (normSpeed > 1 || normSpeed < 1) {
+        /* If requested speed is out of [-maxSpeed, maxSpeed], return false */
+        if (normSpeed > control_t(1) || normSpeed < control_t(-1)) {
             return false;
         }
 
         /* Compute target speed speed in [-MAX_PWM, MAX_PWM] range and return true */
-        this->targetSpeed = Wheel::normAngularToPWM(normSpeed);
+        *pwm = BasicWheel::normAngularToPWM(normSpeed);
         return true;
     }
 
+    /**
+     * This method sets the target speed of the motor as a PWM value, computed by speedToPWM() or
+     * normalizedSpeedToPWM(); it must be called once per planner run, even if the target is unchanged, since the
+     * acceleration term of the motor model is computed over the cycles between two calls
+     * @param pwm       target PWM value in range [-MAX_PWM, MAX_PWM]
+     */
+    void setTargetPWM(control_t pwm) {
+        this->targetSpeed = pwm;
+        this->isTargetUpdated = true;
+    }
+
     /**
      * Number of steps for each encoder complete rotation
      */
@@ -143,9 +323,10 @@ public:
     void testMaxSpeed() {
         /* Get current time and compute elapsed time since last call of this method */
         unsigned long time = micros();
-        double deltaTime = (time-lastUpdateTime) * MICROS;
+        control_t deltaTime = BasicWheel::microsToSeconds(time-lastUpdateTime);
 
-        /* Compute and update actual speed */
+        /* Read the encoder, then compute and update actual speed */
+        this->sample();
         this->updateActualSpeed(deltaTime);
 
         /* Keep maximum between maxSpeed and actualSpeed */
@@ -153,19 +334,86 @@ public:
             this->maxSpeed = this->actualSpeed;
         }
         /* Make wheel turn at full speed, corresponding to highest PWM value */
-        driver->setSpeed(MotorDriver::MAX_PWM);
+        MotorDriver::applySpeed(*this->driver, MotorDriver::MAX_PWM);
 
         /* Update lastTime with the current one */
         this->lastUpdateTime = time;
     }
 
+    /**
+     * This method drives the wheel in open loop with the given PWM value, bypassing PID, and computes the actual speed
+     * in rad/s; it is used by calibration, which must call it repeatedly for each wheel; PID state is reset, so that
+     * closed loop control restarts cleanly afterwards
+     * @param pwm       PWM value sent to the driver, in range [-MAX_PWM, MAX_PWM]
+     * @return angular displacement of the wheel since previous call
+     */
+    control_t testPWM(int pwm) {
+        /* Get current time and compute elapsed time since last call of this method */
+        unsigned long time = micros();
+        control_t deltaTime = BasicWheel::microsToSeconds(time-lastUpdateTime);
+
+        /* Read the encoder, then compute and update actual speed */
+        this->sample();
+        int steps = this->updateActualSpeed(deltaTime);
+        MotorDriver::applySpeed(*this->driver, pwm);
+
+        /* Forget PID history, which is meaningless while the wheel is driven in open loop */
+        this->resetPID();
+        this->lastTargetSpeed = this->angularToPWM(this->actualSpeed);
+        this->accelerationTerm = control_t(0.0);
+
+        this->lastUpdateTime = time;
+        return BasicWheel::stepsToAngle(steps);
+    }
+
     /**
      * This method returns the maximum speed reached by calling testMaxSpeed() method; a feasible value of maxSpeed,
      * common for all the wheels, is the minimum speed between the wheels, thus the minimum of the maximums.
      * @return maximum speed found with testMaxSpeed() method in radians per second
      */
     double getMaxSpeed() const {
-        return this->maxSpeed;
+        return static_cast<double>(this->maxSpeed);
+    }
+
+    /**
+     * Getter for the speed of the wheel measured by the last update
+     * @return actual speed in radians per second
+     */
+    double getActualSpeed() const {
+        return static_cast<double>(this->actualSpeed);
+    }
+
+    /**
+     * Getter for the target speed of the wheel
+     * @return target speed in PWM units, in range [-MAX_PWM, MAX_PWM]
+     */
+    double getTargetPWM() const {
+        return static_cast<double>(this->targetSpeed);
+    }
+
+    /**
+     * Getter for the PWM value last sent to the driver
+     * @return PWM value in range [-MAX_PWM, MAX_PWM]
+     */
+    int getOutputPWM() const {
+        return this->driver->getSpeed();
+    }
+
+    /**
+     * Getter for the number of encoder steps the wheel turned in the last actuate(), handleFixedRate() or testPWM();
+     * in fixed-rate mode it must be read with interrupts disabled
+     * @return number of steps, exact, so that it can be accumulated without drifting
+     */
+    int getLastSteps() const {
+        return this->lastSteps;
+    }
+
+    /**
+     * Getter for the speed error of the last PID update
+     * @return target minus measured speed in PWM units
+     */
+    double getLastError() const {
+        return static_cast<double>(this->lastError);
     }
 
     /**
@@ -174,34 +422,84 @@ public:
      * @param maxSpeed  maximum angular speed of the wheel in radians per second
      */
     void setMaxSpeed(double _maxSpeed) {
-        this->maxSpeed = _maxSpeed;
+        this->maxSpeed = control_t(_maxSpeed);
 
-        if(_maxSpeed == 0.0) {
-            driver->setSpeed(MotorDriver::STILL_PWM);
-            this->targetSpeed = 0.0;
+        if(this->maxSpeed == control_t(0.0)) {
+            MotorDriver::applySpeed(*this->driver, MotorDriver::STILL_PWM);
+            this->targetSpeed = control_t(0.0);
+            this->resetPID();
         }
+        this->updateFixedRateGains();
+        this->updateFeedForwardGains();
+    }
+
+    /**
+     * This method converts a number of encoder steps to the corresponding angle; the conversion factor is split into
+     * TWO_PI and an integer divisor, so that it keeps full precision also in fixed-point arithmetic
+     * @param steps     number of encoder steps
+     * @return angle in radians
+     */
+    static control_t stepsToAngle(long steps) {
+        return control_t(TWO_PI) * steps / (stepsPerEncoderRevolution * motorGearRatio);
     }
 
 private:
     /**
      * Motor driver
      */
-    MotorDriver *driver;
+    Driver *driver;
 
     /**
      * Wheel encoder
      */
-    Encoder *encoder;
+    EncoderT *encoder;
 
     /**
      * Maximum angular speed in radians per second
      */
-    double maxSpeed;
+    control_t maxSpeed;
 
     /**
      * PID constants
      */
-    double kP, kI, kD;
+    control_t kP, kI, kD;
+
+    /**
+     * Feed-forward motor model constants: static friction offset in PWM units, velocity gain in PWM units per rad/s,
+     * acceleration gain in PWM units per rad/s^2
+     */
+    control_t kS = control_t(0.0), kV = control_t(0.0), kA = control_t(0.0);
+
+    /**
+     * Velocity and acceleration gains of the motor model, referred to target speed in PWM units instead of rad/s
+     */
+    control_t kVPWM = control_t(0.0), kAPWM = control_t(0.0);
+
+    /**
+     * Acceleration gain of the motor model in PWM units, divided by fixedPeriod
+     */
+    control_t kAOverPeriod = control_t(0.0);
+
+    /**
+     * Target speed set by the previous call of setTargetPWM() in PWM units, for the acceleration term of the motor
+     * model
+     */
+    control_t lastTargetSpeed = control_t(0.0);
+
+    /**
+     * Acceleration term of the motor model in PWM units, held from a call of setTargetPWM() to the next one
+     */
+    control_t accelerationTerm = control_t(0.0);
+
+    /**
+     * Control periods since the previous call of setTargetPWM(), saturated at 255
+     */
+    uint8_t targetCycles = 0;
+
+    /**
+     * True if setTargetPWM() was called since the last control period
+     */
+    bool isTargetUpdated = false;
 
     /**
      * Time PID loop function was last called, expressed in microseconds
@@ -213,25 +511,191 @@ private:
      */
     int lastEncoderValue = 0;
 
+    /**
+     * Position read from encoder by last sample()
+     */
+    int sampledEncoderValue = 0;
+
+    /**
+     * Number of steps the wheel turned in the last update, made by actuate(), handleFixedRate() or testPWM()
+     */
+    int lastSteps = 0;
+
     /**
      * Last speed requested by Omni3 to this class; value in range [-MAX_PWM, MAX_PWM]
      */
-    double targetSpeed = MotorDriver::STILL_PWM;
+    control_t targetSpeed = control_t(MotorDriver::STILL_PWM);
 
     /**
      * Actual speed of the wheel in rad/s
      */
-    double actualSpeed;
+    control_t actualSpeed;
 
     /**
      * Last error on requested speed
      */
-    double lastError = 0;
+    control_t lastError = control_t(0);
+
+    /**
+     * Integral term of the PID in PWM units, i.e. kI times the integral of the error, kept in [-MAX_PWM, MAX_PWM]
+     */
+    control_t integralTerm = control_t(0);
+
+    /**
+     * Derivative term of the PID in PWM units, low-pass filtered
+     */
+    control_t derivativeTerm = control_t(0);
+
+    /**
+     * Measured speed in PWM units of the last PID update, for the derivative term
+     */
+    control_t lastMeasuredPWM = control_t(0);
+
+    /**
+     * Time constant in seconds of the low-pass filter of the derivative term, 0.0 if unfiltered
+     */
+    control_t derivativeFilter = control_t(D_DERIVATIVE_FILTER);
+
+    /**
+     * Period in seconds at which handleFixedRate() is called; 0.0 if fixed-rate mode is not used
+     */
+    control_t fixedPeriod = control_t(0.0);
+
+    /**
+     * Speed in rad/s corresponding to one step per fixedPeriod
+     */
+    control_t speedPerStep = control_t(0.0);
+
+    /**
+     * PWM value corresponding to one step per fixedPeriod
+     */
+    control_t pwmPerStep = control_t(0.0);
+
+    /**
+     * Derivative constant divided by fixedPeriod
+     */
+    control_t kDOverPeriod = control_t(0.0);
+
+    /**
+     * Integrative constant times fixedPeriod
+     */
+    control_t kIPeriod = control_t(0.0);
+
+    /**
+     * Gain of the low-pass filter of the derivative term for fixedPeriod
+     */
+    control_t derivativeAlphaPeriod = control_t(1.0);
 
     /**
-     * Cumulative error on requested speed
+     * Position and speed gains of the alpha-beta speed tracker, 0.0 if speed is computed by differentiation
      */
-    double cumulativeError = 0;
+    control_t trackerAlpha = control_t(0.0), trackerBeta = control_t(0.0);
+
+    /**
+     * Speed gain of the tracker divided by fixedPeriod
+     */
+    control_t betaOverPeriod = control_t(0.0);
+
+    /**
+     * Position estimated by the tracker minus the last position read from the encoder, in radians
+     */
+    control_t trackedOffset = control_t(0.0);
+
+    /**
+     * This method updates actualSpeed with the alpha-beta tracker, from the angle turned since the previous update
+     * @param angle         angle in radians turned since the previous update
+     * @param deltaTime     time in seconds elapsed since the previous update
+     * @param betaOverTime  speed gain of the tracker divided by deltaTime
+     */
+    void trackSpeed(control_t angle, control_t deltaTime, control_t betaOverTime) {
+        /* Residual between measured position and the one predicted at the previous speed */
+        control_t residual = angle - (this->trackedOffset + this->actualSpeed * deltaTime);
+        this->actualSpeed += betaOverTime * residual;
+
+        /* Corrected position is prediction + alpha*residual, stored relative to the new encoder position */
+        this->trackedOffset = (this->trackerAlpha - control_t(1)) * residual;
+    }
+
+    /**
+     * This method recomputes the constants used by handleFixedRate(); it is called every time one of the values they
+     * depend on changes
+     */
+    void updateFixedRateGains() {
+        if(this->fixedPeriod == control_t(0.0)) {
+            return;
+        }
+        this->kDOverPeriod = this->kD / this->fixedPeriod;
+        this->kIPeriod = this->kI * this->fixedPeriod;
+        this->derivativeAlphaPeriod = this->fixedPeriod / (this->derivativeFilter + this->fixedPeriod);
+        this->betaOverPeriod = this->trackerBeta / this->fixedPeriod;
+        this->pwmPerStep = this->angularToPWM(this->speedPerStep);
+    }
+
+    /**
+     * This method recomputes the gains of the motor model referred to target speed in PWM units; it is called every
+     * time one of the values they depend on changes
+     */
+    void updateFeedForwardGains() {
+        /* targetSpeed = MAX_PWM * speed / maxSpeed, so the gains are scaled by maxSpeed / MAX_PWM */
+        this->kVPWM = this->kV * this->maxSpeed / MotorDriver::MAX_PWM;
+        this->kAPWM = this->kA * this->maxSpeed / MotorDriver::MAX_PWM;
+        this->kAOverPeriod = this->fixedPeriod == control_t(0.0) ? control_t(0.0) : this->kAPWM / this->fixedPeriod;
+    }
+
+    /**
+     * This method computes the output of the motor model for the current target speed; the planner can run slower
+     * than the wheels, so the acceleration is the step of the target divided by the periods elapsed since the previous
+     * target, and it is held until the next one, instead of being applied as a single period impulse
+     * @param accelGain     acceleration gain in PWM units divided by the elapsed time
+     * @return feed-forward PWM value, 0.0 if the model is not set
+     */
+    control_t feedForward(control_t accelGain) {
+        if(this->targetCycles < 0xFF) {
+            this->targetCycles++;
+        }
+        if(this->isTargetUpdated) {
+            this->isTargetUpdated = false;
+            this->accelerationTerm = accelGain * (this->targetSpeed - this->lastTargetSpeed) / (int)this->targetCycles;
+            this->lastTargetSpeed = this->targetSpeed;
+            this->targetCycles = 0;
+        }
+
+        control_t output = this->kVPWM * this->targetSpeed + this->accelerationTerm;
+        if(this->targetSpeed > control_t(0.0)) {
+            output += this->kS;
+        }
+        else if(this->targetSpeed < control_t(0.0)) {
+            output -= this->kS;
+        }
+        return output;
+    }
+
+    /**
+     * This method clears the state of the PID, so that it restarts without any memory of previous updates
+     */
+    void resetPID() {
+        this->integralTerm = control_t(0);
+        this->derivativeTerm = control_t(0);
+        this->lastError = control_t(0);
+        this->lastMeasuredPWM = this->angularToPWM(this->actualSpeed);
+    }
+
+    /**
+     * This method sends the PID output to the driver, unless maxSpeed is 0.0: in that case the motor is stopped
+     * @param output    PWM value computed by PID
+     */
+    void drive(int output) {
+        MotorDriver::applySpeed(*this->driver, maxSpeed == control_t(0.0) ? MotorDriver::STILL_PWM : output);
+    }
+
+    /**
+     * This method converts an elapsed time from microseconds to seconds
+     * @param deltaMicros   elapsed time in microseconds
+     * @return elapsed time in seconds
+     */
+    static control_t microsToSeconds(unsigned long deltaMicros) {
+        return controlRatio(deltaMicros, TO_MICROS);
+    }
 
     /**
      * This method computes the theoretical PWM value from an angular speed; since this method is used for computing
@@ -239,17 +703,17 @@ private:
      * @param angular   speed in rad/s
      * @return PWM value corresponding to the given angular speed; this is usually in range [-MAX_PWM, MAX_PWM]
      */
-    double angularToPWM(double angular) const {
+    control_t angularToPWM(control_t angular) const {
         /* If maxSpeed is 0, return 0 if also angular is 0, otherwise MAX_PWM with the sign of angular */
-        if(this->maxSpeed == 0) {
-            if(angular > 0) {
-                return MotorDriver::MAX_PWM;
+        if(this->maxSpeed == control_t(0)) {
+            if(angular > control_t(0)) {
+                return control_t(MotorDriver::MAX_PWM);
             }
-            else if(angular < 0) {
-                return -MotorDriver::MAX_PWM;
+            else if(angular < control_t(0)) {
+                return control_t(-MotorDriver::MAX_PWM);
             }
             else {
-                return 0;
+                return control_t(0);
             }
         }
 
@@ -263,9 +727,10 @@ private:
      * @param nAngular  normalized angular speed; number in range [-1, 1]
      * @return PWM value corresponding to the given normalized angular speed; this will be in range [-MAX_PWM, MAX_PWM]
      */
-    static double normAngularToPWM(double nAngular) {
+    static control_t normAngularToPWM(control_t nAngular) {
         /* Compute and return conversion from [-1, 1] to [-MAX_PWM, MAX_PWM] */
-        return constrain(nAngular * MotorDriver::MAX_PWM, -MotorDriver::MAX_PWM, MotorDriver::MAX_PWM);
+        return constrain(nAngular * MotorDriver::MAX_PWM,
+                         control_t(-MotorDriver::MAX_PWM), control_t(MotorDriver::MAX_PWM));
     }
 
     /**
@@ -273,41 +738,77 @@ private:
      * @param deltaTime time elapsed in seconds since last execution of this method
      * @return number of steps performed by the wheel since last call of this method
      */
-    int updateActualSpeed(double deltaTime) {
-        /* Read position of the wheel from the encoder and compute the difference from last position */
-        int encoderValue = encoder->read();
-        int deltaSteps = encoderValue - lastEncoderValue;
+    int updateActualSpeed(control_t deltaTime) {
+        /* Compute the difference between sampled and last position */
+        int deltaSteps = this->sampledEncoderValue - lastEncoderValue;
 
-        /* Compute and store actual angular speed of the wheel */
-        this->actualSpeed = Wheel::stepsToRadians * deltaSteps / deltaTime;
+        /* Compute and store actual angular speed of the wheel, differentiating or tracking the position */
+        if(this->trackerAlpha == control_t(0.0)) {
+            this->actualSpeed = BasicWheel::stepsToAngle(deltaSteps) / deltaTime;
+        }
+        else {
+            this->trackSpeed(BasicWheel::stepsToAngle(deltaSteps), deltaTime, this->trackerBeta / deltaTime);
+        }
 
         /* Update last position of the wheel and return the difference between current and last position */
-        this->lastEncoderValue = encoderValue;
+        this->lastEncoderValue = this->sampledEncoderValue;
+        this->lastSteps = deltaSteps;
         return deltaSteps;
     }
 
     /**
-     * This method computes with PID the actual value to be sent to the motor, in order to make it spin at given speed
-     * @param deltaTime time elapsed in seconds since last execution of this method
+     * This method computes with PID the actual value to be sent to the motor, in order to make it spin at given speed:
+     * - the derivative term acts on the measured speed instead of the error, so that target steps don't kick the
+     *   output, and it is low-pass filtered
+     * - the integral term is kept in PWM units and bounded to [-MAX_PWM, MAX_PWM]; it is not updated while the output
+     *   is saturated in the direction of the error (conditional integration), so that it doesn't wind up during stalls
+     *   or saturated accelerations
+     * While maxSpeed is 0.0 the motor is stopped, then the PID is kept reset instead of being updated
+     * @param measuredPWM       actual speed of the wheel, converted to PWM units
+     * @param integralGain      integrative constant times the time elapsed since last execution of this method
+     * @param derivativeGain    derivative constant divided by the time elapsed since last execution of this method
+     * @param derivativeAlpha   gain of the low-pass filter of the derivative term, in range (0, 1]
+     * @param feedForward       output of the motor model, the PID correction is added to it
      * @return PWM value to be sent to the driver; it will be in range [-MAX_PWM, MAX_PWM]
      */
-    int updatePID(double deltaTime) {
-        /* Compute error as the difference between requested and actual speed */
-        double error = this->targetSpeed - this->angularToPWM(this->actualSpeed);
-
-        /* Compute integral of error and update cumulative error */
-        this->cumulativeError += error * deltaTime;
+    int updatePID(control_t measuredPWM, control_t integralGain, control_t derivativeGain, control_t derivativeAlpha,
+                  control_t feedForward) {
+        const control_t MAX = control_t(MotorDriver::MAX_PWM);
+        if(this->maxSpeed == control_t(0.0)) {
+            this->resetPID();
+            return MotorDriver::STILL_PWM;
+        }
 
-        /* Compute output as the weighted sum of proportional, integrative and derivative errors */
-        int output = lround((kP * error) + (kI * cumulativeError) + (kD * (error-lastError)/deltaTime));
+        /* Compute error as the difference between requested and actual speed */
+        control_t error = this->targetSpeed - measuredPWM;
+
+        /* Derivative of the measurement, filtered: d += alpha * (raw - d) */
+        control_t rawDerivative = derivativeGain * (this->lastMeasuredPWM - measuredPWM);
+        this->derivativeTerm += derivativeAlpha * (rawDerivative - this->derivativeTerm);
+        this->lastMeasuredPWM = measuredPWM;
+
+        /* Integrate the error only if the output it produces is not saturated in the direction of the error */
+        control_t partial = feedForward + (kP * error) + this->derivativeTerm;
+        control_t integral = constrain(this->integralTerm + integralGain * error, -MAX, MAX);
+        control_t output = partial + integral;
+        if(!(output > MAX && error > control_t(0)) && !(output < -MAX && error < control_t(0))) {
+            this->integralTerm = integral;
+        }
+        output = partial + this->integralTerm;
 
-        /* Update last error for computing next iteration's derivative error */
+        /* Update last error, reported by getLastError() */
         this->lastError = error;
 
         /* Return output, constrained so that it's in range [-MAX_PWM, MAX_PWM] */
-        return constrain(output, -MotorDriver::MAX_PWM, MotorDriver::MAX_PWM);
+        int pwm = lround(output);
+        return constrain(pwm, -MotorDriver::MAX_PWM, MotorDriver::MAX_PWM);
     }
 
 };
 
+/**
+ * Wheel handled through the MotorDriver interface, for robots mixing different drivers
+ */
+typedef BasicWheel<MotorDriver, Encoder> Wheel;
+
 #endif